@@ -11,6 +11,21 @@ import numpy as np
 import matplotlib.pyplot as plt
 
 
+def expand_epoch_deltas(json_data):
+    """
+    with epoch_delta a record only has the stats that changed since the
+    last record of its channel, carry the others over
+    """
+    last = {}
+    expanded = []
+    for line in json_data:
+        full = dict(last.get(line["channel"], {}))
+        full.update(line)
+        last[line["channel"]] = full
+        expanded.append(full)
+    return expanded
+
+
 def extract_epoch_data(json_data, label, merge_channel=True):
     """
     TODO enable merge_channel=False option later
@@ -121,6 +136,7 @@ if __name__ == '__main__':
             exit(1)
         if isinstance(j_data, list):
             is_epoch = True
+            j_data = expand_epoch_deltas(j_data)
         else:
             is_epoch = False
 
@@ -2,11 +2,20 @@
 
 namespace dramsim3 {
 
-BankState::BankState()
+BankState::BankState(const Config& config)
     : state_(State::CLOSED),
+      salp_(config.salp),
+      num_subarrays_(config.salp == SALPMode::NONE ? 1 : config.subarrays),
+      rows_per_subarray_(config.rows_per_subarray),
+      masa_subarrays_(std::min(config.masa_subarrays, config.subarrays)),
       cmd_timing_(static_cast<int>(CommandType::SIZE)),
-      open_row_(-1),
-      row_hit_count_(0) {
+      subarray_timing_(num_subarrays_, std::vector<uint64_t>(static_cast<int>(
+                                           CommandType::SIZE))),
+      subarray_act_ready_(0),
+      open_rows_(num_subarrays_, -1),
+      designated_(0),
+      row_hit_count_(num_subarrays_, 0),
+      last_opener_(-1) {
     cmd_timing_[static_cast<int>(CommandType::READ)] = 0;
     cmd_timing_[static_cast<int>(CommandType::READ_PRECHARGE)] = 0;
     cmd_timing_[static_cast<int>(CommandType::WRITE)] = 0;
@@ -16,11 +25,17 @@ BankState::BankState()
     cmd_timing_[static_cast<int>(CommandType::REFRESH)] = 0;
     cmd_timing_[static_cast<int>(CommandType::SREF_ENTER)] = 0;
     cmd_timing_[static_cast<int>(CommandType::SREF_EXIT)] = 0;
+    cmd_timing_[static_cast<int>(CommandType::PD_ENTER)] = 0;
+    cmd_timing_[static_cast<int>(CommandType::PD_EXIT)] = 0;
 }
 
 
 Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
     CommandType required_type = CommandType::SIZE;
+    // the subarray the required command goes to, a PRE names the row it
+    // closes
+    int subarray = 0;
+    int row = cmd.Row();
     switch (state_) {
         case State::CLOSED:
             switch (cmd.cmd_type) {
@@ -29,10 +44,14 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
                 case CommandType::WRITE:
                 case CommandType::WRITE_PRECHARGE:
                     required_type = CommandType::ACTIVATE;
+                    subarray = Subarray(cmd.Row());
                     break;
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
                 case CommandType::SREF_ENTER:
+                case CommandType::PD_ENTER:
+                case CommandType::ROW_CLONE:
                     required_type = cmd.cmd_type;
                     break;
                 default:
@@ -47,16 +66,32 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
                 case CommandType::READ_PRECHARGE:
                 case CommandType::WRITE:
                 case CommandType::WRITE_PRECHARGE:
-                    if (cmd.Row() == open_row_) {
+                    subarray = Subarray(cmd.Row());
+                    if (open_rows_[subarray] == cmd.Row() &&
+                        (salp_ != SALPMode::SALP2 || subarray == designated_)) {
                         required_type = cmd.cmd_type;
+                    } else if (open_rows_[subarray] == -1 &&
+                               CanActivateSubarray()) {
+                        required_type = CommandType::ACTIVATE;
                     } else {
+                        // a row conflict in the subarray, or no room for
+                        // another open subarray so the oldest one goes
+                        if (open_rows_[subarray] == -1) {
+                            subarray = open_subarrays_.front();
+                        }
                         required_type = CommandType::PRECHARGE;
+                        row = open_rows_[subarray];
                     }
                     break;
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
                 case CommandType::SREF_ENTER:
+                case CommandType::PD_ENTER:
+                case CommandType::ROW_CLONE:
                     required_type = CommandType::PRECHARGE;
+                    subarray = open_subarrays_.front();
+                    row = open_rows_[subarray];
                     break;
                 default:
                     std::cerr << "Unknown type!" << std::endl;
@@ -70,6 +105,8 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
                 case CommandType::READ_PRECHARGE:
                 case CommandType::WRITE:
                 case CommandType::WRITE_PRECHARGE:
+                case CommandType::ROW_CLONE:
+                case CommandType::SREF_EXIT:
                     required_type = CommandType::SREF_EXIT;
                     break;
                 default:
@@ -79,6 +116,18 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
             }
             break;
         case State::PD:
+            // everything but another power-down entry wakes the rank up,
+            // refreshes included
+            switch (cmd.cmd_type) {
+                case CommandType::PD_ENTER:
+                    std::cerr << "Unknown type!" << std::endl;
+                    AbruptExit(__FILE__, __LINE__);
+                    break;
+                default:
+                    required_type = CommandType::PD_EXIT;
+                    break;
+            }
+            break;
         case State::SIZE:
             std::cerr << "In unknown state" << std::endl;
             AbruptExit(__FILE__, __LINE__);
@@ -86,33 +135,83 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
     }
 
     if (required_type != CommandType::SIZE) {
-        if (clk >= cmd_timing_[static_cast<int>(required_type)]) {
-            return Command(required_type, cmd.addr, cmd.hex_addr);
+        if (clk >= ReadyTime(required_type, subarray)) {
+            Command ready_cmd = cmd;
+            ready_cmd.cmd_type = required_type;
+            ready_cmd.addr.row = row;
+            return ready_cmd;
         }
     }
     return Command();
 }
 
+uint64_t BankState::EarliestReadyCycle() const {
+    switch (state_) {
+        case State::CLOSED:
+            return std::min(
+                cmd_timing_[static_cast<int>(CommandType::ACTIVATE)],
+                cmd_timing_[static_cast<int>(CommandType::ROW_CLONE)]);
+        case State::OPEN: {
+            // ACT for another subarray with SALP
+            uint64_t earliest =
+                cmd_timing_[static_cast<int>(CommandType::ACTIVATE)];
+            for (auto cmd_type :
+                 {CommandType::READ, CommandType::READ_PRECHARGE,
+                  CommandType::WRITE, CommandType::WRITE_PRECHARGE,
+                  CommandType::PRECHARGE}) {
+                earliest = std::min(earliest,
+                                    cmd_timing_[static_cast<int>(cmd_type)]);
+            }
+            return earliest;
+        }
+        case State::SREF:
+            return cmd_timing_[static_cast<int>(CommandType::SREF_EXIT)];
+        case State::PD:
+            return cmd_timing_[static_cast<int>(CommandType::PD_EXIT)];
+        default:
+            return 0;
+    }
+}
+
+bool BankState::IsInterferenceMiss(const Command& cmd) const {
+    if (cmd.source_id == last_opener_ ||
+        cmd.source_id >= static_cast<int>(source_last_row_.size())) {
+        return false;
+    }
+    return source_last_row_[cmd.source_id] == cmd.Row();
+}
+
 void BankState::UpdateState(const Command& cmd) {
     switch (state_) {
         case State::OPEN:
             switch (cmd.cmd_type) {
                 case CommandType::READ:
                 case CommandType::WRITE:
-                    row_hit_count_++;
+                    designated_ = Subarray(cmd.Row());
+                    row_hit_count_[designated_]++;
+                    UpdateSourceRow(cmd);
                     break;
                 case CommandType::READ_PRECHARGE:
                 case CommandType::WRITE_PRECHARGE:
+                    UpdateSourceRow(cmd);
                 case CommandType::PRECHARGE:
-                    state_ = State::CLOSED;
-                    open_row_ = -1;
-                    row_hit_count_ = 0;
+                    CloseSubarray(Subarray(cmd.Row()));
                     break;
                 case CommandType::ACTIVATE:
+                    // another subarray, with SALP2 or MASA
+                    if (open_subarrays_.size() >= MaxOpenSubarrays() ||
+                        open_rows_[Subarray(cmd.Row())] != -1) {
+                        AbruptExit(__FILE__, __LINE__);
+                    }
+                    OpenSubarray(Subarray(cmd.Row()), cmd.Row());
+                    last_opener_ = cmd.source_id;
+                    break;
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
                 case CommandType::SREF_ENTER:
                 case CommandType::SREF_EXIT:
+                case CommandType::ROW_CLONE:
                 default:
                     AbruptExit(__FILE__, __LINE__);
             }
@@ -121,14 +220,21 @@ void BankState::UpdateState(const Command& cmd) {
             switch (cmd.cmd_type) {
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
+                    break;
+                case CommandType::ROW_CLONE:
+                    // ends with a precharge, only the timing changes
                     break;
                 case CommandType::ACTIVATE:
-                    state_ = State::OPEN;
-                    open_row_ = cmd.Row();
+                    OpenSubarray(Subarray(cmd.Row()), cmd.Row());
+                    last_opener_ = cmd.source_id;
                     break;
                 case CommandType::SREF_ENTER:
                     state_ = State::SREF;
                     break;
+                case CommandType::PD_ENTER:
+                    state_ = State::PD;
+                    break;
                 case CommandType::READ:
                 case CommandType::WRITE:
                 case CommandType::READ_PRECHARGE:
@@ -153,7 +259,18 @@ void BankState::UpdateState(const Command& cmd) {
                 case CommandType::PRECHARGE:
                 case CommandType::REFRESH:
                 case CommandType::REFRESH_BANK:
+                case CommandType::REFRESH_SAME_BANK:
                 case CommandType::SREF_ENTER:
+                case CommandType::ROW_CLONE:
+                default:
+                    AbruptExit(__FILE__, __LINE__);
+            }
+            break;
+        case State::PD:
+            switch (cmd.cmd_type) {
+                case CommandType::PD_EXIT:
+                    state_ = State::CLOSED;
+                    break;
                 default:
                     AbruptExit(__FILE__, __LINE__);
             }
@@ -164,10 +281,79 @@ void BankState::UpdateState(const Command& cmd) {
     return;
 }
 
+size_t BankState::MaxOpenSubarrays() const {
+    switch (salp_) {
+        case SALPMode::SALP2:
+            return 2;
+        case SALPMode::MASA:
+            return masa_subarrays_;
+        default:
+            return 1;
+    }
+}
+
+bool BankState::CanActivateSubarray() const {
+    if (open_subarrays_.size() >= MaxOpenSubarrays()) {
+        return false;
+    }
+    // with SALP2 the last activated subarray would not be accessible any
+    // more, so it has to be accessed before another one is activated
+    return salp_ != SALPMode::SALP2 || open_subarrays_.empty() ||
+           row_hit_count_[designated_] > 0;
+}
+
+void BankState::OpenSubarray(int subarray, int row) {
+    state_ = State::OPEN;
+    open_rows_[subarray] = row;
+    row_hit_count_[subarray] = 0;
+    open_subarrays_.push_back(subarray);
+    designated_ = subarray;
+    return;
+}
+
+void BankState::CloseSubarray(int subarray) {
+    if (open_rows_[subarray] == -1) {
+        AbruptExit(__FILE__, __LINE__);
+    }
+    open_rows_[subarray] = -1;
+    row_hit_count_[subarray] = 0;
+    open_subarrays_.erase(std::find(open_subarrays_.begin(),
+                                    open_subarrays_.end(), subarray));
+    if (open_subarrays_.empty()) {
+        state_ = State::CLOSED;
+    } else if (designated_ == subarray) {
+        designated_ = open_subarrays_.back();
+    }
+    return;
+}
+
+void BankState::UpdateSourceRow(const Command& cmd) {
+    if (cmd.source_id >= static_cast<int>(source_last_row_.size())) {
+        source_last_row_.resize(cmd.source_id + 1, -1);
+    }
+    source_last_row_[cmd.source_id] = cmd.Row();
+    return;
+}
+
 void BankState::UpdateTiming(CommandType cmd_type, uint64_t time) {
     cmd_timing_[static_cast<int>(cmd_type)] =
         std::max(cmd_timing_[static_cast<int>(cmd_type)], time);
     return;
 }
 
+void BankState::UpdateSubarrayTiming(int row, CommandType cmd_type,
+                                     uint64_t time) {
+    // a command without a row holds for every subarray
+    if (row < 0) {
+        UpdateTiming(cmd_type, time);
+        return;
+    }
+    auto& timing = subarray_timing_[Subarray(row)][static_cast<int>(cmd_type)];
+    timing = std::max(timing, time);
+    if (cmd_type == CommandType::ACTIVATE) {
+        subarray_act_ready_ = std::max(subarray_act_ready_, time);
+    }
+    return;
+}
+
 }  // namespace dramsim3
@@ -1,14 +1,19 @@
 #ifndef __BANKSTATE_H
 #define __BANKSTATE_H
 
+#include <algorithm>
 #include <vector>
 #include "common.h"
+#include "configuration.h"
 
 namespace dramsim3 {
 
+// State of one bank. With SALP every subarray of the bank has its own row
+// buffer, the bank is OPEN while any of them holds a row, and the row
+// commands (ACT/PRE) are tracked per subarray
 class BankState {
    public:
-    BankState();
+    explicit BankState(const Config& config);
 
     enum class State { OPEN, CLOSED, SREF, PD, SIZE };
     Command GetReadyCommand(const Command& cmd, uint64_t clk) const;
@@ -19,23 +24,85 @@ class BankState {
     // Update the existing timing constraints for the command
     void UpdateTiming(const CommandType cmd_type, uint64_t time);
 
+    // Update a timing constraint of the subarray holding row only
+    void UpdateSubarrayTiming(int row, const CommandType cmd_type,
+                              uint64_t time);
+
+    // Earliest cycle any command a read, write or row clone may need next
+    // can be ready at in the current state, a lower bound of GetReadyCommand
+    uint64_t EarliestReadyCycle() const;
+
+    // Earliest cycle a rank level command can be issued at in this bank
+    uint64_t RankCommandReadyCycle(CommandType cmd_type) const {
+        return ReadyTime(cmd_type, 0);
+    }
+
     bool IsRowOpen() const { return state_ == State::OPEN; }
-    int OpenRow() const { return open_row_; }
-    int RowHitCount() const { return row_hit_count_; }
+    // the row of the subarray last activated or accessed
+    int OpenRow() const { return open_rows_[designated_]; }
+    int RowHitCount() const { return row_hit_count_[designated_]; }
+    int RowHitCount(int subarray) const { return row_hit_count_[subarray]; }
+
+    // Whether an ACT now overlaps with another subarray of the bank, i.e.
+    // one that is still open or still precharging
+    bool IsSubarrayOverlap(uint64_t clk) const {
+        return state_ == State::OPEN || clk < subarray_act_ready_;
+    }
+
+    // Whether an ACT for cmd re-opens a row its source had open before
+    // another source took over the bank, i.e. a row buffer miss caused
+    // by interference
+    bool IsInterferenceMiss(const Command& cmd) const;
 
    private:
+    void UpdateSourceRow(const Command& cmd);
+    int Subarray(int row) const {
+        return num_subarrays_ == 1 ? 0 : row / rows_per_subarray_;
+    }
+    uint64_t ReadyTime(CommandType cmd_type, int subarray) const {
+        return std::max(cmd_timing_[static_cast<int>(cmd_type)],
+                        subarray_timing_[subarray][static_cast<int>(cmd_type)]);
+    }
+    size_t MaxOpenSubarrays() const;
+    bool CanActivateSubarray() const;
+    void OpenSubarray(int subarray, int row);
+    void CloseSubarray(int subarray);
+
     // Current state of the Bank
     // Apriori or instantaneously transitions on a command.
     State state_;
 
+    SALPMode salp_;
+    int num_subarrays_;  // with a row buffer of their own, 1 without SALP
+    int rows_per_subarray_;
+    int masa_subarrays_;
+
     // Earliest time when the particular Command can be executed in this bank
     std::vector<uint64_t> cmd_timing_;
 
-    // Currently open row
-    int open_row_;
+    // and in each subarray, for the timings that only hold in a subarray
+    std::vector<std::vector<uint64_t> > subarray_timing_;
+
+    // latest ACT timing of any subarray, when the whole bank would be ready
+    uint64_t subarray_act_ready_;
+
+    // Currently open row of each subarray, -1 if it is precharged
+    std::vector<int> open_rows_;
+
+    // open subarrays, in the order they were activated
+    std::vector<int> open_subarrays_;
+
+    // subarray connected to the global row buffer
+    int designated_;
+
+    // consecutive accesses to the open row of each subarray
+    std::vector<int> row_hit_count_;
+
+    // source that activated the currently (or last) open row
+    int last_opener_;
 
-    // consecutive accesses to one row
-    int row_hit_count_;
+    // last row each source accessed in this bank, indexed by source id
+    std::vector<int> source_last_row_;
 };
 
 }  // namespace dramsim3
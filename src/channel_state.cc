@@ -1,37 +1,63 @@
 #include "channel_state.h"
 
 namespace dramsim3 {
+
+DataBus::DataBus(const Config& config)
+    : config_(config), last_end_(0), last_rank_(-1), last_is_write_(false) {}
+
+uint64_t DataBus::EarliestCAS(int rank, bool is_write) const {
+    if (last_rank_ < 0) {
+        return 0;
+    }
+    uint64_t free_at = last_end_;
+    if (rank != last_rank_) {
+        free_at += is_write && last_is_write_ ? config_.tODTSW : config_.tRTRS;
+    }
+    // the burst starts burst_cycle before its data is done
+    uint64_t data_start = is_write ? config_.write_delay : config_.read_delay;
+    data_start -= config_.burst_cycle;
+    return free_at > data_start ? free_at - data_start : 0;
+}
+
+void DataBus::Reserve(int rank, bool is_write, uint64_t clk) {
+    last_end_ = clk + (is_write ? config_.write_delay : config_.read_delay);
+    last_rank_ = rank;
+    last_is_write_ = is_write;
+}
+
 ChannelState::ChannelState(const Config& config, const Timing& timing)
     : rank_idle_cycles(config.ranks, 0),
       config_(config),
       timing_(timing),
       rank_is_sref_(config.ranks, false),
+      rank_is_pd_(config.ranks, false),
+      bank_ready_cycles_(config.ranks * config.banks, 0),
+      rank_open_banks_(config.ranks, 0),
+      rank_cmd_ready_cycles_(
+          config.ranks,
+          std::vector<uint64_t>(static_cast<int>(CommandType::SIZE), 0)),
+      rank_refreshes_waiting_(config.ranks, 0),
       four_aw_(config_.ranks, std::vector<uint64_t>()),
-      thirty_two_aw_(config_.ranks, std::vector<uint64_t>()) {
+      thirty_two_aw_(config_.ranks, std::vector<uint64_t>()),
+      data_bus_(config_),
+      ca_bus_free_(config_.split_ca_bus ? 2 : 1, 0) {
+    if (config_.banks > 64) {
+        std::cerr << "At most 64 banks per rank are supported" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     bank_states_.reserve(config_.ranks);
     for (auto i = 0; i < config_.ranks; i++) {
         auto rank_states = std::vector<std::vector<BankState>>();
         rank_states.reserve(config_.bankgroups);
         for (auto j = 0; j < config_.bankgroups; j++) {
-            auto bg_states =
-                std::vector<BankState>(config_.banks_per_group, BankState());
+            auto bg_states = std::vector<BankState>(config_.banks_per_group,
+                                                    BankState(config_));
             rank_states.push_back(bg_states);
         }
         bank_states_.push_back(rank_states);
     }
 }
 
-bool ChannelState::IsAllBankIdleInRank(int rank) const {
-    for (int j = 0; j < config_.bankgroups; j++) {
-        for (int k = 0; k < config_.banks_per_group; k++) {
-            if (bank_states_[rank][j][k].IsRowOpen()) {
-                return false;
-            }
-        }
-    }
-    return true;
-}
-
 bool ChannelState::IsRWPendingOnRef(const Command& cmd) const {
     int rank = cmd.Rank();
     int bankgroup = cmd.Bankgroup();
@@ -46,11 +72,13 @@ void ChannelState::BankNeedRefresh(int rank, int bankgroup, int bank,
     if (need) {
         Address addr = Address(-1, rank, bankgroup, bank, -1, -1);
         refresh_q_.emplace_back(CommandType::REFRESH_BANK, addr, -1);
+        rank_refreshes_waiting_[rank]++;
     } else {
         for (auto it = refresh_q_.begin(); it != refresh_q_.end(); it++) {
             if (it->Rank() == rank && it->Bankgroup() == bankgroup &&
                 it->Bank() == bank) {
                 refresh_q_.erase(it);
+                rank_refreshes_waiting_[rank]--;
                 break;
             }
         }
@@ -62,10 +90,29 @@ void ChannelState::RankNeedRefresh(int rank, bool need) {
     if (need) {
         Address addr = Address(-1, rank, -1, -1, -1, -1);
         refresh_q_.emplace_back(CommandType::REFRESH, addr, -1);
+        rank_refreshes_waiting_[rank]++;
     } else {
         for (auto it = refresh_q_.begin(); it != refresh_q_.end(); it++) {
             if (it->Rank() == rank) {
                 refresh_q_.erase(it);
+                rank_refreshes_waiting_[rank]--;
+                break;
+            }
+        }
+    }
+    return;
+}
+
+void ChannelState::SameBankNeedRefresh(int rank, int bank, bool need) {
+    if (need) {
+        Address addr = Address(-1, rank, -1, bank, -1, -1);
+        refresh_q_.emplace_back(CommandType::REFRESH_SAME_BANK, addr, -1);
+        rank_refreshes_waiting_[rank]++;
+    } else {
+        for (auto it = refresh_q_.begin(); it != refresh_q_.end(); it++) {
+            if (it->Rank() == rank && it->Bank() == bank) {
+                refresh_q_.erase(it);
+                rank_refreshes_waiting_[rank]--;
                 break;
             }
         }
@@ -73,28 +120,56 @@ void ChannelState::RankNeedRefresh(int rank, bool need) {
     return;
 }
 
+bool ChannelState::IsCABusBusy(uint64_t clk) const {
+    if (!config_.ca_bus_model) {
+        return false;
+    }
+    for (auto free_at : ca_bus_free_) {
+        if (clk >= free_at) {
+            return false;
+        }
+    }
+    return true;
+}
+
 Command ChannelState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
+    if (!config_.ca_bus_model) {
+        return GetReadyBankCommand(cmd, clk);
+    }
+    if (IsCABusBusy(clk)) {
+        return Command();
+    }
+    Command ready_cmd = GetReadyBankCommand(cmd, clk);
+    // the banks are ready, the command bus it goes on has to be free too
+    if (ready_cmd.IsValid() && clk < ca_bus_free_[CABus(ready_cmd)]) {
+        return Command();
+    }
+    return ready_cmd;
+}
+
+Command ChannelState::GetReadyBankCommand(const Command& cmd,
+                                          uint64_t clk) const {
     Command ready_cmd = Command();
     if (cmd.IsRankCMD()) {
+        return GetReadyRankCommand(cmd, clk);
+    } else if (cmd.cmd_type == CommandType::REFRESH_SAME_BANK) {
         int num_ready = 0;
         for (auto j = 0; j < config_.bankgroups; j++) {
-            for (auto k = 0; k < config_.banks_per_group; k++) {
-                ready_cmd =
-                    bank_states_[cmd.Rank()][j][k].GetReadyCommand(cmd, clk);
-                if (!ready_cmd.IsValid()) {  // Not ready
-                    continue;
-                }
-                if (ready_cmd.cmd_type != cmd.cmd_type) {  // likely PRECHARGE
-                    Address new_addr = Address(-1, cmd.Rank(), j, k, -1, -1);
-                    ready_cmd.addr = new_addr;
-                    return ready_cmd;
-                } else {
-                    num_ready++;
-                }
+            ready_cmd =
+                bank_states_[cmd.Rank()][j][cmd.Bank()].GetReadyCommand(cmd,
+                                                                        clk);
+            if (!ready_cmd.IsValid()) {
+                continue;
+            }
+            if (ready_cmd.cmd_type != cmd.cmd_type) {  // PRECHARGE
+                ready_cmd.addr = Address(-1, cmd.Rank(), j, cmd.Bank(),
+                                         ready_cmd.Row(), -1);
+                return ready_cmd;
+            } else {
+                num_ready++;
             }
         }
-        // All bank ready
-        if (num_ready == config_.banks) {
+        if (num_ready == config_.bankgroups) {
             return ready_cmd;
         } else {
             return Command();
@@ -105,12 +180,83 @@ Command ChannelState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
         if (!ready_cmd.IsValid()) {
             return Command();
         }
-        if (ready_cmd.cmd_type == CommandType::ACTIVATE) {
-            if (!ActivationWindowOk(ready_cmd.Rank(), clk)) {
+        if (ready_cmd.cmd_type == CommandType::ACTIVATE ||
+            ready_cmd.cmd_type == CommandType::ROW_CLONE) {
+            int acts =
+                ready_cmd.cmd_type == CommandType::ROW_CLONE ? 2 : 1;
+            if (!ActivationWindowOk(ready_cmd.Rank(), clk, acts)) {
                 return Command();
             }
+        } else if (ready_cmd.IsReadWrite()) {
+            if (clk < data_bus_.EarliestCAS(ready_cmd.Rank(),
+                                            ready_cmd.IsWrite())) {
+                return Command();
+            }
+        }
+        return ready_cmd;
+    }
+}
+
+Command ChannelState::GetReadyRankCommand(const Command& cmd,
+                                          uint64_t clk) const {
+    int rank = cmd.Rank();
+    bool is_entry = cmd.cmd_type == CommandType::REFRESH ||
+                    cmd.cmd_type == CommandType::SREF_ENTER ||
+                    cmd.cmd_type == CommandType::PD_ENTER;
+    if (rank_open_banks_[rank] != 0 && is_entry) {
+        // the first open bank that can be precharged goes first
+        uint64_t bits = rank_open_banks_[rank];
+        while (bits) {
+            int bank_idx = CountTrailingZeros(bits);
+            bits &= bits - 1;
+            int j = bank_idx / config_.banks_per_group;
+            int k = bank_idx % config_.banks_per_group;
+            Command ready_cmd =
+                bank_states_[rank][j][k].GetReadyCommand(cmd, clk);
+            if (ready_cmd.IsValid()) {
+                ready_cmd.addr = Address(-1, rank, j, k, ready_cmd.Row(), -1);
+                return ready_cmd;
+            }
+        }
+        return Command();
+    }
+    bool is_sref = rank_is_sref_[rank];
+    bool is_pd = rank_is_pd_[rank];
+    if (rank_open_banks_[rank] == 0 &&
+        ((!is_sref && !is_pd && is_entry) ||
+         (is_sref && cmd.cmd_type == CommandType::SREF_EXIT) ||
+         (is_pd && cmd.cmd_type == CommandType::PD_EXIT))) {
+        // every bank needs the command itself
+        int type_idx = static_cast<int>(cmd.cmd_type);
+        if (clk >= rank_cmd_ready_cycles_[rank][type_idx]) {
+            return cmd;
+        }
+        return Command();
+    }
+
+    // anything else, e.g. waking up a powered down rank for a refresh,
+    // goes bank by bank
+    Command ready_cmd = Command();
+    int num_ready = 0;
+    for (auto j = 0; j < config_.bankgroups; j++) {
+        for (auto k = 0; k < config_.banks_per_group; k++) {
+            ready_cmd = bank_states_[rank][j][k].GetReadyCommand(cmd, clk);
+            if (!ready_cmd.IsValid()) {  // Not ready
+                continue;
+            }
+            if (ready_cmd.cmd_type != cmd.cmd_type) {  // likely PRECHARGE
+                ready_cmd.addr = Address(-1, rank, j, k, ready_cmd.Row(), -1);
+                return ready_cmd;
+            } else {
+                num_ready++;
+            }
         }
+    }
+    // All bank ready
+    if (num_ready == config_.banks) {
         return ready_cmd;
+    } else {
+        return Command();
     }
 }
 
@@ -127,7 +273,16 @@ void ChannelState::UpdateState(const Command& cmd) {
             rank_is_sref_[cmd.Rank()] = true;
         } else if (cmd.cmd_type == CommandType::SREF_EXIT) {
             rank_is_sref_[cmd.Rank()] = false;
+        } else if (cmd.cmd_type == CommandType::PD_ENTER) {
+            rank_is_pd_[cmd.Rank()] = true;
+        } else if (cmd.cmd_type == CommandType::PD_EXIT) {
+            rank_is_pd_[cmd.Rank()] = false;
+        }
+    } else if (cmd.cmd_type == CommandType::REFRESH_SAME_BANK) {
+        for (auto j = 0; j < config_.bankgroups; j++) {
+            bank_states_[cmd.Rank()][j][cmd.Bank()].UpdateState(cmd);
         }
+        SameBankNeedRefresh(cmd.Rank(), cmd.Bank(), false);
     } else {
         bank_states_[cmd.Rank()][cmd.Bankgroup()][cmd.Bank()].UpdateState(cmd);
         if (cmd.IsRefresh()) {
@@ -138,7 +293,14 @@ void ChannelState::UpdateState(const Command& cmd) {
 }
 
 void ChannelState::UpdateTiming(const Command& cmd, uint64_t clk) {
+    if (cmd.IsReadWrite()) {
+        data_bus_.Reserve(cmd.Rank(), cmd.IsWrite(), clk);
+    }
     switch (cmd.cmd_type) {
+        case CommandType::ROW_CLONE:
+            // it is ACT, ACT, PRE inside the bank, so it takes two
+            // activations out of the window
+            UpdateActivationTimes(cmd.Rank(), clk);
         case CommandType::ACTIVATE:
             UpdateActivationTimes(cmd.Rank(), clk);
         case CommandType::READ:
@@ -152,6 +314,9 @@ void ChannelState::UpdateTiming(const Command& cmd, uint64_t clk) {
             UpdateSameBankTiming(
                 cmd.addr, timing_.same_bank[static_cast<int>(cmd.cmd_type)],
                 clk);
+            UpdateSameSubarrayTiming(
+                cmd.addr,
+                timing_.same_subarray[static_cast<int>(cmd.cmd_type)], clk);
 
             // Same Bankgroup other banks
             UpdateOtherBanksSameBankgroupTiming(
@@ -166,15 +331,19 @@ void ChannelState::UpdateTiming(const Command& cmd, uint64_t clk) {
                 timing_
                     .other_bankgroups_same_rank[static_cast<int>(cmd.cmd_type)],
                 clk);
-
-            // Other ranks
-            UpdateOtherRanksTiming(
-                cmd.addr, timing_.other_ranks[static_cast<int>(cmd.cmd_type)],
+            break;
+        case CommandType::REFRESH_SAME_BANK:
+            UpdateSameBankAllBankgroupsTiming(
+                cmd.addr, timing_.same_bank[static_cast<int>(cmd.cmd_type)],
+                timing_
+                    .other_banks_same_bankgroup[static_cast<int>(cmd.cmd_type)],
                 clk);
             break;
         case CommandType::REFRESH:
         case CommandType::SREF_ENTER:
         case CommandType::SREF_EXIT:
+        case CommandType::PD_ENTER:
+        case CommandType::PD_EXIT:
             UpdateSameRankTiming(
                 cmd.addr, timing_.same_rank[static_cast<int>(cmd.cmd_type)],
                 clk);
@@ -196,6 +365,17 @@ void ChannelState::UpdateSameBankTiming(
     return;
 }
 
+void ChannelState::UpdateSameSubarrayTiming(
+    const Address& addr,
+    const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
+    uint64_t clk) {
+    for (auto cmd_timing : cmd_timing_list) {
+        bank_states_[addr.rank][addr.bankgroup][addr.bank].UpdateSubarrayTiming(
+            addr.row, cmd_timing.first, clk + cmd_timing.second);
+    }
+    return;
+}
+
 void ChannelState::UpdateOtherBanksSameBankgroupTiming(
     const Address& addr,
     const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
@@ -228,19 +408,18 @@ void ChannelState::UpdateOtherBankgroupsSameRankTiming(
     return;
 }
 
-void ChannelState::UpdateOtherRanksTiming(
+void ChannelState::UpdateSameBankAllBankgroupsTiming(
     const Address& addr,
     const std::vector<std::pair<CommandType, int>>& cmd_timing_list,
+    const std::vector<std::pair<CommandType, int>>& other_timing_list,
     uint64_t clk) {
-    for (auto i = 0; i < config_.ranks; i++) {
-        if (i != addr.rank) {
-            for (auto j = 0; j < config_.bankgroups; j++) {
-                for (auto k = 0; k < config_.banks_per_group; k++) {
-                    for (auto cmd_timing : cmd_timing_list) {
-                        bank_states_[i][j][k].UpdateTiming(
-                            cmd_timing.first, clk + cmd_timing.second);
-                    }
-                }
+    for (auto j = 0; j < config_.bankgroups; j++) {
+        for (auto k = 0; k < config_.banks_per_group; k++) {
+            const auto& timing_list =
+                k == addr.bank ? cmd_timing_list : other_timing_list;
+            for (auto cmd_timing : timing_list) {
+                bank_states_[addr.rank][j][k].UpdateTiming(
+                    cmd_timing.first, clk + cmd_timing.second);
             }
         }
     }
@@ -265,52 +444,84 @@ void ChannelState::UpdateSameRankTiming(
 void ChannelState::UpdateTimingAndStates(const Command& cmd, uint64_t clk) {
     UpdateState(cmd);
     UpdateTiming(cmd, clk);
+    if (config_.ca_bus_model) {
+        ca_bus_free_[CABus(cmd)] = clk + config_.CommandCycles(cmd.cmd_type);
+    }
+    // commands only constrain the banks of their own rank
+    UpdateRankSummary(cmd.Rank());
+    return;
+}
+
+void ChannelState::UpdateRankSummary(int rank) {
+    const CommandType rank_cmds[] = {
+        CommandType::REFRESH, CommandType::SREF_ENTER, CommandType::SREF_EXIT,
+        CommandType::PD_ENTER, CommandType::PD_EXIT};
+    auto ready_it = bank_ready_cycles_.begin() + rank * config_.banks;
+    auto& rank_cmd_ready = rank_cmd_ready_cycles_[rank];
+    for (auto cmd_type : rank_cmds) {
+        rank_cmd_ready[static_cast<int>(cmd_type)] = 0;
+    }
+    uint64_t open_banks = 0;
+    int bank_idx = 0;
+    for (const auto& bg_states : bank_states_[rank]) {
+        for (const auto& bank_state : bg_states) {
+            *ready_it++ = bank_state.EarliestReadyCycle();
+            if (bank_state.IsRowOpen()) {
+                open_banks |= 1ull << bank_idx;
+            }
+            for (auto cmd_type : rank_cmds) {
+                auto& ready = rank_cmd_ready[static_cast<int>(cmd_type)];
+                ready = std::max(ready,
+                                 bank_state.RankCommandReadyCycle(cmd_type));
+            }
+            bank_idx++;
+        }
+    }
+    rank_open_banks_[rank] = open_banks;
     return;
 }
 
-bool ChannelState::ActivationWindowOk(int rank, uint64_t curr_time) const {
-    bool tfaw_ok = IsFAWReady(rank, curr_time);
+bool ChannelState::ActivationWindowOk(int rank, uint64_t curr_time,
+                                      int acts) const {
+    bool tfaw_ok = IsFAWReady(rank, curr_time, acts);
     if (config_.IsGDDR()) {
         if (!tfaw_ok)
             return false;
         else
-            return Is32AWReady(rank, curr_time);
+            return Is32AWReady(rank, curr_time, acts);
     }
     return tfaw_ok;
 }
 
 void ChannelState::UpdateActivationTimes(int rank, uint64_t curr_time) {
-    if (!four_aw_[rank].empty() && curr_time >= four_aw_[rank][0]) {
-        four_aw_[rank].erase(four_aw_[rank].begin());
+    // the windows hold when each activation leaves them, oldest first
+    auto& faw = four_aw_[rank];
+    while (!faw.empty() && curr_time >= faw.front()) {
+        faw.erase(faw.begin());
     }
-    four_aw_[rank].push_back(curr_time + config_.tFAW);
+    faw.push_back(curr_time + config_.tFAW);
     if (config_.IsGDDR()) {
-        if (!thirty_two_aw_[rank].empty() &&
-            curr_time >= thirty_two_aw_[rank][0]) {
-            thirty_two_aw_[rank].erase(thirty_two_aw_[rank].begin());
+        auto& aw32 = thirty_two_aw_[rank];
+        while (!aw32.empty() && curr_time >= aw32.front()) {
+            aw32.erase(aw32.begin());
         }
-        thirty_two_aw_[rank].push_back(curr_time + config_.t32AW);
+        aw32.push_back(curr_time + config_.t32AW);
     }
     return;
 }
 
-bool ChannelState::IsFAWReady(int rank, uint64_t curr_time) const {
-    if (!four_aw_[rank].empty()) {
-        if (curr_time < four_aw_[rank][0] && four_aw_[rank].size() >= 4) {
-            return false;
-        }
-    }
-    return true;
+bool ChannelState::IsFAWReady(int rank, uint64_t curr_time, int acts) const {
+    // acts more activations fit once the one that would be the 5th most
+    // recent with them has left the window
+    const auto& faw = four_aw_[rank];
+    size_t limit = 5 - acts;
+    return faw.size() < limit || curr_time >= faw[faw.size() - limit];
 }
 
-bool ChannelState::Is32AWReady(int rank, uint64_t curr_time) const {
-    if (!thirty_two_aw_[rank].empty()) {
-        if (curr_time < thirty_two_aw_[rank][0] &&
-            thirty_two_aw_[rank].size() >= 32) {
-            return false;
-        }
-    }
-    return true;
+bool ChannelState::Is32AWReady(int rank, uint64_t curr_time, int acts) const {
+    const auto& aw32 = thirty_two_aw_[rank];
+    size_t limit = 33 - acts;
+    return aw32.size() < limit || curr_time >= aw32[aw32.size() - limit];
 }
 
 }  // namespace dramsim3
@@ -9,31 +9,76 @@
 
 namespace dramsim3 {
 
+// Reservation timeline of the data bus of a channel. Every burst has to
+// start after the previous one ends, plus tRTRS when the rank driving the
+// bus changes and tODTSW when writes move the termination to another rank,
+// so bursts are granted in order and only the latest one can hold up the
+// next CAS.
+class DataBus {
+   public:
+    explicit DataBus(const Config& config);
+    // earliest cycle a read or write to rank can be issued at
+    uint64_t EarliestCAS(int rank, bool is_write) const;
+    void Reserve(int rank, bool is_write, uint64_t clk);
+
+   private:
+    const Config& config_;
+    uint64_t last_end_;  // first cycle after the latest burst
+    int last_rank_;
+    bool last_is_write_;
+};
+
 class ChannelState {
    public:
     ChannelState(const Config& config, const Timing& timing);
     Command GetReadyCommand(const Command& cmd, uint64_t clk) const;
+    // whether no command at all can get onto the command bus at clk
+    bool IsCABusBusy(uint64_t clk) const;
     void UpdateState(const Command& cmd);
     void UpdateTiming(const Command& cmd, uint64_t clk);
     void UpdateTimingAndStates(const Command& cmd, uint64_t clk);
-    bool ActivationWindowOk(int rank, uint64_t curr_time) const;
+    // whether acts activations (2 for a row clone) fit in the windows
+    bool ActivationWindowOk(int rank, uint64_t curr_time, int acts) const;
     void UpdateActivationTimes(int rank, uint64_t curr_time);
     bool IsRowOpen(int rank, int bankgroup, int bank) const {
         return bank_states_[rank][bankgroup][bank].IsRowOpen();
     }
-    bool IsAllBankIdleInRank(int rank) const;
+    bool IsAllBankIdleInRank(int rank) const {
+        return rank_open_banks_[rank] == 0;
+    }
+    // EarliestReadyCycle of every bank, indexed rank by rank with the banks
+    // of a rank in the order of their bankgroups
+    const std::vector<uint64_t>& BankReadyCycles() const {
+        return bank_ready_cycles_;
+    }
     bool IsRankSelfRefreshing(int rank) const { return rank_is_sref_[rank]; }
+    bool IsRankPoweredDown(int rank) const { return rank_is_pd_[rank]; }
     bool IsRefreshWaiting() const { return !refresh_q_.empty(); }
+    bool IsRankRefreshWaiting(int rank) const {
+        return rank_refreshes_waiting_[rank] > 0;
+    }
     bool IsRWPendingOnRef(const Command& cmd) const;
     const Command& PendingRefCommand() const {return refresh_q_.front(); }
     void BankNeedRefresh(int rank, int bankgroup, int bank, bool need);
     void RankNeedRefresh(int rank, bool need);
+    void SameBankNeedRefresh(int rank, int bank, bool need);
     int OpenRow(int rank, int bankgroup, int bank) const {
         return bank_states_[rank][bankgroup][bank].OpenRow();
     }
     int RowHitCount(int rank, int bankgroup, int bank) const {
         return bank_states_[rank][bankgroup][bank].RowHitCount();
     };
+    int RowHitCount(int rank, int bankgroup, int bank, int subarray) const {
+        return bank_states_[rank][bankgroup][bank].RowHitCount(subarray);
+    }
+    bool IsSubarrayOverlap(const Command& cmd, uint64_t clk) const {
+        return bank_states_[cmd.Rank()][cmd.Bankgroup()][cmd.Bank()]
+            .IsSubarrayOverlap(clk);
+    }
+    bool IsInterferenceMiss(const Command& cmd) const {
+        return bank_states_[cmd.Rank()][cmd.Bankgroup()][cmd.Bank()]
+            .IsInterferenceMiss(cmd);
+    }
 
     std::vector<int> rank_idle_cycles;
 
@@ -42,19 +87,48 @@ class ChannelState {
     const Timing& timing_;
 
     std::vector<bool> rank_is_sref_;
+    std::vector<bool> rank_is_pd_;
     std::vector<std::vector<std::vector<BankState> > > bank_states_;
+    std::vector<uint64_t> bank_ready_cycles_;
+
+    // Per rank summaries of the bank states, refreshed whenever a command
+    // goes to the rank: a bit per bank with an open row, in the order of
+    // bank_ready_cycles_, and the cycle every bank is ready for each rank
+    // level command at, while none of them is open
+    std::vector<uint64_t> rank_open_banks_;
+    std::vector<std::vector<uint64_t> > rank_cmd_ready_cycles_;
+    // entries of refresh_q_ for each rank
+    std::vector<int> rank_refreshes_waiting_;
     std::vector<Command> refresh_q_;
 
     std::vector<std::vector<uint64_t> > four_aw_;
     std::vector<std::vector<uint64_t> > thirty_two_aw_;
-    bool IsFAWReady(int rank, uint64_t curr_time) const;
-    bool Is32AWReady(int rank, uint64_t curr_time) const;
+
+    DataBus data_bus_;
+
+    // first cycle each command bus is free again, the row bus and the
+    // column bus when they are split
+    std::vector<uint64_t> ca_bus_free_;
+    int CABus(const Command& cmd) const {
+        return config_.split_ca_bus && cmd.IsReadWrite() ? 1 : 0;
+    }
+    Command GetReadyBankCommand(const Command& cmd, uint64_t clk) const;
+    bool IsFAWReady(int rank, uint64_t curr_time, int acts) const;
+    bool Is32AWReady(int rank, uint64_t curr_time, int acts) const;
+    void UpdateRankSummary(int rank);
+    Command GetReadyRankCommand(const Command& cmd, uint64_t clk) const;
     // Update timing of the bank the command corresponds to
     void UpdateSameBankTiming(
         const Address& addr,
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
         uint64_t clk);
 
+    // Update timing of the subarray the command corresponds to
+    void UpdateSameSubarrayTiming(
+        const Address& addr,
+        const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
+        uint64_t clk);
+
     // Update timing of the other banks in the same bankgroup as the command
     void UpdateOtherBanksSameBankgroupTiming(
         const Address& addr,
@@ -68,10 +142,13 @@ class ChannelState {
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
         uint64_t clk);
 
-    // Update timing of banks in a different rank as the command
-    void UpdateOtherRanksTiming(
+    // Update timing of the same bank in every bankgroup of the rank with
+    // cmd_timing_list and of all the other banks in the rank with
+    // other_timing_list (for DDR5 same-bank refresh)
+    void UpdateSameBankAllBankgroupsTiming(
         const Address& addr,
         const std::vector<std::pair<CommandType, int> >& cmd_timing_list,
+        const std::vector<std::pair<CommandType, int> >& other_timing_list,
         uint64_t clk);
 
     // Update timing of the entire rank (for rank level commands)
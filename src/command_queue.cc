@@ -31,28 +31,83 @@ CommandQueue::CommandQueue(int channel_id, const Config& config,
         cmd_queue.reserve(config_.cmd_queue_size);
         queues_.push_back(cmd_queue);
     }
+    occupied_mask_.resize((num_queues_ + 63) / 64, 0);
+    ready_mask_.resize(occupied_mask_.size(), 0);
 }
 
 Command CommandQueue::GetCommandToIssue() {
-    for (int i = 0; i < num_queues_; i++) {
-        auto& queue = GetNextQueue();
-        // if we're refresing, skip the command queues that are involved
-        if (is_in_ref_) {
-            if (ref_q_indices_.find(queue_idx_) != ref_q_indices_.end()) {
-                continue;
+    if (channel_state_.IsCABusBusy(clk_)) {
+        return Command();
+    }
+    UpdateReadyMask();
+    // round robin from the queue after the one that issued last, i.e. the
+    // queues from there to the end and then the ones up to it
+    int start = queue_idx_ + 1 == num_queues_ ? 0 : queue_idx_ + 1;
+    int ranges[2][2] = {{start, num_queues_}, {0, start}};
+    for (const auto& range : ranges) {
+        for (int w = range[0] / 64; w * 64 < range[1]; w++) {
+            uint64_t bits = ready_mask_[w];
+            if (w * 64 < range[0]) {
+                bits &= ~0ull << (range[0] - w * 64);
             }
-        }
-        auto cmd = GetFirstReadyInQueue(queue);
-        if (cmd.IsValid()) {
-            if (cmd.IsReadWrite()) {
-                EraseRWCommand(cmd);
+            if (range[1] - w * 64 < 64) {
+                bits &= (1ull << (range[1] - w * 64)) - 1;
+            }
+            while (bits) {
+                int q_idx = w * 64 + CountTrailingZeros(bits);
+                bits &= bits - 1;
+                auto cmd = GetFirstReadyInQueue(queues_[q_idx]);
+                if (cmd.IsValid()) {
+                    queue_idx_ = q_idx;
+                    if (cmd.IsReadWrite() || cmd.IsRowClone()) {
+                        EraseRWCommand(cmd);
+                    }
+                    return cmd;
+                }
             }
-            return cmd;
         }
     }
     return Command();
 }
 
+void CommandQueue::UpdateReadyMask() {
+    const auto& bank_ready = channel_state_.BankReadyCycles();
+    for (size_t w = 0; w < ready_mask_.size(); w++) {
+        ready_mask_[w] = 0;
+        if (occupied_mask_[w] == 0) {
+            continue;
+        }
+        int begin = static_cast<int>(w) * 64;
+        int end = std::min(num_queues_, begin + 64);
+        uint64_t ready = 0;
+        if (queue_structure_ == QueueStructure::PER_BANK) {
+            // queue and bank indices are the same, kept free of branches
+            // so that the compiler can vectorize it
+            for (int i = begin; i < end; i++) {
+                ready |= static_cast<uint64_t>(clk_ >= bank_ready[i])
+                         << (i - begin);
+            }
+        } else {
+            for (int i = begin; i < end; i++) {
+                bool any_ready = false;
+                for (int j = i * config_.banks; j < (i + 1) * config_.banks;
+                     j++) {
+                    any_ready |= clk_ >= bank_ready[j];
+                }
+                ready |= static_cast<uint64_t>(any_ready) << (i - begin);
+            }
+        }
+        ready_mask_[w] = ready & occupied_mask_[w];
+    }
+    // if we're refresing, skip the command queues that are involved
+    if (is_in_ref_) {
+        for (auto q_idx : ref_q_indices_) {
+            ready_mask_[q_idx / 64] &= ~(1ull << (q_idx % 64));
+        }
+    }
+    return;
+}
+
 Command CommandQueue::FinishRefresh() {
     // we can do something fancy here like clearing the R/Ws
     // that already had ACT on the way but by doing that we
@@ -75,22 +130,32 @@ Command CommandQueue::FinishRefresh() {
 }
 
 bool CommandQueue::ArbitratePrecharge(const CMDIterator& cmd_it,
-                                      const CMDQueue& queue) const {
+                                      const CMDQueue& queue,
+                                      const Command& pre) const {
     auto cmd = *cmd_it;
+    // the precharge only closes the row open in its subarray, which is the
+    // whole bank without SALP
+    int subarray = config_.SubarrayOf(pre.Row());
 
     for (auto prev_itr = queue.begin(); prev_itr != cmd_it; prev_itr++) {
         if (prev_itr->Rank() == cmd.Rank() &&
             prev_itr->Bankgroup() == cmd.Bankgroup() &&
-            prev_itr->Bank() == cmd.Bank()) {
+            prev_itr->Bank() == cmd.Bank() &&
+            config_.SubarrayOf(prev_itr->Row()) == subarray) {
             return false;
         }
     }
 
     bool pending_row_hits_exist = false;
-    int open_row =
-        channel_state_.OpenRow(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
-    for (auto pending_itr = cmd_it; pending_itr != queue.end(); pending_itr++) {
-        if (pending_itr->Row() == open_row &&
+    int open_row = pre.Row();
+    // with SALP2 only the last activated subarray can be accessed, the row
+    // of the older one is of no use to pending commands
+    bool can_hit = config_.salp != SALPMode::SALP2 ||
+                   channel_state_.OpenRow(cmd.Rank(), cmd.Bankgroup(),
+                                          cmd.Bank()) == open_row;
+    for (auto pending_itr = cmd_it; can_hit && pending_itr != queue.end();
+         pending_itr++) {
+        if (pending_itr->IsReadWrite() && pending_itr->Row() == open_row &&
             pending_itr->Bank() == cmd.Bank() &&
             pending_itr->Bankgroup() == cmd.Bankgroup() &&
             pending_itr->Rank() == cmd.Rank()) {
@@ -100,8 +165,8 @@ bool CommandQueue::ArbitratePrecharge(const CMDIterator& cmd_it,
     }
 
     bool rowhit_limit_reached =
-        channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(), cmd.Bank()) >=
-        4;
+        channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(), cmd.Bank(),
+                                   subarray) >= 4;
     if (!pending_row_hits_exist || rowhit_limit_reached) {
         simple_stats_.Increment("num_ondemand_pres");
         return true;
@@ -115,8 +180,8 @@ bool CommandQueue::WillAcceptCommand(int rank, int bankgroup, int bank) const {
 }
 
 bool CommandQueue::QueueEmpty() const {
-    for (const auto q : queues_) {
-        if (!q.empty()) {
+    for (auto bits : occupied_mask_) {
+        if (bits) {
             return false;
         }
     }
@@ -125,24 +190,18 @@ bool CommandQueue::QueueEmpty() const {
 
 
 bool CommandQueue::AddCommand(Command cmd) {
-    auto& queue = GetQueue(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    int q_idx = GetQueueIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    auto& queue = queues_[q_idx];
     if (queue.size() < queue_size_) {
         queue.push_back(cmd);
         rank_q_empty[cmd.Rank()] = false;
+        occupied_mask_[q_idx / 64] |= 1ull << (q_idx % 64);
         return true;
     } else {
         return false;
     }
 }
 
-CMDQueue& CommandQueue::GetNextQueue() {
-    queue_idx_++;
-    if (queue_idx_ == num_queues_) {
-        queue_idx_ = 0;
-    }
-    return queues_[queue_idx_];
-}
-
 void CommandQueue::GetRefQIndices(const Command& ref) {
     if (ref.cmd_type == CommandType::REFRESH) {
         if (queue_structure_ == QueueStructure::PER_BANK) {
@@ -154,6 +213,10 @@ void CommandQueue::GetRefQIndices(const Command& ref) {
         } else {
             ref_q_indices_.insert(ref.Rank());
         }
+    } else if (ref.cmd_type == CommandType::REFRESH_SAME_BANK) {
+        for (int j = 0; j < config_.bankgroups; j++) {
+            ref_q_indices_.insert(GetQueueIndex(ref.Rank(), j, ref.Bank()));
+        }
     } else {  // refb
         int idx = GetQueueIndex(ref.Rank(), ref.Bankgroup(), ref.Bank());
         ref_q_indices_.insert(idx);
@@ -170,11 +233,6 @@ int CommandQueue::GetQueueIndex(int rank, int bankgroup, int bank) const {
     }
 }
 
-CMDQueue& CommandQueue::GetQueue(int rank, int bankgroup, int bank) {
-    int index = GetQueueIndex(rank, bankgroup, bank);
-    return queues_[index];
-}
-
 Command CommandQueue::GetFirstReadyInQueue(CMDQueue& queue) const {
     for (auto cmd_it = queue.begin(); cmd_it != queue.end(); cmd_it++) {
         Command cmd = channel_state_.GetReadyCommand(*cmd_it, clk_);
@@ -182,7 +240,7 @@ Command CommandQueue::GetFirstReadyInQueue(CMDQueue& queue) const {
             continue;
         }
         if (cmd.cmd_type == CommandType::PRECHARGE) {
-            if (!ArbitratePrecharge(cmd_it, queue)) {
+            if (!ArbitratePrecharge(cmd_it, queue, cmd)) {
                 continue;
             }
         } else if (cmd.IsWrite()) {
@@ -196,10 +254,15 @@ Command CommandQueue::GetFirstReadyInQueue(CMDQueue& queue) const {
 }
 
 void CommandQueue::EraseRWCommand(const Command& cmd) {
-    auto& queue = GetQueue(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    int q_idx = GetQueueIndex(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
+    auto& queue = queues_[q_idx];
     for (auto cmd_it = queue.begin(); cmd_it != queue.end(); cmd_it++) {
         if (cmd.hex_addr == cmd_it->hex_addr && cmd.cmd_type == cmd_it->cmd_type) {
             queue.erase(cmd_it);
+            if (queue.empty()) {
+                occupied_mask_[q_idx / 64] &= ~(1ull << (q_idx % 64));
+            }
+            rank_q_empty[cmd.Rank()] = IsRankQueueEmpty(cmd.Rank());
             return;
         }
     }
@@ -207,6 +270,18 @@ void CommandQueue::EraseRWCommand(const Command& cmd) {
     exit(1);
 }
 
+bool CommandQueue::IsRankQueueEmpty(int rank) const {
+    if (queue_structure_ == QueueStructure::PER_RANK) {
+        return queues_[rank].empty();
+    }
+    for (int i = rank * config_.banks; i < (rank + 1) * config_.banks; i++) {
+        if (!queues_[i].empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int CommandQueue::QueueUsage() const {
     int usage = 0;
     for (auto i = queues_.begin(); i != queues_.end(); i++) {
@@ -21,6 +21,7 @@ class CommandQueue {
     Command GetCommandToIssue();
     Command FinishRefresh();
     void ClockTick() { clk_ += 1; };
+    void SkipCycles(uint64_t cycles) { clk_ += cycles; }
     bool WillAcceptCommand(int rank, int bankgroup, int bank) const;
     bool AddCommand(Command cmd);
     bool QueueEmpty() const;
@@ -28,16 +29,16 @@ class CommandQueue {
     std::vector<bool> rank_q_empty;
 
    private:
-    bool ArbitratePrecharge(const CMDIterator& cmd_it,
-                            const CMDQueue& queue) const;
+    bool ArbitratePrecharge(const CMDIterator& cmd_it, const CMDQueue& queue,
+                            const Command& pre) const;
     bool HasRWDependency(const CMDIterator& cmd_it,
                          const CMDQueue& queue) const;
     Command GetFirstReadyInQueue(CMDQueue& queue) const;
     int GetQueueIndex(int rank, int bankgroup, int bank) const;
-    CMDQueue& GetQueue(int rank, int bankgroup, int bank);
-    CMDQueue& GetNextQueue();
+    void UpdateReadyMask();
     void GetRefQIndices(const Command& ref);
     void EraseRWCommand(const Command& cmd);
+    bool IsRankQueueEmpty(int rank) const;
     Command PrepRefCmd(const CMDIterator& it, const Command& ref) const;
 
     QueueStructure queue_structure_;
@@ -47,6 +48,12 @@ class CommandQueue {
 
     std::vector<CMDQueue> queues_;
 
+    // one bit per queue, 64 queues to a word: the queues holding commands,
+    // and those of them a command may be ready in this cycle, so that the
+    // arbiter only scans queues that can issue
+    std::vector<uint64_t> occupied_mask_;
+    std::vector<uint64_t> ready_mask_;
+
     // Refresh related data structures
     std::unordered_set<int> ref_q_indices_;
     bool is_in_ref_;
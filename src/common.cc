@@ -6,23 +6,41 @@
 
 namespace dramsim3 {
 
+static const std::vector<std::string> command_string = {
+    "read",
+    "read_p",
+    "write",
+    "write_p",
+    "activate",
+    "precharge",
+    "refresh_bank",  // verilog model doesn't distinguish bank/rank refresh
+    "refresh",
+    "self_refresh_enter",
+    "self_refresh_exit",
+    "power_down_enter",
+    "power_down_exit",
+    "row_clone",
+    "refresh_same_bank",
+    "WRONG"};
+
+const std::string& CommandTypeName(CommandType cmd_type) {
+    return command_string[static_cast<int>(cmd_type)];
+}
+
+CommandType CommandTypeFromName(const std::string& name) {
+    for (size_t i = 0; i < command_string.size() - 1; i++) {
+        if (command_string[i] == name) {
+            return static_cast<CommandType>(i);
+        }
+    }
+    return CommandType::SIZE;
+}
+
 std::ostream& operator<<(std::ostream& os, const Command& cmd) {
-    std::vector<std::string> command_string = {
-        "read",
-        "read_p",
-        "write",
-        "write_p",
-        "activate",
-        "precharge",
-        "refresh_bank",  // verilog model doesn't distinguish bank/rank refresh
-        "refresh",
-        "self_refresh_enter",
-        "self_refresh_exit",
-        "WRONG"};
     os << fmt::format("{:<20} {:>3} {:>3} {:>3} {:>3} {:>#8x} {:>#8x}",
-                      command_string[static_cast<int>(cmd.cmd_type)],
-                      cmd.Channel(), cmd.Rank(), cmd.Bankgroup(), cmd.Bank(),
-                      cmd.Row(), cmd.Column());
+                      CommandTypeName(cmd.cmd_type), cmd.Channel(),
+                      cmd.Rank(), cmd.Bankgroup(), cmd.Bank(), cmd.Row(),
+                      cmd.Column());
     return os;
 }
 
@@ -34,10 +52,19 @@ std::ostream& operator<<(std::ostream& os, const Transaction& trans) {
 
 std::istream& operator>>(std::istream& is, Transaction& trans) {
     std::unordered_set<std::string> write_types = {"WRITE", "write", "P_MEM_WR",
-                                                   "BOFF"};
+                                                   "BOFF", "PARTIAL_WRITE"};
     std::string mem_op;
     is >> std::hex >> trans.addr >> mem_op >> std::dec >> trans.added_cycle;
     trans.is_write = write_types.count(mem_op) == 1;
+    trans.is_partial = mem_op == "PARTIAL_WRITE";
+    // ROW_COPY lines carry the source address after the cycle
+    trans.bulk_op = BulkOp::NONE;
+    if (mem_op == "ROW_COPY") {
+        trans.bulk_op = BulkOp::COPY;
+        is >> std::hex >> trans.src_addr >> std::dec;
+    } else if (mem_op == "ROW_INIT") {
+        trans.bulk_op = BulkOp::INIT;
+    }
     return is;
 }
 
@@ -91,4 +118,16 @@ bool DirExist(std::string dir) {
     }
 }
 
+int HistoPercentile(const std::map<int, uint64_t>& counts, uint64_t total,
+                    double fraction) {
+    uint64_t accu = 0;
+    for (const auto& it : counts) {
+        accu += it.second;
+        if (accu >= fraction * total) {
+            return it.first;
+        }
+    }
+    return 0;
+}
+
 }  // namespace dramsim3
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <iostream>
+#include <map>
+#include <string>
 #include <vector>
 
 namespace dramsim3 {
@@ -40,6 +42,20 @@ inline uint32_t ModuloWidth(uint64_t addr, uint32_t bit_width, uint32_t pos) {
     return static_cast<uint32_t>(store ^ addr);
 }
 
+// index of the lowest set bit, bits must not be 0
+inline int CountTrailingZeros(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int pos = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        pos++;
+    }
+    return pos;
+#endif
+}
+
 // extern std::function<Address(uint64_t)> AddressMapping;
 int GetBitInPos(uint64_t bits, int pos);
 // it's 2017 and c++ std::string still lacks a split function, oh well
@@ -50,6 +66,9 @@ void StringSplit(const std::string& s, char delim, Out result);
 int LogBase2(int power_of_two);
 void AbruptExit(const std::string& file, int line);
 bool DirExist(std::string dir);
+// smallest value with at least a fraction of the counts at or below it
+int HistoPercentile(const std::map<int, uint64_t>& counts, uint64_t total,
+                    double fraction);
 
 enum class CommandType {
     READ,
@@ -62,19 +81,38 @@ enum class CommandType {
     REFRESH,
     SREF_ENTER,
     SREF_EXIT,
+    // precharge power-down, the rank keeps refreshing from the controller
+    PD_ENTER,
+    PD_EXIT,
+    // in-DRAM row copy, ACT source, ACT destination then PRE back to back
+    ROW_CLONE,
+    REFRESH_SAME_BANK,  // DDR5 REFsb: same bank in every bankgroup
     SIZE
 };
 
+// names used in command traces, e.g. "activate", "read_p"
+const std::string& CommandTypeName(CommandType cmd_type);
+CommandType CommandTypeFromName(const std::string& name);
+
 struct Command {
-    Command() : cmd_type(CommandType::SIZE), hex_addr(0) {}
+    Command()
+        : cmd_type(CommandType::SIZE),
+          hex_addr(0),
+          source_id(0),
+          sample_slot(-1) {}
     Command(CommandType cmd_type, const Address& addr, uint64_t hex_addr)
-        : cmd_type(cmd_type), addr(addr), hex_addr(hex_addr) {}
+        : cmd_type(cmd_type),
+          addr(addr),
+          hex_addr(hex_addr),
+          source_id(0),
+          sample_slot(-1) {}
     // Command(const Command& cmd) {}
 
     bool IsValid() const { return cmd_type != CommandType::SIZE; }
     bool IsRefresh() const {
         return cmd_type == CommandType::REFRESH ||
-               cmd_type == CommandType::REFRESH_BANK;
+               cmd_type == CommandType::REFRESH_BANK ||
+               cmd_type == CommandType::REFRESH_SAME_BANK;
     }
     bool IsRead() const {
         return cmd_type == CommandType::READ ||
@@ -85,14 +123,21 @@ struct Command {
                cmd_type == CommandType ::WRITE_PRECHARGE;
     }
     bool IsReadWrite() const { return IsRead() || IsWrite(); }
+    bool IsRowClone() const { return cmd_type == CommandType::ROW_CLONE; }
     bool IsRankCMD() const {
         return cmd_type == CommandType::REFRESH ||
                cmd_type == CommandType::SREF_ENTER ||
-               cmd_type == CommandType::SREF_EXIT;
+               cmd_type == CommandType::SREF_EXIT ||
+               cmd_type == CommandType::PD_ENTER ||
+               cmd_type == CommandType::PD_EXIT;
     }
     CommandType cmd_type;
     Address addr;
     uint64_t hex_addr;
+    int source_id;  // core or tenant the command is issued for
+    // sample slot of the read it is issued for, kept by the PRE and ACT
+    // made from it, -1 if that read is not sampled
+    int sample_slot;
 
     int Channel() const { return addr.channel; }
     int Rank() const { return addr.rank; }
@@ -104,22 +149,74 @@ struct Command {
     friend std::ostream& operator<<(std::ostream& os, const Command& cmd);
 };
 
+// fixed size record for binary command traces, one per issued command
+struct CmdTraceRecord {
+    uint64_t clk;
+    int32_t row;
+    int32_t column;
+    uint8_t cmd_type;
+    uint8_t channel;
+    uint8_t rank;
+    uint8_t bankgroup;
+    uint8_t bank;
+    uint8_t padding[3];
+};
+
+// whole row operations, a copy from another row or an initialization
+// (a copy from a reserved zero row of the same subarray)
+enum class BulkOp { NONE, COPY, INIT };
+
 struct Transaction {
-    Transaction() {}
+    Transaction()
+        : is_partial(false),
+          is_internal(false),
+          source_id(0),
+          sample_slot(-1),
+          bulk_op(BulkOp::NONE),
+          src_addr(0),
+          is_bulk_line(false) {}
     Transaction(uint64_t addr, bool is_write)
         : addr(addr),
           added_cycle(0),
           complete_cycle(0),
-          is_write(is_write) {}
+          is_write(is_write),
+          is_partial(false),
+          is_internal(false),
+          source_id(0),
+          sample_slot(-1),
+          bulk_op(BulkOp::NONE),
+          src_addr(0),
+          is_bulk_line(false) {}
     Transaction(const Transaction& tran)
         : addr(tran.addr),
           added_cycle(tran.added_cycle),
           complete_cycle(tran.complete_cycle),
-          is_write(tran.is_write) {}
+          is_write(tran.is_write),
+          is_partial(tran.is_partial),
+          is_internal(tran.is_internal),
+          source_id(tran.source_id),
+          sample_slot(tran.sample_slot),
+          bulk_op(tran.bulk_op),
+          src_addr(tran.src_addr),
+          is_bulk_line(tran.is_bulk_line) {}
     uint64_t addr;
     uint64_t added_cycle;
     uint64_t complete_cycle;
     bool is_write;
+    // a sub-line write, or the ECC read issued on behalf of one
+    bool is_partial;
+    // issued by the controller itself (scrub, RMW), never returned to the CPU
+    bool is_internal;
+    int source_id;
+    // where the controller keeps the lifecycle stamps of a sampled read,
+    // -1 if it is not sampled
+    int sample_slot;
+    // row copy/init of the row containing addr, the source row for copies
+    BulkOp bulk_op;
+    uint64_t src_addr;
+    // a line of a row copy/init done with regular reads and writes, it
+    // returns to the memory system rather than to the CPU
+    bool is_bulk_line;
 
     friend std::ostream& operator<<(std::ostream& os, const Transaction& trans);
     friend std::istream& operator>>(std::istream& is, Transaction& trans);
@@ -1,5 +1,6 @@
 #include "configuration.h"
 
+#include <algorithm>
 #include <vector>
 
 #ifdef THERMAL
@@ -24,6 +25,10 @@ Config::Config(std::string config_file, std::string out_dir)
     InitTimingParams();
     InitPowerParams();
     InitOtherParams();
+    InitPartitionParams();
+    InitCXLParams();
+    InitNVMParams();
+    InitHMCNetworkParams();
 #ifdef THERMAL
     InitThermalParams();
 #endif  // THERMAL
@@ -41,6 +46,34 @@ Address Config::AddressMapping(uint64_t hex_addr) const {
     return Address(channel, rank, bg, ba, ro, co);
 }
 
+Address Config::AddressMapping(uint64_t hex_addr, int source_id) const {
+    Address addr = AddressMapping(hex_addr);
+    const auto& banks_allowed = partition_banks[source_id];
+    if (banks_allowed.empty()) {
+        return addr;
+    }
+    // like page coloring: the bank bits pick one of the allowed banks and
+    // what's left of them is folded into the row
+    int num_allowed = static_cast<int>(banks_allowed.size());
+    int flat_bank = addr.bankgroup * banks_per_group + addr.bank;
+    int new_bank = banks_allowed[flat_bank % num_allowed];
+    addr.bankgroup = new_bank / banks_per_group;
+    addr.bank = new_bank % banks_per_group;
+    int folds = (banks + num_allowed - 1) / num_allowed;
+    addr.row = (addr.row * folds + flat_bank / num_allowed) % rows;
+    return addr;
+}
+
+uint64_t Config::ReverseAddressMapping(const Address& addr) const {
+    uint64_t hex_addr = (static_cast<uint64_t>(addr.channel) << ch_pos) |
+                        (static_cast<uint64_t>(addr.rank) << ra_pos) |
+                        (static_cast<uint64_t>(addr.bankgroup) << bg_pos) |
+                        (static_cast<uint64_t>(addr.bank) << ba_pos) |
+                        (static_cast<uint64_t>(addr.row) << ro_pos) |
+                        (static_cast<uint64_t>(addr.column) << co_pos);
+    return hex_addr << shift_bits;
+}
+
 void Config::CalculateSize() {
     // calculate rank and re-calculate channel_size
     devices_per_rank = bus_width / device_width;
@@ -65,10 +98,12 @@ void Config::CalculateSize() {
 DRAMProtocol Config::GetDRAMProtocol(std::string protocol_str) {
     std::map<std::string, DRAMProtocol> protocol_pairs = {
         {"DDR3", DRAMProtocol::DDR3},     {"DDR4", DRAMProtocol::DDR4},
+        {"DDR5", DRAMProtocol::DDR5},
         {"GDDR5", DRAMProtocol::GDDR5},   {"GDDR5X", DRAMProtocol::GDDR5X},  {"GDDR6", DRAMProtocol::GDDR6},
         {"LPDDR", DRAMProtocol::LPDDR},   {"LPDDR3", DRAMProtocol::LPDDR3},
         {"LPDDR4", DRAMProtocol::LPDDR4}, {"HBM", DRAMProtocol::HBM},
-        {"HBM2", DRAMProtocol::HBM2},     {"HMC", DRAMProtocol::HMC}};
+        {"HBM2", DRAMProtocol::HBM2},     {"HMC", DRAMProtocol::HMC},
+        {"NVM", DRAMProtocol::NVM}};
 
     if (protocol_pairs.find(protocol_str) == protocol_pairs.end()) {
         std::cout << "Unkwown/Unsupported DRAM Protocol: " << protocol_str
@@ -98,7 +133,29 @@ void Config::InitDRAMParams() {
         bankgroups = 1;
     }
     banks = bankgroups * banks_per_group;
+    // DDR5 splits a DIMM channel into independent subchannels, each with its
+    // own command bus and controller, so we model every subchannel as a
+    // channel with a fraction of the DIMM bus width and capacity
+    subchannels =
+        GetInteger("dram_structure", "subchannels", IsDDR5() ? 2 : 1);
+    if (subchannels > 1) {
+        channels *= subchannels;
+        bus_width /= subchannels;
+        channel_size /= subchannels;
+    }
+    if (refresh_policy == RefreshPolicy::SAME_BANK_STAGGERED && !IsDDR5()) {
+        std::cerr << "SAME_BANK_STAGGERED refresh requires DDR5" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     rows = GetInteger("dram_structure", "rows", 1 << 16);
+    // 512 rows per subarray is typical for commodity DRAM
+    subarrays = GetInteger("dram_structure", "subarrays",
+                           std::max(1, rows / 512));
+    if (subarrays < 1 || rows % subarrays != 0) {
+        std::cerr << "Rows have to divide evenly into subarrays" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    rows_per_subarray = rows / subarrays;
     columns = GetInteger("dram_structure", "columns", 1 << 10);
     device_width = GetInteger("dram_structure", "device_width", 8);
     BL = GetInteger("dram_structure", "BL", 8);
@@ -113,6 +170,19 @@ void Config::InitDRAMParams() {
     link_speed = GetInteger("hmc", "link_speed", 15000);  //MHz
     block_size = GetInteger("hmc", "block_size", 64);
     xbar_queue_depth = GetInteger("hmc", "xbar_queue_depth", 16);
+    link_model = reader.GetBoolean("hmc", "link_model", false);
+    link_ber = reader.GetReal("hmc", "link_ber", 0.0);
+    retry_buffer_flits = GetInteger("hmc", "retry_buffer_flits", 256);
+    retry_latency = reader.GetReal("hmc", "retry_latency", 40.0);
+    link_tokens = GetInteger("hmc", "link_tokens", 0);
+    // up to a BER of 1e-3 the largest packets, 17 flits, still get through
+    // in a few replays, and the buffers have to hold one of them
+    if (link_model && (link_ber < 0.0 || link_ber > 1e-3 ||
+                       retry_buffer_flits < 17 ||
+                       (link_tokens != 0 && link_tokens < 17))) {
+        std::cerr << "Invalid HMC link model parameters" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     if (IsHMC()) {
         // the BL for HMC is determined by max block_size, which is a multiple
         // of 32B, each "device" transfer 32b per half cycle therefore BL is 8
@@ -176,7 +246,103 @@ void Config::InitOtherParams() {
         output_dir + reader.Get("other", "output_prefix", "dramsim3");
     json_stats_name = output_prefix + ".json";
     json_epoch_name = output_prefix + "epoch.json";
+    epoch_delta = reader.GetBoolean("other", "epoch_delta", false);
     txt_stats_name = output_prefix + ".txt";
+    system_stats = reader.GetBoolean("other", "system_stats", false);
+    json_system_name = output_prefix + "system.json";
+    json_system_epoch_name = output_prefix + "systemepoch.json";
+    // only effective in CMD_TRACE builds
+    cmd_trace_binary = reader.GetBoolean("other", "cmd_trace_binary", false);
+    record_requests = reader.GetBoolean("other", "record_requests", false);
+    latency_sample_interval =
+        GetInteger("other", "latency_sample_interval", 0);
+    return;
+}
+
+void Config::InitCXLParams() {
+    const auto& reader = *reader_;
+    cxl_enabled = reader.GetBoolean("cxl", "enabled", false);
+    // defaults are a x8 PCIe 5.0 link with 68B flits
+    cxl_link_bandwidth = reader.GetReal("cxl", "link_bandwidth", 32.0);
+    cxl_flit_bytes = GetInteger("cxl", "flit_bytes", 68);
+    double port_latency_ns = reader.GetReal("cxl", "port_latency", 25.0);
+    cxl_port_latency = static_cast<int>(port_latency_ns / tCK + 0.5);
+    cxl_credits = GetInteger("cxl", "credits", 64);
+    if (cxl_enabled && (IsHMC() || IsNVM())) {
+        std::cerr << "CXL expanders need a JEDEC DRAM backend" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return;
+}
+
+void Config::InitNVMParams() {
+    const auto& reader = *reader_;
+    // defaults are in the range reported for 3D XPoint media
+    double read_latency_ns = reader.GetReal("nvm", "read_latency", 150.0);
+    double write_latency_ns = reader.GetReal("nvm", "write_latency", 500.0);
+    nvm_read_latency = static_cast<int>(read_latency_ns / tCK + 0.5);
+    nvm_write_latency = static_cast<int>(write_latency_ns / tCK + 0.5);
+    nvm_write_budget = GetInteger("nvm", "write_budget", 4);
+    nvm_wpq_size = GetInteger("nvm", "wpq_size", 512);
+    if (nvm_write_budget < 1 || nvm_wpq_size < 1) {
+        std::cerr << "NVM needs a write budget and a write pending queue"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return;
+}
+
+void Config::InitHMCNetworkParams() {
+    const auto& reader = *reader_;
+    num_cubes = GetInteger("hmc", "num_cubes", 1);
+    cube_topology = reader.Get("hmc", "topology", "CHAIN");
+    double hop_latency_ns = reader.GetReal("hmc", "hop_latency", 10.0);
+    hop_latency = static_cast<int>(hop_latency_ns / tCK + 0.5);
+    double logic_latency_ns = reader.GetReal("hmc", "logic_latency", 5.0);
+    logic_latency = static_cast<int>(logic_latency_ns / tCK + 0.5);
+    cube_threads = GetInteger("hmc", "cube_threads", 1);
+    if (cube_topology != "CHAIN" && cube_topology != "STAR") {
+        std::cerr << "Unknown HMC topology " << cube_topology << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (num_cubes < 1 || cube_threads < 1) {
+        std::cerr << "Need at least one HMC cube and one thread" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (num_cubes > 1 && !IsHMC()) {
+        std::cerr << "Only HMC cubes can be chained" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return;
+}
+
+void Config::InitPartitionParams() {
+    const auto& reader = *reader_;
+    num_sources = GetInteger("partition", "num_sources", 1);
+    partition_banks.resize(num_sources);
+    for (int i = 0; i < num_sources; i++) {
+        // either a list of banks or of whole bankgroups, e.g.
+        // source0_banks = 0,1,2,3 or source1_bankgroups = 2,3
+        std::string src = "source" + std::to_string(i);
+        for (const auto& token :
+             StringSplit(reader.Get("partition", src + "_banks", ""), ',')) {
+            partition_banks[i].push_back(std::stoi(token));
+        }
+        for (const auto& token : StringSplit(
+                 reader.Get("partition", src + "_bankgroups", ""), ',')) {
+            int bg = std::stoi(token);
+            for (int k = 0; k < banks_per_group; k++) {
+                partition_banks[i].push_back(bg * banks_per_group + k);
+            }
+        }
+        for (auto bank : partition_banks[i]) {
+            if (bank < 0 || bank >= banks) {
+                std::cerr << "Invalid bank " << bank << " in partition of "
+                          << src << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+            }
+        }
+    }
     return;
 }
 
@@ -193,6 +359,7 @@ void Config::InitPowerParams() {
     double IDD4R = reader.GetReal("power", "IDD4R", 135);
     double IDD5AB = reader.GetReal("power", "IDD5AB", 250);  // all-bank ref
     double IDD5PB = reader.GetReal("power", "IDD5PB", 5);    // per-bank ref
+    double IDD5C = reader.GetReal("power", "IDD5C", 100);    // same-bank ref
     double IDD6x = reader.GetReal("power", "IDD6x", 31);
 
     // energy increments per command/cycle, calculated as voltage * current *
@@ -206,11 +373,14 @@ void Config::InitPowerParams() {
     write_energy_inc = VDD * (IDD4W - IDD3N) * burst_cycle * devices;
     ref_energy_inc = VDD * (IDD5AB - IDD3N) * tRFC * devices;
     refb_energy_inc = VDD * (IDD5PB - IDD3N) * tRFCb * devices;
+    refsb_energy_inc = VDD * (IDD5C - IDD3N) * tRFCsb * devices;
     // the following are added per cycle
     act_stb_energy_inc = VDD * IDD3N * devices;
     pre_stb_energy_inc = VDD * IDD2N * devices;
     pre_pd_energy_inc = VDD * IDD2P * devices;
     sref_energy_inc = VDD * IDD6x * devices;
+    // two activations sharing one precharge
+    row_clone_energy_inc = 2 * act_energy_inc;
     return;
 }
 
@@ -234,6 +404,8 @@ void Config::InitSystemParams() {
         refresh_policy = RefreshPolicy::RANK_LEVEL_STAGGERED;
     } else if (ref_policy == "BANK_LEVEL_STAGGERED") {
         refresh_policy = RefreshPolicy::BANK_LEVEL_STAGGERED;
+    } else if (ref_policy == "SAME_BANK_STAGGERED") {
+        refresh_policy = RefreshPolicy::SAME_BANK_STAGGERED;
     } else {
         AbruptExit(__FILE__, __LINE__);
     }
@@ -241,9 +413,35 @@ void Config::InitSystemParams() {
     enable_self_refresh =
         reader.GetBoolean("system", "enable_self_refresh", false);
     sref_threshold = GetInteger("system", "sref_threshold", 1000);
+    power_governor = reader.GetBoolean("system", "power_governor", false);
     aggressive_precharging_enabled =
         reader.GetBoolean("system", "aggressive_precharging_enabled", false);
 
+    // ECC background traffic
+    scrub_interval = GetInteger("ecc", "scrub_interval", 0);
+    scrub_backlog = GetInteger("ecc", "scrub_backlog", 16);
+    ecc_rmw = reader.GetBoolean("ecc", "ecc_rmw", false);
+
+    row_clone = reader.GetBoolean("system", "row_clone", false);
+    std::string salp_mode = reader.Get("system", "salp", "NONE");
+    if (salp_mode == "NONE") {
+        salp = SALPMode::NONE;
+    } else if (salp_mode == "SALP1") {
+        salp = SALPMode::SALP1;
+    } else if (salp_mode == "SALP2") {
+        salp = SALPMode::SALP2;
+    } else if (salp_mode == "MASA") {
+        salp = SALPMode::MASA;
+    } else {
+        std::cerr << "Unknown salp mode " << salp_mode << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    masa_subarrays = GetInteger("system", "masa_subarrays", 4);
+    if (masa_subarrays < 1) {
+        std::cerr << "MASA needs at least one subarray" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+
     return;
 }
 
@@ -304,6 +502,7 @@ void Config::InitTimingParams() {
     tCCD_L = GetInteger("timing", "tCCD_L", 6);
     tCCD_S = GetInteger("timing", "tCCD_S", 4);
     tRTRS = GetInteger("timing", "tRTRS", 2);
+    tODTSW = GetInteger("timing", "tODTSW", 0);
     tRTP = GetInteger("timing", "tRTP", 5);
     tWTR_L = GetInteger("timing", "tWTR_L", 5);
     tWTR_S = GetInteger("timing", "tWTR_S", 5);
@@ -319,6 +518,8 @@ void Config::InitTimingParams() {
     tCKESR = GetInteger("timing", "tCKESR", 12);
     tXS = GetInteger("timing", "tXS", 432);
     tXP = GetInteger("timing", "tXP", 8);
+    // a power-down has to last tCKE and costs tXP to leave
+    pd_threshold = GetInteger("system", "pd_threshold", tCKE + tXP);
     tRFCb = GetInteger("timing", "tRFCb", 20);
     tREFI = GetInteger("timing", "tREFI", 7800);
     tREFIb = GetInteger("timing", "tREFIb", 1950);
@@ -334,6 +535,43 @@ void Config::InitTimingParams() {
     tRCDRD = GetInteger("timing", "tRCDRD", 24);
     tRCDWR = GetInteger("timing", "tRCDWR", 20);
 
+    // DDR5, write to write in the same bankgroup is much longer than tCCD_L
+    tCCD_L_WR = GetInteger("timing", "tCCD_L_WR", tCCD_L);
+    tRFCsb = GetInteger("timing", "tRFCsb", tRFCb);
+    tREFSBRD = GetInteger("timing", "tREFSBRD", tRRD_L);
+
+    // the destination row is activated once the source row is fully sensed
+    // and both have to be restored before the precharge
+    tCLONE = GetInteger("timing", "tCLONE", 2 * tRAS);
+
+    // LPDDR4 sends most commands in 2 or 4 slots of its narrow CA bus,
+    // DDR5 ACT/RD/WR take 2 slots, HBM has a row bus and a column bus
+    ca_bus_model = reader.GetBoolean("system", "ca_bus_model", false);
+    command_rate = GetInteger("system", "command_rate", 1);
+    if (command_rate != 1 && command_rate != 2) {
+        std::cerr << "Command rate can only be 1N or 2N" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    int act_slots = 1, cas_slots = 1, pre_slots = 1, ref_slots = 1;
+    if (protocol == DRAMProtocol::LPDDR4) {
+        act_slots = 4;
+        cas_slots = 4;
+        pre_slots = 2;
+        ref_slots = 2;
+    } else if (IsDDR5() || IsHBM()) {
+        act_slots = 2;
+        cas_slots = IsHBM() ? 1 : 2;
+    }
+    split_ca_bus = IsHBM();
+    act_cmd_cycles =
+        GetInteger("timing", "act_cmd_cycles", act_slots * command_rate);
+    cas_cmd_cycles =
+        GetInteger("timing", "cas_cmd_cycles", cas_slots * command_rate);
+    pre_cmd_cycles =
+        GetInteger("timing", "pre_cmd_cycles", pre_slots * command_rate);
+    ref_cmd_cycles =
+        GetInteger("timing", "ref_cmd_cycles", ref_slots * command_rate);
+
     ideal_memory_latency = GetInteger("timing", "ideal_memory_latency", 10);
 
     // calculated timing
@@ -344,6 +582,25 @@ void Config::InitTimingParams() {
     return;
 }
 
+int Config::CommandCycles(CommandType cmd_type) const {
+    switch (cmd_type) {
+        case CommandType::READ:
+        case CommandType::READ_PRECHARGE:
+        case CommandType::WRITE:
+        case CommandType::WRITE_PRECHARGE:
+            return cas_cmd_cycles;
+        case CommandType::ACTIVATE:
+            return act_cmd_cycles;
+        case CommandType::PRECHARGE:
+            return pre_cmd_cycles;
+        case CommandType::ROW_CLONE:
+            // ACT, ACT, PRE
+            return 2 * act_cmd_cycles + pre_cmd_cycles;
+        default:
+            return ref_cmd_cycles;
+    }
+}
+
 void Config::SetAddressMapping() {
     // memory addresses are byte addressable, but each request comes with
     // multiple bytes because of bus width, and burst length
@@ -12,6 +12,7 @@ namespace dramsim3 {
 enum class DRAMProtocol {
     DDR3,
     DDR4,
+    DDR5,
     GDDR5,
     GDDR5X,
     GDDR6,
@@ -21,6 +22,7 @@ enum class DRAMProtocol {
     HBM,
     HBM2,
     HMC,
+    NVM,  // PCM/3D XPoint-like non-volatile memory
     SIZE
 };
 
@@ -28,13 +30,23 @@ enum class RefreshPolicy {
     RANK_LEVEL_SIMULTANEOUS,  // impractical due to high power requirement
     RANK_LEVEL_STAGGERED,
     BANK_LEVEL_STAGGERED,
+    SAME_BANK_STAGGERED,  // DDR5 REFsb, one bank index across all bankgroups
     SIZE 
 };
 
+// Subarray-level parallelism (Kim et al., ISCA 2012). SALP1 overlaps the
+// precharge of one subarray with the activation of another, SALP2 also
+// lets a second subarray be activated before the first is precharged, and
+// MASA keeps any number of subarrays activated and accessible
+enum class SALPMode { NONE, SALP1, SALP2, MASA, SIZE };
+
 class Config {
    public:
     Config(std::string config_file, std::string out_dir);
     Address AddressMapping(uint64_t hex_addr) const;
+    // address mapping restricted to the banks partitioned to source_id
+    Address AddressMapping(uint64_t hex_addr, int source_id) const;
+    uint64_t ReverseAddressMapping(const Address& addr) const;
     // DRAM physical structure
     DRAMProtocol protocol;
     int channel_size;
@@ -44,9 +56,12 @@ class Config {
     int bankgroups;
     int banks_per_group;
     int rows;
+    int subarrays;  // per bank, rows of a subarray share local row buffers
+    int rows_per_subarray;
     int columns;
     int device_width;
     int bus_width;
+    int subchannels;  // independent subchannels per channel, e.g. 2 for DDR5
     int devices_per_rank;
     int BL;
 
@@ -66,6 +81,7 @@ class Config {
     int tCCD_L;
     int tCCD_S;
     int tRTRS;
+    int tODTSW;  // extra gap between write bursts to different ranks (ODT)
     int tRTP;
     int tWTR_L;
     int tWTR_S;
@@ -98,6 +114,17 @@ class Config {
     int t32AW;
     int tRCDRD;
     int tRCDWR;
+    // DDR5
+    int tCCD_L_WR;
+    int tRFCsb;
+    int tREFSBRD;
+    // RowClone, ACT of the source row to the implicit PRE of the destination
+    int tCLONE;
+    // command/address bus slots a command takes, with ca_bus_model
+    int act_cmd_cycles;
+    int cas_cmd_cycles;
+    int pre_cmd_cycles;
+    int ref_cmd_cycles;  // and the other rank commands
 
     // pre calculated power parameters
     double act_energy_inc;
@@ -106,10 +133,12 @@ class Config {
     double write_energy_inc;
     double ref_energy_inc;
     double refb_energy_inc;
+    double refsb_energy_inc;
     double act_stb_energy_inc;
     double pre_stb_energy_inc;
     double pre_pd_energy_inc;
     double sref_energy_inc;
+    double row_clone_energy_inc;
 
     // HMC
     int num_links;
@@ -119,6 +148,19 @@ class Config {
     int num_vaults;
     int block_size;  // block size in bytes
     int xbar_queue_depth;
+    // host link SerDes: flit serialization, token flow control, retry
+    // buffers and replays of packets failing their CRC
+    bool link_model;
+    double link_ber;          // bit error rate
+    int retry_buffer_flits;   // per link and direction
+    double retry_latency;     // ns, from a CRC error to the replay
+    int link_tokens;          // flits of a link input buffer, 0 for no limit
+    // cubes chained behind the host cube with device-to-device links
+    int num_cubes;
+    std::string cube_topology;  // CHAIN or STAR
+    int hop_latency;            // per device-to-device hop, in cycles
+    int logic_latency;          // logic layer at the end of a hop, in cycles
+    int cube_threads;           // threads ticking the cubes
 
     // System
     std::string address_mapping;
@@ -131,8 +173,41 @@ class Config {
     int write_buf_size;
     bool enable_self_refresh;
     int sref_threshold;
+    // with enable_self_refresh, predict idle periods to choose between
+    // power-down and self-refresh instead of waiting for sref_threshold
+    bool power_governor;
+    int pd_threshold;  // idle cycles for a power-down to pay off
     bool aggressive_precharging_enabled;
+    int scrub_interval;  // cycles between patrol scrub reads, 0 disables
+    int scrub_backlog;   // overdue scrubs that are issued regardless of load
+    bool ecc_rmw;        // read-modify-write for partial writes
+    // copy/init rows inside a subarray instead of moving them over the bus
+    bool row_clone;
+    SALPMode salp;
+    int masa_subarrays;  // most subarrays MASA keeps activated in a bank
+
+    // CXL Type-3 expander in front of the DRAM
+    bool cxl_enabled;
+    double cxl_link_bandwidth;  // GB/s per direction
+    int cxl_flit_bytes;
+    int cxl_port_latency;  // one way, in cycles
+    int cxl_credits;       // requests the device can buffer
+
+    // NVM media, in cycles
+    int nvm_read_latency;
+    int nvm_write_latency;
+    int nvm_write_budget;  // writes in flight per channel
+    int nvm_wpq_size;      // write pending queue entries per channel
+
+    // Bank partitioning, the (flat) bank indices each source may use,
+    // an empty list means all banks
+    int num_sources;
+    std::vector<std::vector<int> > partition_banks;
     bool enable_hbm_dual_cmd;
+    // reserve the command/address bus for multi-cycle commands
+    bool ca_bus_model;
+    int command_rate;   // 1N or 2N command timing
+    bool split_ca_bus;  // separate row and column command buses, as HBM
 
 
     int epoch_period;
@@ -141,7 +216,18 @@ class Config {
     std::string output_prefix;
     std::string json_stats_name;
     std::string json_epoch_name;
+    // epoch records only hold the stats that changed since the last one
+    bool epoch_delta;
     std::string txt_stats_name;
+    // totals and channel imbalance over all channels, in their own files
+    bool system_stats;
+    std::string json_system_name;
+    std::string json_system_epoch_name;
+    bool cmd_trace_binary;
+    // log every MemorySystem call for dramsim3replay
+    bool record_requests;
+    // trace the lifecycle of every Nth read, 0 disables
+    int latency_sample_interval;
 
     // Computed parameters
     int request_size_bytes;
@@ -156,8 +242,16 @@ class Config {
                 protocol == DRAMProtocol::HBM2);
     }
     bool IsHMC() const { return (protocol == DRAMProtocol::HMC); }
+    bool IsNVM() const { return (protocol == DRAMProtocol::NVM); }
     // yzy: add another function
     bool IsDDR4() const { return (protocol == DRAMProtocol::DDR4); }
+    bool IsDDR5() const { return (protocol == DRAMProtocol::DDR5); }
+    // the subarray whose row buffer holds row in the bank model, there is
+    // one row buffer per bank without SALP
+    int SubarrayOf(int row) const {
+        return salp == SALPMode::NONE ? 0 : row / rows_per_subarray;
+    }
+    int CommandCycles(CommandType cmd_type) const;
 
     int ideal_memory_latency;
 
@@ -190,6 +284,10 @@ class Config {
                    int default_val) const;
     void InitDRAMParams();
     void InitOtherParams();
+    void InitPartitionParams();
+    void InitCXLParams();
+    void InitNVMParams();
+    void InitHMCNetworkParams();
     void InitPowerParams();
     void InitSystemParams();
 #ifdef THERMAL
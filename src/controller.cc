@@ -1,4 +1,5 @@
 #include "controller.h"
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -18,6 +19,7 @@ Controller::Controller(int channel, const Config &config, const Timing &timing)
       channel_state_(config, timing),
       cmd_queue_(channel_id_, config, channel_state_, simple_stats_),
       refresh_(config, channel_state_),
+      power_governor_(config, channel_state_, simple_stats_),
 #ifdef THERMAL
       thermal_calc_(thermal_calc),
 #endif  // THERMAL
@@ -26,19 +28,32 @@ Controller::Controller(int channel, const Config &config, const Timing &timing)
                           ? RowBufPolicy::CLOSE_PAGE
                           : RowBufPolicy::OPEN_PAGE),
       last_trans_clk_(0),
-      write_draining_(0) {
+      scrub_line_(0),
+      scrub_owed_(0),
+      internal_reads_pending_(0),
+      reads_to_sample_(0),
+      write_draining_(0),
+      rank_pending_(config.ranks, 0),
+      rank_busy_(config.ranks, false) {
+    scrub_lines_ = static_cast<uint64_t>(config_.co_mask + 1) *
+                   config_.banks * config_.ranks * config_.rows;
     if (is_unified_queue_) {
         unified_queue_.reserve(config_.trans_queue_size);
     } else {
         read_queue_.reserve(config_.trans_queue_size);
         write_buffer_.reserve(config_.trans_queue_size);
     }
+    if (config_.latency_sample_interval > 0) {
+        bank_ref_clk_.resize(config_.ranks * config_.banks, 0);
+    }
 
 #ifdef CMD_TRACE
-    std::string trace_file_name = config_.output_prefix + "ch_" +
-                                  std::to_string(channel_id_) + "cmd.trace";
+    std::string trace_file_name =
+        config_.output_prefix + "ch_" + std::to_string(channel_id_) +
+        (config_.cmd_trace_binary ? "cmd.bin" : "cmd.trace");
     std::cout << "Command Trace write to " << trace_file_name << std::endl;
-    cmd_trace_.open(trace_file_name, std::ofstream::out);
+    cmd_trace_.open(trace_file_name,
+                    std::ofstream::out | std::ofstream::binary);
 #endif  // CMD_TRACE
 }
 
@@ -46,13 +61,27 @@ std::pair<uint64_t, int> Controller::ReturnDoneTrans(uint64_t clk) {
     auto it = return_queue_.begin();
     while (it != return_queue_.end()) {
         if (clk >= it->complete_cycle) {
-            if (it->is_write) {
+            if (it->is_internal) {
+                // the data is consumed by the controller itself
+                if (it->is_partial) {
+                    ReleaseRMWWrites(it->addr);
+                }
+                it = return_queue_.erase(it);
+                continue;
+            }
+            if (it->bulk_op != BulkOp::NONE) {
+                // counted as row clones, the row never crossed the bus
+            } else if (it->is_write) {
                 simple_stats_.Increment("num_writes_done");
             } else {
                 simple_stats_.Increment("num_reads_done");
                 simple_stats_.AddValue("read_latency", clk_ - it->added_cycle);
             }
-            auto pair = std::make_pair(it->addr, it->is_write);
+            int type = it->is_write ? 1 : 0;
+            if (it->is_bulk_line) {
+                type += 2;
+            }
+            auto pair = std::make_pair(it->addr, type);
             it = return_queue_.erase(it);
             return pair;
         } else {
@@ -96,6 +125,8 @@ void Controller::ClockTick() {
     for (int i = 0; i < config_.ranks; i++) {
         if (channel_state_.IsRankSelfRefreshing(i)) {
             simple_stats_.IncrementVec("sref_cycles", i);
+        } else if (channel_state_.IsRankPoweredDown(i)) {
+            simple_stats_.IncrementVec("pd_cycles", i);
         } else {
             bool all_idle = channel_state_.IsAllBankIdleInRank(i);
             if (all_idle) {
@@ -109,38 +140,21 @@ void Controller::ClockTick() {
         }
     }
 
-    // power updates pt 2: move idle ranks into self-refresh mode to save power
-    if (config_.enable_self_refresh && !cmd_issued) {
-        for (auto i = 0; i < config_.ranks; i++) {
-            if (channel_state_.IsRankSelfRefreshing(i)) {
-                // wake up!
-                if (!cmd_queue_.rank_q_empty[i]) {
-                    auto addr = Address();
-                    addr.rank = i;
-                    auto cmd = Command(CommandType::SREF_EXIT, addr, -1);
-                    cmd = channel_state_.GetReadyCommand(cmd, clk_);
-                    if (cmd.IsValid()) {
-                        IssueCommand(cmd);
-                        break;
-                    }
-                }
-            } else {
-                if (cmd_queue_.rank_q_empty[i] &&
-                    channel_state_.rank_idle_cycles[i] >=
-                        config_.sref_threshold) {
-                    auto addr = Address();
-                    addr.rank = i;
-                    auto cmd = Command(CommandType::SREF_ENTER, addr, -1);
-                    cmd = channel_state_.GetReadyCommand(cmd, clk_);
-                    if (cmd.IsValid()) {
-                        IssueCommand(cmd);
-                        break;
-                    }
-                }
+    // power updates pt 2: move idle ranks into power-down or self-refresh
+    // mode to save power, and wake them up for requests
+    if (config_.enable_self_refresh) {
+        UpdateRankBusy();
+        power_governor_.Update(rank_busy_);
+        if (!cmd_issued) {
+            cmd = power_governor_.GetCommandToIssue(rank_busy_);
+            if (cmd.IsValid()) {
+                IssueCommand(cmd);
             }
         }
+        power_governor_.ClockTick();
     }
 
+    ScheduleInternalReads();
     ScheduleTransaction();
     clk_++;
     cmd_queue_.ClockTick();
@@ -148,29 +162,109 @@ void Controller::ClockTick() {
     return;
 }
 
+uint64_t Controller::NextEventCycle() const {
+    // anything queued is worked on every cycle, except for a few writes
+    // sitting in the write buffer until more of them pile up
+    bool writes_wait = !is_unified_queue_ && write_draining_ == 0 &&
+                       write_buffer_.size() <= 8 &&
+                       write_buffer_.size() < write_buffer_.capacity() &&
+                       !BulkOpsWaiting();
+    if (!unified_queue_.empty() || !read_queue_.empty() ||
+        (!write_buffer_.empty() && !writes_wait) || !pending_rd_q_.empty() ||
+        !rmw_read_q_.empty() || !rmw_wait_q_.empty() || scrub_owed_ > 0 ||
+        !cmd_queue_.QueueEmpty() || channel_state_.IsRefreshWaiting()) {
+        return clk_;
+    }
+    uint64_t next = refresh_.NextRefreshCycle();
+    for (const auto &trans : return_queue_) {
+        next = std::min(next, trans.complete_cycle);
+    }
+    if (config_.scrub_interval > 0) {
+        uint64_t interval = static_cast<uint64_t>(config_.scrub_interval);
+        uint64_t scrub = clk_ == 0 ? interval
+                                   : (clk_ + interval - 1) / interval * interval;
+        next = std::min(next, scrub);
+    }
+    if (config_.enable_self_refresh) {
+        next = std::min(next, power_governor_.NextEventCycle());
+    }
+    return std::max(next, clk_);
+}
+
+void Controller::SkipCycles(uint64_t cycles) {
+    // nothing is issued, so the rank states hold for all of these cycles
+    int num = static_cast<int>(cycles);
+    refresh_.SkipCycles(cycles);
+    for (int i = 0; i < config_.ranks; i++) {
+        if (channel_state_.IsRankSelfRefreshing(i)) {
+            simple_stats_.IncrementVecBy("sref_cycles", i, num);
+        } else if (channel_state_.IsRankPoweredDown(i)) {
+            simple_stats_.IncrementVecBy("pd_cycles", i, num);
+        } else if (channel_state_.IsAllBankIdleInRank(i)) {
+            simple_stats_.IncrementVecBy("all_bank_idle_cycles", i, num);
+            channel_state_.rank_idle_cycles[i] += num;
+        } else {
+            simple_stats_.IncrementVecBy("rank_active_cycles", i, num);
+            channel_state_.rank_idle_cycles[i] = 0;
+        }
+    }
+    if (config_.enable_self_refresh) {
+        power_governor_.SkipCycles(cycles);
+    }
+    clk_ += cycles;
+    cmd_queue_.SkipCycles(cycles);
+    simple_stats_.IncrementBy("num_cycles", num);
+    return;
+}
+
 bool Controller::WillAcceptTransaction(uint64_t hex_addr, bool is_write) const {
     if (is_unified_queue_) {
-        return unified_queue_.size() < unified_queue_.capacity();
+        return unified_queue_.size() + rmw_wait_q_.size() <
+               unified_queue_.capacity();
     } else if (!is_write) {
         return read_queue_.size() < read_queue_.capacity();
     } else {
-        return write_buffer_.size() < write_buffer_.capacity();
+        return write_buffer_.size() + rmw_wait_q_.size() <
+               write_buffer_.capacity();
     }
 }
 
 bool Controller::AddTransaction(Transaction trans) {
+    if (trans.source_id < 0 || trans.source_id >= config_.num_sources) {
+        std::cerr << "Source " << trans.source_id << " out of range, only "
+                  << config_.num_sources << " sources configured" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     trans.added_cycle = clk_;
     simple_stats_.AddValue("interarrival_latency", clk_ - last_trans_clk_);
     last_trans_clk_ = clk_;
 
-    if (trans.is_write) {
+    if (trans.bulk_op != BulkOp::NONE) {
+        // scheduled with the writes, completes once the row is cloned
+        pending_bulk_q_.insert(std::make_pair(trans.addr, trans));
+        EnqueueTransaction(trans);
+        return true;
+    } else if (trans.is_write && trans.is_partial && config_.ecc_rmw &&
+        pending_wr_q_.count(trans.addr) == 0) {
+        // the rest of the line has to be read (and corrected) before the
+        // merged line with its new ECC can be written back
+        simple_stats_.Increment("num_partial_writes");
+        if (rmw_wait_q_.count(trans.addr) == 0) {
+            Transaction read_trans(trans.addr, false);
+            read_trans.is_partial = true;
+            read_trans.is_internal = true;
+            // same partition, and so the same bank, as the write
+            read_trans.source_id = trans.source_id;
+            rmw_read_q_.push_back(read_trans);
+        }
+        rmw_wait_q_.insert(std::make_pair(trans.addr, trans));
+        trans.complete_cycle = clk_ + 1;
+        return_queue_.push_back(trans);
+        return true;
+    } else if (trans.is_write) {
         if (pending_wr_q_.count(trans.addr) == 0) {  // can not merge writes
             pending_wr_q_.insert(std::make_pair(trans.addr, trans));
-            if (is_unified_queue_) {
-                unified_queue_.push_back(trans);
-            } else {
-                write_buffer_.push_back(trans);
-            }
+            EnqueueTransaction(trans);
         }
         trans.complete_cycle = clk_ + 1;
         return_queue_.push_back(trans);
@@ -182,24 +276,125 @@ bool Controller::AddTransaction(Transaction trans) {
             return_queue_.push_back(trans);
             return true;
         }
+        // only reads that get their own command are sampled
+        if (config_.latency_sample_interval > 0 &&
+            pending_rd_q_.count(trans.addr) == 0) {
+            if (reads_to_sample_ == 0) {
+                trans.sample_slot = NewSampleSlot();
+                reads_to_sample_ = config_.latency_sample_interval;
+            }
+            reads_to_sample_--;
+        }
         pending_rd_q_.insert(std::make_pair(trans.addr, trans));
         if (pending_rd_q_.count(trans.addr) == 1) {
-            if (is_unified_queue_) {
-                unified_queue_.push_back(trans);
-            } else {
-                read_queue_.push_back(trans);
-            }
+            EnqueueTransaction(trans);
         }
         return true;
     }
 }
 
+void Controller::EnqueueTransaction(const Transaction &trans) {
+    if (is_unified_queue_) {
+        unified_queue_.push_back(trans);
+    } else if (trans.is_write || trans.bulk_op != BulkOp::NONE) {
+        write_buffer_.push_back(trans);
+    } else {
+        read_queue_.push_back(trans);
+    }
+    rank_pending_[config_.AddressMapping(trans.addr).rank]++;
+}
+
+void Controller::UpdateRankBusy() {
+    // a rank is needed as soon as a request for it is in the transaction
+    // queues, before it gets into the command queue
+    for (int i = 0; i < config_.ranks; i++) {
+        rank_busy_[i] = !cmd_queue_.rank_q_empty[i] || rank_pending_[i] > 0;
+    }
+    return;
+}
+
+bool Controller::ReadQueueHasRoom() const {
+    if (is_unified_queue_) {
+        return unified_queue_.size() + rmw_wait_q_.size() <
+               unified_queue_.capacity();
+    } else {
+        return read_queue_.size() < read_queue_.capacity();
+    }
+}
+
+void Controller::ScheduleInternalReads() {
+    if (config_.scrub_interval > 0 && clk_ > 0 &&
+        clk_ % config_.scrub_interval == 0) {
+        scrub_owed_++;
+    }
+
+    // RMW reads hold up writes so they go first
+    while (!rmw_read_q_.empty() && ReadQueueHasRoom()) {
+        AddInternalRead(rmw_read_q_.front());
+        rmw_read_q_.erase(rmw_read_q_.begin());
+    }
+
+    // scrub in idle slots, unless we fall too far behind the target rate
+    if (scrub_owed_ > 0 && ReadQueueHasRoom()) {
+        bool idle = is_unified_queue_
+                        ? unified_queue_.empty()
+                        : read_queue_.empty() && write_buffer_.empty();
+        if (idle || scrub_owed_ >= config_.scrub_backlog) {
+            AddInternalRead(NextScrubTransaction());
+            scrub_owed_--;
+        }
+    }
+}
+
+void Controller::AddInternalRead(Transaction trans) {
+    trans.added_cycle = clk_;
+    internal_reads_pending_++;
+    pending_rd_q_.insert(std::make_pair(trans.addr, trans));
+    // merged with a pending read to the same line otherwise
+    if (pending_rd_q_.count(trans.addr) == 1) {
+        EnqueueTransaction(trans);
+    }
+}
+
+Transaction Controller::NextScrubTransaction() {
+    // walk through all columns of a row first, then across banks and ranks
+    // so that most scrub reads are row buffer hits
+    uint64_t line = scrub_line_;
+    scrub_line_ = (scrub_line_ + 1) % scrub_lines_;
+    Address addr;
+    addr.channel = channel_id_;
+    addr.column = line % (config_.co_mask + 1);
+    line /= (config_.co_mask + 1);
+    addr.bank = line % config_.banks_per_group;
+    line /= config_.banks_per_group;
+    addr.bankgroup = line % config_.bankgroups;
+    line /= config_.bankgroups;
+    addr.rank = line % config_.ranks;
+    addr.row = line / config_.ranks;
+    Transaction trans(config_.ReverseAddressMapping(addr), false);
+    trans.is_internal = true;
+    return trans;
+}
+
+void Controller::ReleaseRMWWrites(uint64_t hex_addr) {
+    auto range = rmw_wait_q_.equal_range(hex_addr);
+    for (auto it = range.first; it != range.second; it++) {
+        simple_stats_.AddValue("rmw_latency", clk_ - it->second.added_cycle);
+        if (pending_wr_q_.count(hex_addr) == 0) {  // otherwise merged
+            pending_wr_q_.insert(std::make_pair(hex_addr, it->second));
+            EnqueueTransaction(it->second);
+        }
+    }
+    rmw_wait_q_.erase(range.first, range.second);
+}
+
 void Controller::ScheduleTransaction() {
     // determine whether to schedule read or write
     if (write_draining_ == 0 && !is_unified_queue_) {
         // we basically have a upper and lower threshold for write buffer
         if ((write_buffer_.size() >= write_buffer_.capacity()) ||
-            (write_buffer_.size() > 8 && cmd_queue_.QueueEmpty())) {
+            (write_buffer_.size() > 8 && cmd_queue_.QueueEmpty()) ||
+            BulkOpsWaiting()) {
             write_draining_ = write_buffer_.size();
         }
     }
@@ -211,7 +406,7 @@ void Controller::ScheduleTransaction() {
         auto cmd = TransToCommand(*it);
         if (cmd_queue_.WillAcceptCommand(cmd.Rank(), cmd.Bankgroup(),
                                          cmd.Bank())) {
-            if (!is_unified_queue_ && cmd.IsWrite()) {
+            if (!is_unified_queue_ && (cmd.IsWrite() || cmd.IsRowClone())) {
                 // Enforce R->W dependency
                 if (pending_rd_q_.count(it->addr) > 0) {
                     write_draining_ = 0;
@@ -219,7 +414,11 @@ void Controller::ScheduleTransaction() {
                 }
                 write_draining_ -= 1;
             }
+            if (it->sample_slot >= 0) {
+                samples_[it->sample_slot].scheduled_cycle = clk_;
+            }
             cmd_queue_.AddCommand(cmd);
+            rank_pending_[cmd.Rank()]--;
             queue.erase(it);
             break;
         }
@@ -228,7 +427,21 @@ void Controller::ScheduleTransaction() {
 
 void Controller::IssueCommand(const Command &cmd) {
 #ifdef CMD_TRACE
-    cmd_trace_ << std::left << std::setw(18) << clk_ << " " << cmd << std::endl;
+    if (config_.cmd_trace_binary) {
+        CmdTraceRecord rec = {};
+        rec.clk = clk_;
+        rec.row = cmd.Row();
+        rec.column = cmd.Column();
+        rec.cmd_type = static_cast<uint8_t>(cmd.cmd_type);
+        rec.channel = static_cast<uint8_t>(channel_id_);
+        rec.rank = static_cast<uint8_t>(cmd.Rank());
+        rec.bankgroup = static_cast<uint8_t>(cmd.Bankgroup());
+        rec.bank = static_cast<uint8_t>(cmd.Bank());
+        cmd_trace_.write(reinterpret_cast<const char *>(&rec), sizeof(rec));
+    } else {
+        cmd_trace_ << std::left << std::setw(18) << clk_ << " " << cmd
+                   << "\n";
+    }
 #endif  // CMD_TRACE
 #ifdef THERMAL
     // add channel in, only needed by thermal module
@@ -242,13 +455,35 @@ void Controller::IssueCommand(const Command &cmd) {
             exit(1);
         }
         // if there are multiple reads pending return them all
+        bool host_read = false;
+        bool rmw_read = false;
         while (num_reads > 0) {
             auto it = pending_rd_q_.find(cmd.hex_addr);
+            if (it->second.is_internal) {
+                internal_reads_pending_--;
+                rmw_read |= it->second.is_partial;
+            } else {
+                host_read = true;
+            }
+            if (it->second.sample_slot >= 0) {
+                RecordLatencyBreakdown(cmd, it->second);
+                free_samples_.push_back(it->second.sample_slot);
+            }
             it->second.complete_cycle = clk_ + config_.read_delay;
             return_queue_.push_back(it->second);
             pending_rd_q_.erase(it);
             num_reads -= 1;
         }
+        if (!host_read) {
+            simple_stats_.Increment(rmw_read ? "num_rmw_reads"
+                                             : "num_scrub_reads");
+            // host reads that could have used this data bus slot
+            if (pending_rd_q_.size() >
+                static_cast<size_t>(internal_reads_pending_)) {
+                simple_stats_.IncrementBy("internal_read_cycles",
+                                          config_.burst_cycle);
+            }
+        }
     } else if (cmd.IsWrite()) {
         // there should be only 1 write to the same location at a time
         auto it = pending_wr_q_.find(cmd.hex_addr);
@@ -259,6 +494,30 @@ void Controller::IssueCommand(const Command &cmd) {
         auto wr_lat = clk_ - it->second.added_cycle + config_.write_delay;
         simple_stats_.AddValue("write_latency", wr_lat);
         pending_wr_q_.erase(it);
+    } else if (cmd.IsRowClone()) {
+        auto it = pending_bulk_q_.find(cmd.hex_addr);
+        if (it == pending_bulk_q_.end()) {
+            std::cerr << cmd.hex_addr << " not in bulk queue!" << std::endl;
+            exit(1);
+        }
+        simple_stats_.Increment(it->second.bulk_op == BulkOp::COPY
+                                    ? "num_row_clone_copies"
+                                    : "num_row_clone_inits");
+        it->second.complete_cycle = clk_ + config_.tCLONE;
+        return_queue_.push_back(it->second);
+        pending_bulk_q_.erase(it);
+    }
+    if (config_.latency_sample_interval > 0) {
+        // a PRE or ACT made from the command of a sampled read, ones for
+        // refresh or for other rows of the bank have no slot
+        if (cmd.sample_slot >= 0) {
+            if (cmd.cmd_type == CommandType::ACTIVATE) {
+                samples_[cmd.sample_slot].act_cycle = clk_;
+            } else if (cmd.cmd_type == CommandType::PRECHARGE) {
+                samples_[cmd.sample_slot].pre_cycle = clk_;
+            }
+        }
+        UpdateRefreshClocks(cmd);
     }
     // must update stats before states (for row hits)
     UpdateCommandStats(cmd);
@@ -266,15 +525,91 @@ void Controller::IssueCommand(const Command &cmd) {
 }
 
 Command Controller::TransToCommand(const Transaction &trans) {
-    auto addr = config_.AddressMapping(trans.addr);
+    auto addr = config_.AddressMapping(trans.addr, trans.source_id);
     CommandType cmd_type;
-    if (row_buf_policy_ == RowBufPolicy::OPEN_PAGE) {
+    if (trans.bulk_op != BulkOp::NONE) {
+        // the system only sends clones within one subarray here
+        cmd_type = CommandType::ROW_CLONE;
+    } else if (row_buf_policy_ == RowBufPolicy::OPEN_PAGE) {
         cmd_type = trans.is_write ? CommandType::WRITE : CommandType::READ;
     } else {
         cmd_type = trans.is_write ? CommandType::WRITE_PRECHARGE
                                   : CommandType::READ_PRECHARGE;
     }
-    return Command(cmd_type, addr, trans.addr);
+    Command cmd(cmd_type, addr, trans.addr);
+    cmd.source_id = trans.source_id;
+    cmd.sample_slot = trans.sample_slot;
+    return cmd;
+}
+
+void Controller::UpdateRefreshClocks(const Command &cmd) {
+    int rank_base = cmd.Rank() * config_.banks;
+    int bank_idx =
+        rank_base + cmd.Bankgroup() * config_.banks_per_group + cmd.Bank();
+    switch (cmd.cmd_type) {
+        case CommandType::REFRESH:
+        case CommandType::SREF_ENTER:
+        case CommandType::SREF_EXIT:
+            for (int b = 0; b < config_.banks; b++) {
+                bank_ref_clk_[rank_base + b] = clk_;
+            }
+            break;
+        case CommandType::REFRESH_BANK:
+            bank_ref_clk_[bank_idx] = clk_;
+            break;
+        case CommandType::REFRESH_SAME_BANK:
+            for (int bg = 0; bg < config_.bankgroups; bg++) {
+                bank_ref_clk_[rank_base + bg * config_.banks_per_group +
+                              cmd.Bank()] = clk_;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+int Controller::NewSampleSlot() {
+    // slots are reused once their read is done, there are only as many as
+    // sampled reads in flight
+    int slot;
+    if (free_samples_.empty()) {
+        slot = static_cast<int>(samples_.size());
+        samples_.push_back(ReadSample());
+    } else {
+        slot = free_samples_.back();
+        free_samples_.pop_back();
+    }
+    samples_[slot] = {0, 0, 0};
+    return slot;
+}
+
+void Controller::RecordLatencyBreakdown(const Command &cmd,
+                                        const Transaction &trans) {
+    // stages run back to back: transaction queue, command queue until the
+    // first command for it, PRE to ACT if it was a conflict, ACT to CAS if
+    // the row was not open yet, then the fixed read_delay to data return
+    int bank_idx = cmd.Rank() * config_.banks +
+                   cmd.Bankgroup() * config_.banks_per_group + cmd.Bank();
+    const ReadSample &sample = samples_[trans.sample_slot];
+    uint64_t scheduled = sample.scheduled_cycle;
+    uint64_t first_cmd = clk_;  // of the CAS
+    if (sample.act_cycle > 0) {
+        first_cmd = sample.act_cycle;
+        simple_stats_.AddValue("lat_act_to_cas", clk_ - sample.act_cycle);
+        if (sample.pre_cycle > 0 && sample.pre_cycle < sample.act_cycle) {
+            simple_stats_.Increment("sampled_bank_conflicts");
+            simple_stats_.AddValue("lat_pre_to_act",
+                                   sample.act_cycle - sample.pre_cycle);
+            first_cmd = sample.pre_cycle;
+        }
+    }
+    if (bank_ref_clk_[bank_idx] >= scheduled) {
+        simple_stats_.Increment("sampled_refresh_waits");
+    }
+    simple_stats_.Increment("num_sampled_reads");
+    simple_stats_.AddValue("lat_trans_queue", scheduled - trans.added_cycle);
+    simple_stats_.AddValue("lat_cmd_queue", first_cmd - scheduled);
+    return;
 }
 
 int Controller::QueueUsage() const { return cmd_queue_.QueueUsage(); }
@@ -304,34 +639,77 @@ void Controller::PrintFinalStats() {
 }
 
 void Controller::UpdateCommandStats(const Command &cmd) {
+    // flat bank index in this channel, for per-bank stats
+    int bank_idx = cmd.Rank() * config_.banks +
+                   cmd.Bankgroup() * config_.banks_per_group + cmd.Bank();
+    if (config_.ca_bus_model) {
+        simple_stats_.IncrementBy("ca_bus_cycles",
+                                  config_.CommandCycles(cmd.cmd_type));
+    }
     switch (cmd.cmd_type) {
         case CommandType::READ:
         case CommandType::READ_PRECHARGE:
             simple_stats_.Increment("num_read_cmds");
+            simple_stats_.IncrementVec("bank_read_cmds", bank_idx);
             if (channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(),
-                                           cmd.Bank()) != 0) {
+                                           cmd.Bank(),
+                                           config_.SubarrayOf(cmd.Row())) !=
+                0) {
                 simple_stats_.Increment("num_read_row_hits");
             }
             break;
         case CommandType::WRITE:
         case CommandType::WRITE_PRECHARGE:
             simple_stats_.Increment("num_write_cmds");
+            simple_stats_.IncrementVec("bank_write_cmds", bank_idx);
             if (channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(),
-                                           cmd.Bank()) != 0) {
+                                           cmd.Bank(),
+                                           config_.SubarrayOf(cmd.Row())) !=
+                0) {
                 simple_stats_.Increment("num_write_row_hits");
             }
             break;
         case CommandType::ACTIVATE:
             simple_stats_.Increment("num_act_cmds");
+            simple_stats_.IncrementVec("bank_act_cmds", bank_idx);
+            simple_stats_.IncrementVec("source_act_cmds", cmd.source_id);
+            if (row_buf_policy_ == RowBufPolicy::OPEN_PAGE &&
+                channel_state_.IsInterferenceMiss(cmd)) {
+                simple_stats_.IncrementVec("interference_misses",
+                                           cmd.source_id);
+            }
+            if (config_.salp != SALPMode::NONE &&
+                channel_state_.IsSubarrayOverlap(cmd, clk_)) {
+                simple_stats_.Increment("num_subarray_overlap_acts");
+            }
             break;
         case CommandType::PRECHARGE:
             simple_stats_.Increment("num_pre_cmds");
             break;
+        case CommandType::ROW_CLONE:
+            // both activations of the clone, for the per-bank energy
+            simple_stats_.IncrementVec("bank_act_cmds", bank_idx);
+            simple_stats_.IncrementVec("bank_act_cmds", bank_idx);
+            break;
         case CommandType::REFRESH:
             simple_stats_.Increment("num_ref_cmds");
+            for (int b = 0; b < config_.banks; b++) {
+                simple_stats_.IncrementVec("bank_ref_cmds",
+                                           cmd.Rank() * config_.banks + b);
+            }
             break;
         case CommandType::REFRESH_BANK:
             simple_stats_.Increment("num_refb_cmds");
+            simple_stats_.IncrementVec("bank_ref_cmds", bank_idx);
+            break;
+        case CommandType::REFRESH_SAME_BANK:
+            simple_stats_.Increment("num_refsb_cmds");
+            for (int bg = 0; bg < config_.bankgroups; bg++) {
+                simple_stats_.IncrementVec(
+                    "bank_ref_cmds", cmd.Rank() * config_.banks +
+                                         bg * config_.banks_per_group +
+                                         cmd.Bank());
+            }
             break;
         case CommandType::SREF_ENTER:
             simple_stats_.Increment("num_srefe_cmds");
@@ -339,6 +717,12 @@ void Controller::UpdateCommandStats(const Command &cmd) {
         case CommandType::SREF_EXIT:
             simple_stats_.Increment("num_srefx_cmds");
             break;
+        case CommandType::PD_ENTER:
+            simple_stats_.Increment("num_pde_cmds");
+            break;
+        case CommandType::PD_EXIT:
+            simple_stats_.Increment("num_pdx_cmds");
+            break;
         default:
             AbruptExit(__FILE__, __LINE__);
     }
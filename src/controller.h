@@ -8,6 +8,7 @@
 #include "channel_state.h"
 #include "command_queue.h"
 #include "common.h"
+#include "power_governor.h"
 #include "refresh.h"
 #include "simple_stats.h"
 
@@ -28,6 +29,10 @@ class Controller {
     Controller(int channel, const Config &config, const Timing &timing);
 #endif  // THERMAL
     void ClockTick();
+    // earliest cycle at which ClockTick() does more than count idle cycles
+    uint64_t NextEventCycle() const;
+    // same as that many ClockTick() calls, only up to NextEventCycle()
+    void SkipCycles(uint64_t cycles);
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(Transaction trans);
     int QueueUsage() const;
@@ -35,6 +40,9 @@ class Controller {
     void PrintEpochStats();
     void PrintFinalStats();
     void ResetStats() { simple_stats_.Reset(); }
+    const SimpleStats& GetStats() const { return simple_stats_; }
+    // (addr, 0) for a read, (addr, 1) for a write, 2 and 3 for reads and
+    // writes of bulk fallback lines, (-1, -1) when nothing is done
     std::pair<uint64_t, int> ReturnDoneTrans(uint64_t clock);
 
     int channel_id_;
@@ -46,6 +54,7 @@ class Controller {
     ChannelState channel_state_;
     CommandQueue cmd_queue_;
     Refresh refresh_;
+    PowerGovernor power_governor_;
 
 #ifdef THERMAL
     ThermalCalculator &thermal_calc_;
@@ -60,6 +69,8 @@ class Controller {
     // transactions that are not completed, use map for convenience
     std::multimap<uint64_t, Transaction> pending_rd_q_;
     std::multimap<uint64_t, Transaction> pending_wr_q_;
+    // row copies/inits waiting for their ROW_CLONE, keyed by destination
+    std::multimap<uint64_t, Transaction> pending_bulk_q_;
 
     // completed transactions
     std::vector<Transaction> return_queue_;
@@ -74,12 +85,55 @@ class Controller {
     // used to calculate inter-arrival latency
     uint64_t last_trans_clk_;
 
+    // ECC patrol scrub and read-modify-write of partial writes
+    uint64_t scrub_line_;   // next line to scrub in this channel
+    uint64_t scrub_lines_;  // number of lines in this channel
+    int scrub_owed_;        // scrub reads that are due but not queued yet
+    int internal_reads_pending_;
+    // RMW reads waiting for room in the read queue
+    std::vector<Transaction> rmw_read_q_;
+    // partial writes waiting for their RMW read, they hold write buffer slots
+    std::multimap<uint64_t, Transaction> rmw_wait_q_;
+
+    // sampled latency decomposition, the sampled reads and the commands
+    // issued for them point at their stamps here, refreshes are only known
+    // per bank
+    struct ReadSample {
+        uint64_t scheduled_cycle;  // moved into the command queue
+        // PRE and ACT issued for it, 0 if there was none
+        uint64_t pre_cycle;
+        uint64_t act_cycle;
+    };
+    uint64_t reads_to_sample_;
+    std::vector<ReadSample> samples_;
+    std::vector<int> free_samples_;
+    std::vector<uint64_t> bank_ref_clk_;
+
     // transaction queueing
     int write_draining_;
+    // transactions queued per rank, and the ranks with requests waiting in
+    // either queue, for the power governor
+    std::vector<int> rank_pending_;
+    std::vector<bool> rank_busy_;
+    void EnqueueTransaction(const Transaction &trans);
+    void UpdateRankBusy();
     void ScheduleTransaction();
+    void ScheduleInternalReads();
+    void AddInternalRead(Transaction trans);
+    bool ReadQueueHasRoom() const;
+    // row clones do not wait for the write buffer to fill up, they are
+    // drained with it as soon as no reads are waiting
+    bool BulkOpsWaiting() const {
+        return !pending_bulk_q_.empty() && read_queue_.empty();
+    }
+    Transaction NextScrubTransaction();
+    void ReleaseRMWWrites(uint64_t hex_addr);
     void IssueCommand(const Command &tmp_cmd);
     Command TransToCommand(const Transaction &trans);
     void UpdateCommandStats(const Command &cmd);
+    void UpdateRefreshClocks(const Command &cmd);
+    void RecordLatencyBreakdown(const Command &cmd, const Transaction &trans);
+    int NewSampleSlot();
 };
 }  // namespace dramsim3
 #endif
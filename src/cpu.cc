@@ -1,7 +1,41 @@
 #include "cpu.h"
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "fmt/format.h"
+#include "json.hpp"
+
 namespace dramsim3 {
 
+void CPU::Run(uint64_t cycle, bool to_completion, uint64_t progress) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t next_report =
+        progress == 0 ? std::numeric_limits<uint64_t>::max() : progress;
+    while (clk_ < cycle && !(to_completion && Drained())) {
+        uint64_t next = std::min(cycle, next_report);
+        if (to_completion) {
+            // stop at every event, so that the run ends right with the
+            // last completion
+            next = std::min(next, std::max(clk_ + 1, NextEventCycle()));
+        }
+        AdvanceTo(next);
+        if (clk_ >= next_report) {
+            std::chrono::duration<double> wall =
+                std::chrono::steady_clock::now() - start;
+            double sim_us = clk_ * memory_system_.GetTCK() / 1000.0;
+            std::cout << fmt::format(
+                             "Cycle {}, {:.1f} us simulated, {:.1f}% of the "
+                             "trace issued, {:.1f} us simulated per second",
+                             clk_, sim_us, Consumed() * 100,
+                             sim_us / wall.count())
+                      << std::endl;
+            next_report += progress;
+        }
+    }
+}
+
 void RandomCPU::ClockTick() {
     // Create random CPU requests at full speed
     // this is useful to exploit the parallelism of a DRAM protocol
@@ -63,11 +97,56 @@ TraceBasedCPU::TraceBasedCPU(const std::string& config_file,
                              const std::string& output_dir,
                              const std::string& trace_file)
     : CPU(config_file, output_dir) {
-    trace_file_.open(trace_file);
+    trace_file_.open(trace_file, std::ifstream::ate);
     if (trace_file_.fail()) {
         std::cerr << "Trace file does not exist" << std::endl;
         AbruptExit(__FILE__, __LINE__);
     }
+    trace_size_ = trace_file_.tellg();
+    trace_file_.seekg(0);
+    // every accepted request completes with exactly one callback
+    auto callback =
+        std::bind(&TraceBasedCPU::Complete, this, std::placeholders::_1);
+    memory_system_.RegisterCallbacks(callback, callback);
+}
+
+double TraceBasedCPU::Consumed() {
+    if (!trace_file_.good()) {
+        return 1.0;
+    }
+    return trace_size_ == 0 ? 1.0
+                            : static_cast<double>(trace_file_.tellg()) /
+                                  trace_size_;
+}
+
+uint64_t TraceBasedCPU::NextEventCycle() const {
+    uint64_t next = memory_system_.NextEventCycle();
+    if (trace_file_.eof()) {
+        return next;
+    } else if (!get_next_ && trans_.added_cycle > clk_) {
+        return std::min(trans_.added_cycle, next);
+    }
+    return clk_;
+}
+
+void TraceBasedCPU::AdvanceTo(uint64_t cycle) {
+    while (clk_ < cycle) {
+        // until the request in hand is due only the memory system ticks,
+        // callbacks still come from regular ticks
+        uint64_t next = clk_;
+        if (trace_file_.eof()) {
+            next = cycle;
+        } else if (!get_next_ && trans_.added_cycle > clk_) {
+            next = std::min(trans_.added_cycle, cycle);
+        }
+        next = std::min(next, memory_system_.NextEventCycle());
+        if (next > clk_) {
+            memory_system_.AdvanceTo(next);
+            clk_ = next;
+        } else {
+            ClockTick();
+        }
+    }
 }
 
 void TraceBasedCPU::ClockTick() {
@@ -77,16 +156,164 @@ void TraceBasedCPU::ClockTick() {
             get_next_ = false;
             trace_file_ >> trans_;
         }
-        if (trans_.added_cycle <= clk_) {
+        if (trans_.added_cycle <= clk_ && trans_.bulk_op != BulkOp::NONE) {
+            get_next_ =
+                trans_.bulk_op == BulkOp::COPY
+                    ? memory_system_.AddBulkCopy(trans_.src_addr, trans_.addr)
+                    : memory_system_.AddBulkInit(trans_.addr);
+        } else if (trans_.added_cycle <= clk_) {
             get_next_ = memory_system_.WillAcceptTransaction(trans_.addr,
                                                              trans_.is_write);
             if (get_next_) {
-                memory_system_.AddTransaction(trans_.addr, trans_.is_write);
+                if (trans_.is_partial) {
+                    memory_system_.AddPartialWrite(trans_.addr);
+                } else {
+                    memory_system_.AddTransaction(trans_.addr,
+                                                  trans_.is_write);
+                }
             }
         }
+        if (get_next_) {
+            num_pending_++;
+        }
     }
     clk_++;
     return;
 }
 
+MixedTraceCPU::MixedTraceCPU(const std::string& config_file,
+                             const std::string& output_dir,
+                             const std::string& mix_file)
+    : CPU(config_file, output_dir),
+      config_(config_file, output_dir),
+      mixer_(mix_file),
+      num_reads_(mixer_.NumTraces(), 0),
+      num_writes_(mixer_.NumTraces(), 0),
+      read_cycles_(mixer_.NumTraces(), 0),
+      stall_cycles_(mixer_.NumTraces(), 0) {
+    // traces are their own sources only when sources are partitioned
+    if (config_.num_sources > 1 && config_.num_sources < mixer_.NumTraces()) {
+        std::cerr << mixer_.NumTraces() << " traces mixed but only "
+                  << config_.num_sources << " sources configured"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    memory_system_.RegisterCallbacks(
+        std::bind(&MixedTraceCPU::Complete, this, std::placeholders::_1,
+                  false),
+        std::bind(&MixedTraceCPU::Complete, this, std::placeholders::_1,
+                  true));
+}
+
+void MixedTraceCPU::ClockTick() {
+    memory_system_.ClockTick();
+    while (mixer_.HasDue(clk_)) {
+        if (Issue(mixer_.TopTransaction(), mixer_.Top())) {
+            mixer_.Pop();
+        } else {
+            stall_cycles_[mixer_.Top()]++;
+            mixer_.Hold();
+        }
+    }
+    mixer_.Release();
+    clk_++;
+    return;
+}
+
+void MixedTraceCPU::AdvanceTo(uint64_t cycle) {
+    while (clk_ < cycle) {
+        uint64_t next = std::min(mixer_.NextCycle(), cycle);
+        // completions are timed with clk_, so they must not be skipped over
+        next = std::min(next, memory_system_.NextEventCycle());
+        if (next > clk_) {
+            memory_system_.AdvanceTo(next);
+            clk_ = next;
+        } else {
+            ClockTick();
+        }
+    }
+}
+
+bool MixedTraceCPU::Issue(const Transaction& trans, int trace) {
+    int source_id = config_.num_sources > 1 ? trace : 0;
+    if (trans.bulk_op == BulkOp::COPY) {
+        if (!memory_system_.AddBulkCopy(trans.src_addr, trans.addr)) {
+            return false;
+        }
+    } else if (trans.bulk_op == BulkOp::INIT) {
+        if (!memory_system_.AddBulkInit(trans.addr)) {
+            return false;
+        }
+    } else if (!memory_system_.WillAcceptTransaction(trans.addr,
+                                                     trans.is_write)) {
+        return false;
+    } else if (trans.is_partial) {
+        memory_system_.AddPartialWrite(trans.addr, source_id);
+    } else {
+        memory_system_.AddTransaction(trans.addr, trans.is_write, source_id);
+    }
+    // bulk operations complete with a write callback
+    bool is_write = trans.is_write || trans.bulk_op != BulkOp::NONE;
+    auto& pending = is_write ? pending_writes_ : pending_reads_;
+    pending.insert(std::make_pair(trans.addr, std::make_pair(trace, clk_)));
+    return true;
+}
+
+void MixedTraceCPU::Complete(uint64_t addr, bool is_write) {
+    // same address requests complete in order, multimap keeps them in
+    // insertion order
+    auto& pending = is_write ? pending_writes_ : pending_reads_;
+    auto it = pending.find(addr);
+    if (it == pending.end()) {
+        return;
+    }
+    int trace = it->second.first;
+    if (is_write) {
+        num_writes_[trace]++;
+    } else {
+        num_reads_[trace]++;
+        read_cycles_[trace] += clk_ - it->second.second;
+    }
+    pending.erase(it);
+    return;
+}
+
+void MixedTraceCPU::PrintStats() {
+    memory_system_.PrintStats();
+
+    std::ofstream txt_out(config_.txt_stats_name, std::ofstream::app);
+    txt_out << "###########################################\n"
+            << "## Statistics of mixed traces\n"
+            << "###########################################\n";
+    nlohmann::json j_data;
+    double total_time = clk_ * config_.tCK;
+    for (int i = 0; i < mixer_.NumTraces(); i++) {
+        double latency = num_reads_[i] == 0
+                             ? 0.0
+                             : static_cast<double>(read_cycles_[i]) /
+                                   num_reads_[i];
+        double bandwidth =
+            total_time == 0.0 ? 0.0
+                              : (num_reads_[i] + num_writes_[i]) *
+                                    config_.request_size_bytes / total_time;
+        std::vector<std::pair<std::string, double> > stats = {
+            {"num_reads_done", num_reads_[i]},
+            {"num_writes_done", num_writes_[i]},
+            {"average_read_latency", latency},
+            {"average_bandwidth", bandwidth},
+            {"stall_cycles", stall_cycles_[i]}};
+        txt_out << "# " << mixer_.TraceName(i) << std::endl;
+        // the same trace can be mixed in more than once
+        j_data[std::to_string(i)]["trace_file"] = mixer_.TraceName(i);
+        for (const auto& it : stats) {
+            std::string name = it.first + "." + std::to_string(i);
+            txt_out << fmt::format("{:<30}{:^3}{:>12}", name, " = ", it.second)
+                    << std::endl;
+            j_data[std::to_string(i)][it.first] = it.second;
+        }
+    }
+    std::ofstream json_out(config_.output_prefix + "mix.json");
+    json_out << j_data;
+}
+
 }  // namespace dramsim3
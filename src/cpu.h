@@ -1,11 +1,15 @@
 #ifndef __CPU_H
 #define __CPU_H
 
+#include <algorithm>
 #include <fstream>
 #include <functional>
+#include <map>
 #include <random>
 #include <string>
+#include <vector>
 #include "memory_system.h"
+#include "trace_mixer.h"
 
 namespace dramsim3 {
 
@@ -17,10 +21,30 @@ class CPU {
               std::bind(&CPU::ReadCallBack, this, std::placeholders::_1),
               std::bind(&CPU::WriteCallBack, this, std::placeholders::_1)),
           clk_(0) {}
+    virtual ~CPU() {}
     virtual void ClockTick() = 0;
+    // run until cycle, CPUs that know when their next request is due let
+    // the memory system skip the idle cycles in between
+    virtual void AdvanceTo(uint64_t cycle) {
+        while (clk_ < cycle) {
+            ClockTick();
+        }
+    }
+    // AdvanceTo(cycle), or only until the trace is drained, that is every
+    // request of it issued and completed, with to_completion. Progress is
+    // reported every progress cycles, never with 0
+    void Run(uint64_t cycle, bool to_completion, uint64_t progress);
+    // only trace driven CPUs ever run out of requests
+    virtual bool Drained() const { return false; }
+    // fraction of the trace issued so far
+    virtual double Consumed() { return 0.0; }
+    // first cycle the CPU or the memory system has something to do
+    virtual uint64_t NextEventCycle() const {
+        return memory_system_.NextEventCycle();
+    }
     void ReadCallBack(uint64_t addr) { return; }
     void WriteCallBack(uint64_t addr) { return; }
-    void PrintStats() { memory_system_.PrintStats(); }
+    virtual void PrintStats() { memory_system_.PrintStats(); }
 
    protected:
     MemorySystem memory_system_;
@@ -60,11 +84,57 @@ class TraceBasedCPU : public CPU {
                   const std::string& trace_file);
     ~TraceBasedCPU() { trace_file_.close(); }
     void ClockTick() override;
+    void AdvanceTo(uint64_t cycle) override;
+    bool Drained() const override {
+        return trace_file_.eof() && num_pending_ == 0;
+    }
+    double Consumed() override;
+    uint64_t NextEventCycle() const override;
 
    private:
     std::ifstream trace_file_;
+    uint64_t trace_size_;
     Transaction trans_;
     bool get_next_ = true;
+    uint64_t num_pending_ = 0;  // issued but not completed yet
+
+    void Complete(uint64_t addr) { num_pending_--; }
+};
+
+// Replays several per-core traces at once, merged on the fly by TraceMixer,
+// and reports latency and bandwidth for each of them. A trace that cannot
+// issue only holds up itself.
+class MixedTraceCPU : public CPU {
+   public:
+    MixedTraceCPU(const std::string& config_file, const std::string& output_dir,
+                  const std::string& mix_file);
+    void ClockTick() override;
+    void AdvanceTo(uint64_t cycle) override;
+    bool Drained() const override {
+        return mixer_.Done() && pending_reads_.empty() &&
+               pending_writes_.empty();
+    }
+    double Consumed() override { return mixer_.Consumed(); }
+    uint64_t NextEventCycle() const override {
+        return std::min(mixer_.NextCycle(), memory_system_.NextEventCycle());
+    }
+    void PrintStats() override;
+
+   private:
+    Config config_;
+    TraceMixer mixer_;
+    // (trace, issue cycle) of requests in flight, by address
+    std::multimap<uint64_t, std::pair<int, uint64_t> > pending_reads_;
+    std::multimap<uint64_t, std::pair<int, uint64_t> > pending_writes_;
+
+    // per trace
+    std::vector<uint64_t> num_reads_;
+    std::vector<uint64_t> num_writes_;
+    std::vector<uint64_t> read_cycles_;
+    std::vector<uint64_t> stall_cycles_;  // due but not accepted
+
+    bool Issue(const Transaction& trans, int trace);
+    void Complete(uint64_t addr, bool is_write);
 };
 
 }  // namespace dramsim3
@@ -0,0 +1,230 @@
+#include "cxl.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "fmt/format.h"
+#include "json.hpp"
+
+namespace dramsim3 {
+
+CXLLink::CXLLink(int slots_per_flit, int flit_bytes, double bytes_per_cycle,
+                 int port_latency)
+    : slots_per_flit_(slots_per_flit),
+      flit_bytes_(flit_bytes),
+      bytes_per_cycle_(bytes_per_cycle),
+      port_latency_(port_latency),
+      byte_budget_(0.0),
+      front_slots_sent_(0),
+      num_flits_(0),
+      num_slots_used_(0) {}
+
+void CXLLink::ClockTick(uint64_t clk) {
+    byte_budget_ += bytes_per_cycle_;
+    if (tx_queue_.empty()) {
+        // an idle link cannot save up bandwidth for later
+        byte_budget_ = std::min(byte_budget_, static_cast<double>(flit_bytes_));
+        return;
+    }
+    while (byte_budget_ >= flit_bytes_ && !tx_queue_.empty()) {
+        byte_budget_ -= flit_bytes_;
+        num_flits_++;
+        int free_slots = slots_per_flit_;
+        while (free_slots > 0 && !tx_queue_.empty()) {
+            auto& msg = tx_queue_.front();
+            int sent = std::min(free_slots, msg.slots - front_slots_sent_);
+            free_slots -= sent;
+            front_slots_sent_ += sent;
+            num_slots_used_ += sent;
+            if (front_slots_sent_ == msg.slots) {
+                msg.arrive_cycle = clk + port_latency_;
+                rx_queue_.push_back(msg);
+                tx_queue_.pop_front();
+                front_slots_sent_ = 0;
+            }
+        }
+    }
+}
+
+CXLMessage CXLLink::PopArrived() {
+    CXLMessage msg = rx_queue_.front();
+    rx_queue_.pop_front();
+    return msg;
+}
+
+CXLMemorySystem::CXLMemorySystem(Config& config, const std::string& output_dir,
+                                 std::function<void(uint64_t)> read_callback,
+                                 std::function<void(uint64_t)> write_callback)
+    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
+      m2s_link_(config_.cxl_flit_bytes / 16, config_.cxl_flit_bytes,
+                config_.cxl_link_bandwidth * config_.tCK,
+                config_.cxl_port_latency),
+      s2m_link_(config_.cxl_flit_bytes / 16, config_.cxl_flit_bytes,
+                config_.cxl_link_bandwidth * config_.tCK,
+                config_.cxl_port_latency),
+      credits_(config_.cxl_credits),
+      data_slots_(std::max(1, config_.request_size_bytes / 16)),
+      num_reads_(0),
+      num_writes_(0),
+      e2e_read_cycles_(0),
+      device_read_cycles_(0),
+      credit_stall_cycles_(0) {
+    if (config_.cxl_flit_bytes < 16 || config_.cxl_credits <= 0) {
+        std::cerr << "CXL link needs flits of at least 16B and some credits"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    auto read_cb = std::bind(&CXLMemorySystem::DeviceCallback, this,
+                             std::placeholders::_1, false);
+    auto write_cb = std::bind(&CXLMemorySystem::DeviceCallback, this,
+                              std::placeholders::_1, true);
+    device_ = new JedecDRAMSystem(config_, output_dir, read_cb, write_cb);
+}
+
+CXLMemorySystem::~CXLMemorySystem() { delete device_; }
+
+bool CXLMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
+                                            bool is_write) const {
+    return credits_ > 0;
+}
+
+bool CXLMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     int source_id) {
+    return SendRequest(hex_addr, is_write, false, source_id);
+}
+
+bool CXLMemorySystem::AddPartialWrite(uint64_t hex_addr, int source_id) {
+    // still a full line of RwD on the link, with some byte enables cleared
+    return SendRequest(hex_addr, true, true, source_id);
+}
+
+bool CXLMemorySystem::SendRequest(uint64_t hex_addr, bool is_write,
+                                  bool is_partial, int source_id) {
+    if (credits_ == 0) {
+        return false;
+    }
+    credits_--;
+    // M2S Req is a header slot, M2S RwD carries the line as well
+    CXLMessage msg = {hex_addr, is_write, is_write ? 1 + data_slots_ : 1,
+                      clk_,     0,        0,        is_partial, source_id};
+    m2s_link_.Push(msg);
+    last_req_clk_ = clk_;
+    return true;
+}
+
+void CXLMemorySystem::ClockTick() {
+    m2s_link_.ClockTick(clk_);
+    while (m2s_link_.HasArrived(clk_)) {
+        device_ingress_.push_back(m2s_link_.PopArrived());
+    }
+    // the device buffer is drained in order, the credit goes back to the
+    // host with the next S2M flit, which is not modeled separately
+    while (!device_ingress_.empty()) {
+        auto& msg = device_ingress_.front();
+        if (!device_->WillAcceptTransaction(msg.addr, msg.is_write)) {
+            break;
+        }
+        msg.device_cycle = clk_;
+        device_pending_.insert(
+            std::make_pair(std::make_pair(msg.addr, msg.is_write), msg));
+        if (msg.is_partial) {
+            device_->AddPartialWrite(msg.addr, msg.source_id);
+        } else {
+            device_->AddTransaction(msg.addr, msg.is_write, msg.source_id);
+        }
+        device_ingress_.pop_front();
+        credits_++;
+    }
+    device_->ClockTick();
+
+    s2m_link_.ClockTick(clk_);
+    while (s2m_link_.HasArrived(clk_)) {
+        CXLMessage msg = s2m_link_.PopArrived();
+        if (msg.is_write) {
+            num_writes_++;
+            write_callback_(msg.addr);
+        } else {
+            num_reads_++;
+            e2e_read_cycles_ += clk_ - msg.added_cycle;
+            read_callback_(msg.addr);
+        }
+    }
+    if (credits_ == 0) {
+        credit_stall_cycles_++;
+    }
+    clk_++;
+    return;
+}
+
+void CXLMemorySystem::DeviceCallback(uint64_t addr, bool is_write) {
+    auto it = device_pending_.find(std::make_pair(addr, is_write));
+    if (it == device_pending_.end()) {
+        std::cerr << addr << " not pending in CXL device" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    CXLMessage msg = it->second;
+    device_pending_.erase(it);
+    if (!msg.is_write) {
+        device_read_cycles_ += clk_ - msg.device_cycle;
+    }
+    // S2M DRS returns the line, S2M NDR only completes the write
+    msg.slots = msg.is_write ? 1 : 1 + data_slots_;
+    s2m_link_.Push(msg);
+    return;
+}
+
+void CXLMemorySystem::PrintStats() {
+    device_->PrintStats();
+
+    double e2e_latency =
+        num_reads_ == 0 ? 0.0 : static_cast<double>(e2e_read_cycles_) /
+                                    num_reads_;
+    double device_latency =
+        num_reads_ == 0 ? 0.0 : static_cast<double>(device_read_cycles_) /
+                                    num_reads_;
+    auto slot_util = [](const CXLLink& link) {
+        return link.NumFlits() == 0
+                   ? 0.0
+                   : static_cast<double>(link.NumSlotsUsed()) /
+                         (link.NumFlits() * link.SlotsPerFlit());
+    };
+    std::vector<std::pair<std::string, double> > stats = {
+        {"cxl_reads", num_reads_},
+        {"cxl_writes", num_writes_},
+        {"m2s_flits", m2s_link_.NumFlits()},
+        {"s2m_flits", s2m_link_.NumFlits()},
+        {"m2s_slot_utilization", slot_util(m2s_link_)},
+        {"s2m_slot_utilization", slot_util(s2m_link_)},
+        {"credit_stall_cycles", credit_stall_cycles_},
+        {"e2e_read_latency", e2e_latency},
+        {"device_read_latency", device_latency},
+        {"cxl_read_overhead", e2e_latency - device_latency},
+        {"e2e_read_latency_ns", e2e_latency * config_.tCK}};
+
+    // the device stats are per channel, these are for the whole expander
+    std::ofstream txt_out(config_.txt_stats_name, std::ofstream::app);
+    txt_out << "###########################################\n"
+            << "## Statistics of CXL link\n"
+            << "###########################################\n";
+    nlohmann::json j_data;
+    for (const auto& it : stats) {
+        txt_out << fmt::format("{:<30}{:^3}{:>12}", it.first, " = ", it.second)
+                << std::endl;
+        j_data[it.first] = it.second;
+    }
+    std::ofstream json_out(config_.output_prefix + "cxl.json");
+    json_out << j_data;
+}
+
+void CXLMemorySystem::ResetStats() {
+    device_->ResetStats();
+    m2s_link_.ResetStats();
+    s2m_link_.ResetStats();
+    num_reads_ = 0;
+    num_writes_ = 0;
+    e2e_read_cycles_ = 0;
+    device_read_cycles_ = 0;
+    credit_stall_cycles_ = 0;
+}
+
+}  // namespace dramsim3
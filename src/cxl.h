@@ -0,0 +1,98 @@
+#ifndef __CXL_H
+#define __CXL_H
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <utility>
+
+#include "dram_system.h"
+
+namespace dramsim3 {
+
+// A CXL.mem message, M2S Req/RwD from the host or S2M DRS/NDR back
+struct CXLMessage {
+    uint64_t addr;
+    bool is_write;
+    int slots;             // 16B slots it occupies in flits
+    uint64_t added_cycle;  // accepted from the host
+    uint64_t device_cycle;  // handed to the device DRAM
+    uint64_t arrive_cycle;  // reaches the other end of the link
+    bool is_partial;        // write with only some byte enables set
+    int source_id;
+};
+
+// One direction of a CXL link. Messages are packed into fixed size flits
+// of slots_per_flit slots, a message may span flits and a flit is sent
+// partially filled rather than waiting for more messages. The link sends
+// as many flits as its bandwidth allows, each arrives port_latency later.
+class CXLLink {
+   public:
+    CXLLink(int slots_per_flit, int flit_bytes, double bytes_per_cycle,
+            int port_latency);
+    void Push(const CXLMessage& msg) { tx_queue_.push_back(msg); }
+    void ClockTick(uint64_t clk);
+    bool HasArrived(uint64_t clk) const {
+        return !rx_queue_.empty() && rx_queue_.front().arrive_cycle <= clk;
+    }
+    CXLMessage PopArrived();
+    uint64_t NumFlits() const { return num_flits_; }
+    uint64_t NumSlotsUsed() const { return num_slots_used_; }
+    int SlotsPerFlit() const { return slots_per_flit_; }
+    void ResetStats() { num_flits_ = num_slots_used_ = 0; }
+
+   private:
+    int slots_per_flit_;
+    int flit_bytes_;
+    double bytes_per_cycle_;
+    int port_latency_;
+    double byte_budget_;
+    // slots of the front message already sent in earlier flits
+    int front_slots_sent_;
+    std::deque<CXLMessage> tx_queue_;
+    std::deque<CXLMessage> rx_queue_;
+
+    uint64_t num_flits_;
+    uint64_t num_slots_used_;
+};
+
+// A CXL Type-3 memory expander: requests cross a CXL link to a device that
+// contains a regular JEDEC memory system built from the same config
+class CXLMemorySystem : public BaseDRAMSystem {
+   public:
+    CXLMemorySystem(Config& config, const std::string& output_dir,
+                    std::function<void(uint64_t)> read_callback,
+                    std::function<void(uint64_t)> write_callback);
+    ~CXLMemorySystem();
+    bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        int source_id = 0) override;
+    bool AddPartialWrite(uint64_t hex_addr, int source_id = 0) override;
+    void ClockTick() override;
+    void PrintStats() override;
+    void ResetStats() override;
+
+   private:
+    JedecDRAMSystem* device_;
+    CXLLink m2s_link_;
+    CXLLink s2m_link_;
+    int credits_;
+    int data_slots_;  // slots for one line of data
+
+    // requests arrived at the device but not accepted by its controllers
+    std::deque<CXLMessage> device_ingress_;
+    // requests inside the device DRAM, looked up by (address, is write) on
+    // completion, a write of a line can finish before an earlier read of it
+    std::multimap<std::pair<uint64_t, bool>, CXLMessage> device_pending_;
+
+    uint64_t num_reads_, num_writes_;
+    uint64_t e2e_read_cycles_, device_read_cycles_;
+    uint64_t credit_stall_cycles_;  // cycles the host had no credits left
+
+    bool SendRequest(uint64_t hex_addr, bool is_write, bool is_partial,
+                     int source_id);
+    void DeviceCallback(uint64_t addr, bool is_write);
+};
+
+}  // namespace dramsim3
+#endif
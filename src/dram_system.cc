@@ -1,6 +1,7 @@
 #include "dram_system.h"
 
 #include <assert.h>
+#include <algorithm>
 
 namespace dramsim3 {
 
@@ -19,7 +20,8 @@ BaseDRAMSystem::BaseDRAMSystem(Config &config, const std::string &output_dir,
 #ifdef THERMAL
       thermal_calc_(config_),
 #endif  // THERMAL
-      clk_(0) {
+      clk_(0),
+      system_stats_(config_) {
     total_channels_ += config_.channels;
 
 #ifdef ADDR_TRACE
@@ -44,6 +46,9 @@ void BaseDRAMSystem::PrintEpochStats() {
         std::ofstream epoch_out(config_.json_epoch_name, std::ofstream::app);
         epoch_out << "," << std::endl;
     }
+    if (config_.system_stats && !ctrls_.empty()) {
+        system_stats_.PrintEpochStats(GetChannelStats());
+    }
 #ifdef THERMAL
     thermal_calc_.PrintTransPT(clk_);
 #endif  // THERMAL
@@ -73,6 +78,9 @@ void BaseDRAMSystem::PrintStats() {
     }
     json_out.open(config_.json_stats_name, std::ofstream::app);
     json_out << "}";
+    if (config_.system_stats && !ctrls_.empty()) {
+        system_stats_.PrintFinalStats(GetChannelStats());
+    }
 
 #ifdef THERMAL
     thermal_calc_.PrintFinalPT(clk_);
@@ -83,6 +91,35 @@ void BaseDRAMSystem::ResetStats() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->ResetStats();
     }
+    system_stats_.Reset();
+}
+
+std::vector<const SimpleStats*> BaseDRAMSystem::GetChannelStats() const {
+    std::vector<const SimpleStats*> channel_stats;
+    for (auto ctrl : ctrls_) {
+        channel_stats.push_back(&ctrl->GetStats());
+    }
+    return channel_stats;
+}
+
+bool BaseDRAMSystem::AddBulkCopy(uint64_t src_addr, uint64_t dst_addr) {
+    std::cerr << "Bulk row copies are only modeled for JEDEC DRAM systems"
+              << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+    return false;
+}
+
+bool BaseDRAMSystem::AddBulkInit(uint64_t dst_addr) {
+    std::cerr << "Bulk row inits are only modeled for JEDEC DRAM systems"
+              << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+    return false;
+}
+
+void BaseDRAMSystem::AdvanceTo(uint64_t cycle) {
+    while (clk_ < cycle) {
+        ClockTick();
+    }
 }
 
 void BaseDRAMSystem::RegisterCallbacks(
@@ -96,9 +133,11 @@ void BaseDRAMSystem::RegisterCallbacks(
 JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
-    : BaseDRAMSystem(config, output_dir, read_callback, write_callback) {
-    if (config_.IsHMC()) {
-        std::cerr << "Initialized a memory system with an HMC config file!"
+    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
+      lines_per_row_(static_cast<int>(config_.co_mask + 1)) {
+    if (config_.IsHMC() || config_.IsNVM()) {
+        std::cerr << "Initialized a memory system with an "
+                  << (config_.IsHMC() ? "HMC" : "NVM") << " config file!"
                   << std::endl;
         AbruptExit(__FILE__, __LINE__);
     }
@@ -125,11 +164,12 @@ bool JedecDRAMSystem::WillAcceptTransaction(uint64_t hex_addr,
     return ctrls_[channel]->WillAcceptTransaction(hex_addr, is_write);
 }
 
-bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
+bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     int source_id) {
 // Record trace - Record address trace for debugging or other purposes
 #ifdef ADDR_TRACE
     address_trace_ << std::hex << hex_addr << std::dec << " "
-                   << (is_write ? "WRITE " : "READ ") << clk_ << std::endl;
+                   << (is_write ? "WRITE " : "READ ") << clk_ << "\n";
 #endif
 
     int channel = GetChannel(hex_addr);
@@ -138,12 +178,119 @@ bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
     assert(ok);
     if (ok) {
         Transaction trans = Transaction(hex_addr, is_write);
+        trans.source_id = source_id;
+        ctrls_[channel]->AddTransaction(trans);
+    }
+    last_req_clk_ = clk_;
+    return ok;
+}
+
+bool JedecDRAMSystem::AddPartialWrite(uint64_t hex_addr, int source_id) {
+#ifdef ADDR_TRACE
+    address_trace_ << std::hex << hex_addr << std::dec << " PARTIAL_WRITE "
+                   << clk_ << "\n";
+#endif
+
+    int channel = GetChannel(hex_addr);
+    bool ok = ctrls_[channel]->WillAcceptTransaction(hex_addr, true);
+
+    assert(ok);
+    if (ok) {
+        Transaction trans = Transaction(hex_addr, true);
+        trans.is_partial = true;
+        trans.source_id = source_id;
         ctrls_[channel]->AddTransaction(trans);
     }
     last_req_clk_ = clk_;
     return ok;
 }
 
+bool JedecDRAMSystem::AddBulkCopy(uint64_t src_addr, uint64_t dst_addr) {
+    return AddBulk(BulkOp::COPY, src_addr, dst_addr);
+}
+
+bool JedecDRAMSystem::AddBulkInit(uint64_t dst_addr) {
+    return AddBulk(BulkOp::INIT, 0, dst_addr);
+}
+
+bool JedecDRAMSystem::AddBulk(BulkOp op, uint64_t src_addr,
+                              uint64_t dst_addr) {
+    // RowClone only works between rows sharing the local row buffers of one
+    // subarray, every subarray keeps a zero row for initialization
+    Address dst = config_.AddressMapping(dst_addr);
+    bool in_dram = config_.row_clone;
+    if (op == BulkOp::COPY) {
+        Address src = config_.AddressMapping(src_addr);
+        in_dram = in_dram && src.channel == dst.channel &&
+                  src.rank == dst.rank && src.bankgroup == dst.bankgroup &&
+                  src.bank == dst.bank &&
+                  src.row / config_.rows_per_subarray ==
+                      dst.row / config_.rows_per_subarray;
+    }
+    if (in_dram) {
+        if (!ctrls_[dst.channel]->WillAcceptTransaction(dst_addr, true)) {
+            return false;
+        }
+        Transaction trans(dst_addr, true);
+        trans.bulk_op = op;
+        trans.src_addr = src_addr;
+        ctrls_[dst.channel]->AddTransaction(trans);
+    } else {
+        if (bulk_fallback_.size() >=
+            static_cast<size_t>(config_.trans_queue_size)) {
+            return false;
+        }
+        bulk_fallback_.push_back({op, src_addr, dst_addr, 0, 0, 0, 0});
+    }
+    last_req_clk_ = clk_;
+    return true;
+}
+
+uint64_t JedecDRAMSystem::LineAddress(uint64_t row_addr, int line) const {
+    Address addr = config_.AddressMapping(row_addr);
+    addr.column = line;
+    return config_.ReverseAddressMapping(addr);
+}
+
+void JedecDRAMSystem::IssueBulkFallback() {
+    // one row at a time, a line is written as soon as its data is back
+    if (bulk_fallback_.empty()) {
+        return;
+    }
+    auto& bulk = bulk_fallback_.front();
+    if (bulk.op == BulkOp::COPY && bulk.next_read < lines_per_row_) {
+        if (IssueBulkLine(LineAddress(bulk.src_addr, bulk.next_read),
+                          false)) {
+            bulk.next_read++;
+        }
+    }
+    int lines_ready =
+        bulk.op == BulkOp::COPY ? bulk.lines_read : lines_per_row_;
+    if (bulk.next_write < lines_ready) {
+        if (IssueBulkLine(LineAddress(bulk.dst_addr, bulk.next_write),
+                          true)) {
+            bulk.next_write++;
+        }
+    }
+    if (bulk.lines_written == lines_per_row_) {
+        uint64_t dst_addr = bulk.dst_addr;
+        bulk_fallback_.pop_front();
+        write_callback_(dst_addr);
+    }
+}
+
+bool JedecDRAMSystem::IssueBulkLine(uint64_t hex_addr, bool is_write) {
+    int channel = GetChannel(hex_addr);
+    if (!ctrls_[channel]->WillAcceptTransaction(hex_addr, is_write)) {
+        return false;
+    }
+    // tagged, so that a CPU request to the same line is never taken for it
+    Transaction trans(hex_addr, is_write);
+    trans.is_bulk_line = true;
+    ctrls_[channel]->AddTransaction(trans);
+    return true;
+}
+
 void JedecDRAMSystem::ClockTick() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         // look ahead and return earlier
@@ -153,11 +300,16 @@ void JedecDRAMSystem::ClockTick() {
                 write_callback_(pair.first);
             } else if (pair.second == 0) {
                 read_callback_(pair.first);
+            } else if (pair.second == 3) {
+                bulk_fallback_.front().lines_written++;
+            } else if (pair.second == 2) {
+                bulk_fallback_.front().lines_read++;
             } else {
                 break;
             }
         }
     }
+    IssueBulkFallback();
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->ClockTick();
     }
@@ -169,6 +321,34 @@ void JedecDRAMSystem::ClockTick() {
     return;
 }
 
+uint64_t JedecDRAMSystem::NextEventCycle() const {
+    if (!bulk_fallback_.empty()) {
+        return clk_;
+    }
+    // epoch stats are printed at the end of the cycle before the boundary
+    uint64_t epoch = static_cast<uint64_t>(config_.epoch_period);
+    uint64_t next = (clk_ / epoch + 1) * epoch - 1;
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        next = std::min(next, ctrls_[i]->NextEventCycle());
+    }
+    return next;
+}
+
+void JedecDRAMSystem::AdvanceTo(uint64_t cycle) {
+    while (clk_ < cycle) {
+        uint64_t next = std::min(NextEventCycle(), cycle);
+        if (next > clk_) {
+            for (size_t i = 0; i < ctrls_.size(); i++) {
+                ctrls_[i]->SkipCycles(next - clk_);
+            }
+            clk_ = next;
+        } else {
+            ClockTick();
+        }
+    }
+    return;
+}
+
 IdealDRAMSystem::IdealDRAMSystem(Config &config, const std::string &output_dir,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
@@ -177,7 +357,8 @@ IdealDRAMSystem::IdealDRAMSystem(Config &config, const std::string &output_dir,
 
 IdealDRAMSystem::~IdealDRAMSystem() {}
 
-bool IdealDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
+bool IdealDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     int source_id) {
     auto trans = Transaction(hex_addr, is_write);
     trans.added_cycle = clk_;
     infinite_buffer_q_.push_back(trans);
@@ -1,6 +1,7 @@
 #ifndef __DRAM_SYSTEM_H
 #define __DRAM_SYSTEM_H
 
+#include <deque>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 #include "common.h"
 #include "configuration.h"
 #include "controller.h"
+#include "system_stats.h"
 #include "timing.h"
 
 #ifdef THERMAL
@@ -25,13 +27,29 @@ class BaseDRAMSystem {
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
     void PrintEpochStats();
-    void PrintStats();
-    void ResetStats();
+    virtual void PrintStats();
+    virtual void ResetStats();
 
     virtual bool WillAcceptTransaction(uint64_t hex_addr,
                                        bool is_write) const = 0;
-    virtual bool AddTransaction(uint64_t hex_addr, bool is_write) = 0;
+    virtual bool AddTransaction(uint64_t hex_addr, bool is_write,
+                                int source_id = 0) = 0;
+    // a write to part of a line, only systems modeling ECC treat it
+    // differently from a full line write
+    virtual bool AddPartialWrite(uint64_t hex_addr, int source_id = 0) {
+        return AddTransaction(hex_addr, true, source_id);
+    }
+    // copy the DRAM row of src_addr to the row of dst_addr, or zero the row
+    // of dst_addr, completion is a write callback for dst_addr
+    virtual bool AddBulkCopy(uint64_t src_addr, uint64_t dst_addr);
+    virtual bool AddBulkInit(uint64_t dst_addr);
     virtual void ClockTick() = 0;
+    // earliest cycle at which ClockTick() can complete a request, refresh or
+    // change any other state, the current cycle when that is unknown
+    virtual uint64_t NextEventCycle() const { return clk_; }
+    // tick until the clock reaches cycle, idle stretches are skipped over
+    // where the system knows how to
+    virtual void AdvanceTo(uint64_t cycle);
     int GetChannel(uint64_t hex_addr) const;
 
     std::function<void(uint64_t req_id)> read_callback_, write_callback_;
@@ -51,6 +69,9 @@ class BaseDRAMSystem {
 
     uint64_t clk_;
     std::vector<Controller*> ctrls_;
+    SystemStats system_stats_;
+
+    std::vector<const SimpleStats*> GetChannelStats() const;
 
 #ifdef ADDR_TRACE
     std::ofstream address_trace_;
@@ -65,8 +86,34 @@ class JedecDRAMSystem : public BaseDRAMSystem {
                     std::function<void(uint64_t)> write_callback);
     ~JedecDRAMSystem();
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        int source_id = 0) override;
+    bool AddPartialWrite(uint64_t hex_addr, int source_id = 0) override;
+    bool AddBulkCopy(uint64_t src_addr, uint64_t dst_addr) override;
+    bool AddBulkInit(uint64_t dst_addr) override;
     void ClockTick() override;
+    uint64_t NextEventCycle() const override;
+    void AdvanceTo(uint64_t cycle) override;
+
+   private:
+    // a row copy/init done line by line with regular reads and writes
+    struct BulkFallback {
+        BulkOp op;
+        uint64_t src_addr;
+        uint64_t dst_addr;
+        int next_read;    // next source line to read
+        int lines_read;   // source lines back from DRAM
+        int next_write;   // next destination line to write
+        int lines_written;
+    };
+    // only the front one issues, so every bulk line returned is one of its
+    std::deque<BulkFallback> bulk_fallback_;
+    int lines_per_row_;
+
+    bool AddBulk(BulkOp op, uint64_t src_addr, uint64_t dst_addr);
+    uint64_t LineAddress(uint64_t row_addr, int line) const;
+    void IssueBulkFallback();
+    bool IssueBulkLine(uint64_t hex_addr, bool is_write);
 };
 
 // Model a memorysystem with an infinite bandwidth and a fixed latency (possibly
@@ -82,7 +129,8 @@ class IdealDRAMSystem : public BaseDRAMSystem {
                                bool is_write) const override {
         return true;
     };
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        int source_id = 0) override;
     void ClockTick() override;
 
    private:
@@ -14,6 +14,12 @@ class MemorySystem {
                  std::function<void(uint64_t)> write_callback);
     ~MemorySystem();
     void ClockTick();
+    // earliest cycle at which a ClockTick() can complete a request, refresh
+    // or change any other state. Event-driven hosts can jump straight there
+    // with AdvanceTo(), which ticks up to the given cycle and skips idle
+    // stretches in bulk. Stats are the same as with ClockTick() every cycle
+    uint64_t NextEventCycle() const;
+    void AdvanceTo(uint64_t cycle);
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
     double GetTCK() const;
@@ -24,7 +30,15 @@ class MemorySystem {
     void ResetStats();
 
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
-    bool AddTransaction(uint64_t hex_addr, bool is_write);
+    // source_id tells cores/tenants apart, see bank partitioning in config
+    bool AddTransaction(uint64_t hex_addr, bool is_write, int source_id = 0);
+    // write to part of a line, needs a read-modify-write when ECC is modeled
+    bool AddPartialWrite(uint64_t hex_addr, int source_id = 0);
+    // copy a whole DRAM row, or zero one, in DRAM when row_clone is on and
+    // the rows share a subarray, otherwise with reads and writes. Completes
+    // with a single write callback for dst_addr
+    bool AddBulkCopy(uint64_t src_addr, uint64_t dst_addr);
+    bool AddBulkInit(uint64_t dst_addr);
 };
 
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
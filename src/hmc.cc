@@ -1,9 +1,15 @@
 #include "hmc.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "fmt/format.h"
+#include "json.hpp"
+
 namespace dramsim3 {
 
 HMCRequest::HMCRequest(HMCReqType req_type, uint64_t hex_addr, int vault)
-    : type(req_type), mem_operand(hex_addr), vault(vault) {
+    : type(req_type), mem_operand(hex_addr), vault(vault), pass_through(false) {
     is_write = type >= HMCReqType::WR0 && type <= HMCReqType::P_WR256;
     // given that vaults could be 16 (Gen1) or 32(Gen2), using % 4
     // to partition vaults to quads
@@ -111,7 +117,7 @@ HMCRequest::HMCRequest(HMCReqType req_type, uint64_t hex_addr, int vault)
 
 HMCResponse::HMCResponse(uint64_t id, HMCReqType req_type, int dest_link,
                          int src_quad)
-    : resp_id(id), link(dest_link), quad(src_quad) {
+    : resp_id(id), is_write(false), link(dest_link), quad(src_quad) {
     switch (req_type) {
         case HMCReqType::RD0:
             type = HMCRespType::RD_RS;
@@ -240,6 +246,51 @@ HMCResponse::HMCResponse(uint64_t id, HMCReqType req_type, int dest_link,
     return;
 }
 
+HMCHostLink::HMCHostLink(double ber, int retry_buffer_flits, int retry_cycles,
+                         uint64_t seed)
+    : ber_(ber),
+      retry_buffer_flits_(retry_buffer_flits),
+      retry_cycles_(retry_cycles),
+      tx_free_(0),
+      buffered_flits_(0),
+      gen_(seed),
+      dist_(0.0, 1.0),
+      num_flits_(0),
+      num_retries_(0),
+      retry_cycles_lost_(0) {}
+
+bool HMCHostLink::CanSend(uint64_t clk, int flits) const {
+    // packets are acknowledged in the order they were sent
+    int unacked = buffered_flits_;
+    for (const auto &it : retry_buffer_) {
+        if (it.first > clk) {
+            break;
+        }
+        unacked -= it.second;
+    }
+    return unacked + flits <= retry_buffer_flits_;
+}
+
+uint64_t HMCHostLink::Send(uint64_t clk, int flits) {
+    while (!retry_buffer_.empty() && retry_buffer_.front().first <= clk) {
+        buffered_flits_ -= retry_buffer_.front().second;
+        retry_buffer_.pop_front();
+    }
+    uint64_t arrive = std::max(tx_free_, clk) + flits;
+    // each of the 128 bits of a flit can flip, the replay can fail too
+    double packet_ok = std::pow(1.0 - ber_, 128.0 * flits);
+    while (flits > 0 && dist_(gen_) >= packet_ok) {
+        num_retries_++;
+        retry_cycles_lost_ += retry_cycles_ + flits;
+        arrive += retry_cycles_ + flits;
+    }
+    tx_free_ = arrive;
+    retry_buffer_.push_back(std::make_pair(arrive + retry_cycles_, flits));
+    buffered_flits_ += flits;
+    num_flits_ += flits;
+    return arrive;
+}
+
 HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
@@ -294,12 +345,31 @@ HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
         link_busy_.push_back(0);
         link_age_counter_.push_back(0);
     }
+
+    if (config_.link_model) {
+        int retry_cycles = static_cast<int>(
+            config_.retry_latency * 1000 / ps_per_logic_ + 0.5);
+        for (int i = 0; i < links_; i++) {
+            req_links_.push_back(new HMCHostLink(config_.link_ber,
+                                                 config_.retry_buffer_flits,
+                                                 retry_cycles, 2 * i));
+            resp_links_.push_back(new HMCHostLink(config_.link_ber,
+                                                  config_.retry_buffer_flits,
+                                                  retry_cycles, 2 * i + 1));
+            link_tokens_.push_back(config_.link_tokens);
+            token_stalls_.push_back(0);
+        }
+    }
 }
 
 HMCMemorySystem::~HMCMemorySystem() {
     for (auto &&vault_ptr : ctrls_) {
         delete (vault_ptr);
     }
+    for (int i = 0; i < static_cast<int>(req_links_.size()); i++) {
+        delete req_links_[i];
+        delete resp_links_[i];
+    }
 }
 
 void HMCMemorySystem::SetClockRatio() {
@@ -330,9 +400,11 @@ inline void HMCMemorySystem::IterateNextLink() {
 bool HMCMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
                                             bool is_write) const {
     bool insertable = false;
-    for (auto link_queue = link_req_queues_.begin();
-         link_queue != link_req_queues_.end(); link_queue++) {
-        if ((*link_queue).size() < queue_depth_) {
+    // a write packet carries the block after its header flit
+    int flits = is_write ? config_.block_size / 16 + 1 : 1;
+    for (int i = 0; i < links_; i++) {
+        if (link_req_queues_[i].size() < queue_depth_ &&
+            LinkCanSend(i, flits)) {
             insertable = true;
             break;
         }
@@ -340,7 +412,35 @@ bool HMCMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
     return insertable;
 }
 
-bool HMCMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
+bool HMCMemorySystem::LinkCanSend(int link, int flits) const {
+    if (!config_.link_model) {
+        return true;
+    }
+    return (config_.link_tokens == 0 || link_tokens_[link] >= flits) &&
+           req_links_[link]->CanSend(logic_clk_, flits);
+}
+
+bool HMCMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     int source_id) {
+    HMCRequest *req = BlockRequest(hex_addr, is_write);
+    if (!InsertHMCReq(req)) {
+        delete (req);
+        return false;
+    }
+    return true;
+}
+
+bool HMCMemorySystem::AddPassThrough(uint64_t hex_addr, bool is_write) {
+    HMCRequest *req = BlockRequest(hex_addr, is_write);
+    req->pass_through = true;
+    if (!InsertHMCReq(req)) {
+        delete (req);
+        return false;
+    }
+    return true;
+}
+
+HMCRequest *HMCMemorySystem::BlockRequest(uint64_t hex_addr, bool is_write) {
     // to be compatible with other protocol we have this interface
     // when using this intreface the size of each transaction will be block_size
     HMCReqType req_type;
@@ -390,8 +490,7 @@ bool HMCMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
         }
     }
     int vault = GetChannel(hex_addr);
-    HMCRequest *req = new HMCRequest(req_type, hex_addr, vault);
-    return InsertHMCReq(req);
+    return new HMCRequest(req_type, hex_addr, vault);
 }
 
 bool HMCMemorySystem::InsertReqToLink(HMCRequest *req, int link) {
@@ -400,18 +499,30 @@ bool HMCMemorySystem::InsertReqToLink(HMCRequest *req, int link) {
     // 2. set link field in the request packet
     // 3. create corresponding response
     // 4. increment link_age_counter_ so that arbitrate logic works
-    if (link_req_queues_[link].size() < queue_depth_) {
+    // 5. with the link model, take tokens and send it over the link
+    if (link_req_queues_[link].size() < queue_depth_ &&
+        LinkCanSend(link, req->flits)) {
         req->link = link;
         link_req_queues_[link].push_back(req);
         HMCResponse *resp =
             new HMCResponse(req->mem_operand, req->type, link, req->quad);
+        resp->is_write = req->is_write;
         resp_lookup_table_.insert(
             std::pair<uint64_t, HMCResponse *>(resp->resp_id, resp));
         link_age_counter_[link] = 1;
+        if (config_.link_model) {
+            link_tokens_[link] -= req->flits;
+            req->exit_time = req_links_[link]->Send(logic_clk_, req->flits);
+            resp->issue_time = logic_clk_;
+        }
         // stats_.interarrival_latency.AddValue(clk_ - last_req_clk_);
         last_req_clk_ = clk_;
         return true;
     } else {
+        if (config_.link_model && config_.link_tokens != 0 &&
+            link_tokens_[link] < req->flits) {
+            token_stalls_[link]++;
+        }
         return false;
     }
 }
@@ -448,8 +559,15 @@ void HMCMemorySystem::DrainRequests() {
             quad_resp_queues_[i].size() < queue_depth_) {
             HMCRequest *req = quad_req_queues_[i].front();
             if (req->exit_time <= logic_clk_) {
-                if (ctrls_[req->vault]->WillAcceptTransaction(req->mem_operand,
-                                                              req->is_write)) {
+                if (req->pass_through) {
+                    if (egress_.size() < queue_depth_) {
+                        egress_.push_back(
+                            std::make_pair(req->mem_operand, req->is_write));
+                        delete (req);
+                        quad_req_queues_[i].erase(quad_req_queues_[i].begin());
+                    }
+                } else if (ctrls_[req->vault]->WillAcceptTransaction(
+                               req->mem_operand, req->is_write)) {
                     InsertReqToDRAM(req);
                     delete (req);
                     quad_req_queues_[i].erase(quad_req_queues_[i].begin());
@@ -469,12 +587,22 @@ void HMCMemorySystem::DrainRequests() {
     std::vector<int> age_queue = BuildAgeQueue(link_age_counter_);
     while (!age_queue.empty()) {
         int src_link = age_queue.front();
+        if (config_.link_model &&
+            link_req_queues_[src_link].front()->exit_time > logic_clk_) {
+            // still on the link, or being replayed
+            age_queue.erase(age_queue.begin());
+            continue;
+        }
         int dest_quad = link_req_queues_[src_link].front()->quad;
         if (quad_req_queues_[dest_quad].size() < queue_depth_ &&
             quad_busy_[dest_quad] <= 0) {
             HMCRequest *req = link_req_queues_[src_link].front();
             link_req_queues_[src_link].erase(
                 link_req_queues_[src_link].begin());
+            if (config_.link_model) {
+                // the input buffer space goes back to the host as tokens
+                link_tokens_[src_link] += req->flits;
+            }
             quad_req_queues_[dest_quad].push_back(req);
             quad_busy_[dest_quad] = req->flits;
             req->exit_time = logic_clk_ + req->flits;
@@ -502,6 +630,9 @@ void HMCMemorySystem::DrainResponses() {
                 } else {
                     write_callback_(resp->resp_id);
                 }
+                if (config_.link_model) {
+                    round_trips_[logic_clk_ - resp->issue_time]++;
+                }
                 delete (resp);
                 link_resp_queues_[i].erase(link_resp_queues_[i].begin());
             }
@@ -519,15 +650,22 @@ void HMCMemorySystem::DrainResponses() {
     auto age_queue = BuildAgeQueue(quad_age_counter_);
     while (!age_queue.empty()) {
         int src_quad = age_queue.front();
-        int dest_link = quad_resp_queues_[src_quad].front()->link;
+        HMCResponse *resp = quad_resp_queues_[src_quad].front();
+        int dest_link = resp->link;
         if (link_resp_queues_[dest_link].size() < queue_depth_ &&
-            link_busy_[dest_link] <= 0) {
-            HMCResponse *resp = quad_resp_queues_[src_quad].front();
+            link_busy_[dest_link] <= 0 &&
+            (!config_.link_model ||
+             resp_links_[dest_link]->CanSend(logic_clk_, resp->flits))) {
             quad_resp_queues_[src_quad].erase(
                 quad_resp_queues_[src_quad].begin());
             link_resp_queues_[dest_link].push_back(resp);
             link_busy_[dest_link] = resp->flits;
-            resp->exit_time = logic_clk_ + resp->flits;
+            if (config_.link_model) {
+                resp->exit_time =
+                    resp_links_[dest_link]->Send(logic_clk_, resp->flits);
+            } else {
+                resp->exit_time = logic_clk_ + resp->flits;
+            }
             if (quad_resp_queues_[src_quad].size() == 0) {
                 quad_age_counter_[src_quad] = 0;
             } else {
@@ -547,9 +685,9 @@ void HMCMemorySystem::DRAMClockTick() {
         while (true) {
             auto pair = ctrls_[i]->ReturnDoneTrans(clk_);
             if (pair.second == 1) {  // write
-                VaultCallback(pair.first);
+                VaultCallback(pair.first, true);
             } else if (pair.second == 0) {  // read
-                VaultCallback(pair.first);
+                VaultCallback(pair.first, false);
             } else {
                 break;
             }
@@ -618,13 +756,21 @@ void HMCMemorySystem::InsertReqToDRAM(HMCRequest *req) {
     return;
 }
 
-void HMCMemorySystem::VaultCallback(uint64_t req_id) {
+void HMCMemorySystem::VaultCallback(uint64_t req_id, bool is_write) {
     // we will use hex addr as the req_id and use a multimap to lookup the
     // requests the vaults cannot directly talk to the CPU so this callback will
     // be passed to the vaults and is responsible to put the responses back to
-    // response queues
-
-    auto it = resp_lookup_table_.find(req_id);
+    // response queues. A read and a write of one address can both be out, so
+    // the kind of request has to match as well.
+    auto range = resp_lookup_table_.equal_range(req_id);
+    auto it = range.first;
+    while (it != range.second && it->second->is_write != is_write) {
+        it++;
+    }
+    if (it == range.second) {
+        std::cerr << req_id << " not pending in this cube" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
     HMCResponse *resp = it->second;
     // all data from dram received, put packet in xbar and return
     resp_lookup_table_.erase(it);
@@ -634,4 +780,415 @@ void HMCMemorySystem::VaultCallback(uint64_t req_id) {
     return;
 }
 
+void HMCMemorySystem::PassThroughDone(uint64_t hex_addr, bool is_write) {
+    // back from the other cube, the same as back from a vault from here on
+    VaultCallback(hex_addr, is_write);
+}
+
+void HMCMemorySystem::PrintStats() {
+    BaseDRAMSystem::PrintStats();
+    if (config_.link_model) {
+        PrintLinkStats();
+    }
+}
+
+void HMCMemorySystem::PrintLinkStats() const {
+    std::vector<std::pair<std::string, double> > stats;
+    uint64_t flits = 0, retry_cycles = 0;
+    for (int i = 0; i < links_; i++) {
+        std::string link = "link" + std::to_string(i) + "_";
+        stats.push_back({link + "req_flits", req_links_[i]->NumFlits()});
+        stats.push_back({link + "resp_flits", resp_links_[i]->NumFlits()});
+        stats.push_back({link + "req_retries", req_links_[i]->NumRetries()});
+        stats.push_back({link + "resp_retries", resp_links_[i]->NumRetries()});
+        stats.push_back({link + "token_stalls", token_stalls_[i]});
+        flits += req_links_[i]->NumFlits() + resp_links_[i]->NumFlits();
+        retry_cycles +=
+            req_links_[i]->RetryCycles() + resp_links_[i]->RetryCycles();
+    }
+
+    // flits are 16B, one a logic cycle in each direction of a link
+    double ns_per_logic = ps_per_logic_ / 1000.0;
+    double time = logic_clk_ * ns_per_logic;
+    uint64_t num_trips = 0, sum_trips = 0;
+    for (const auto &it : round_trips_) {
+        num_trips += it.second;
+        sum_trips += it.first * it.second;
+    }
+    double avg_trip = num_trips == 0 ? 0.0
+                                     : static_cast<double>(sum_trips) /
+                                           num_trips * ns_per_logic;
+    stats.push_back({"link_retry_cycles", retry_cycles});
+    stats.push_back({"link_efficiency",
+                     flits == 0 ? 1.0
+                                : static_cast<double>(flits) /
+                                      (flits + retry_cycles)});
+    stats.push_back(
+        {"effective_link_bandwidth", time == 0.0 ? 0.0 : flits * 16 / time});
+    stats.push_back({"average_round_trip_ns", avg_trip});
+    stats.push_back({"round_trip_p50_ns",
+                     HistoPercentile(round_trips_, num_trips, 0.5) *
+                         ns_per_logic});
+    stats.push_back({"round_trip_p99_ns",
+                     HistoPercentile(round_trips_, num_trips, 0.99) *
+                         ns_per_logic});
+    stats.push_back({"round_trip_p999_ns",
+                     HistoPercentile(round_trips_, num_trips, 0.999) *
+                         ns_per_logic});
+
+    // the vault stats are per channel, these are for the links of the cube
+    std::ofstream txt_out(config_.txt_stats_name, std::ofstream::app);
+    txt_out << "###########################################\n"
+            << "## Statistics of HMC links\n"
+            << "###########################################\n";
+    nlohmann::json j_data;
+    for (const auto &it : stats) {
+        txt_out << fmt::format("{:<30}{:^3}{:>12}", it.first, " = ", it.second)
+                << std::endl;
+        j_data[it.first] = it.second;
+    }
+    std::ofstream json_out(config_.output_prefix + "links.json");
+    json_out << j_data;
+}
+
+void HMCMemorySystem::ResetStats() {
+    BaseDRAMSystem::ResetStats();
+    for (int i = 0; i < static_cast<int>(req_links_.size()); i++) {
+        req_links_[i]->ResetStats();
+        resp_links_[i]->ResetStats();
+        token_stalls_[i] = 0;
+    }
+    round_trips_.clear();
+}
+
+HMCDevLink::HMCDevLink(double flits_per_cycle, int hop_latency, size_t depth)
+    : flits_per_cycle_(flits_per_cycle),
+      hop_latency_(hop_latency),
+      depth_(depth),
+      flit_budget_(0.0),
+      front_flits_sent_(0),
+      num_flits_(0),
+      busy_cycles_(0) {}
+
+void HMCDevLink::ClockTick(uint64_t clk) {
+    if (tx_queue_.empty()) {
+        flit_budget_ = 0.0;
+        return;
+    }
+    busy_cycles_++;
+    flit_budget_ += flits_per_cycle_;
+    while (flit_budget_ >= 1.0 && !tx_queue_.empty()) {
+        auto& pkt = tx_queue_.front();
+        int sent = std::min(static_cast<int>(flit_budget_),
+                            pkt.flits - front_flits_sent_);
+        flit_budget_ -= sent;
+        front_flits_sent_ += sent;
+        num_flits_ += sent;
+        if (front_flits_sent_ == pkt.flits) {
+            pkt.arrive_cycle = clk + hop_latency_;
+            rx_queue_.push_back(pkt);
+            tx_queue_.pop_front();
+            front_flits_sent_ = 0;
+        }
+    }
+}
+
+HMCNetwork::HMCNetwork(Config &config, const std::string &output_dir,
+                       std::function<void(uint64_t)> read_callback,
+                       std::function<void(uint64_t)> write_callback)
+    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
+      num_cubes_(config_.num_cubes),
+      is_star_(config_.cube_topology == "STAR"),
+      cube_bytes_(static_cast<uint64_t>(config_.channel_size) *
+                  config_.channels << 20),
+      req_flits_(1),
+      data_flits_(config_.block_size / 16),
+      ingress_(num_cubes_),
+      completed_(num_cubes_),
+      cube_reads_(num_cubes_, 0),
+      cube_read_cycles_(num_cubes_, 0),
+      cube_writes_(num_cubes_, 0),
+      pass_through_(num_cubes_, 0),
+      num_threads_(std::min(config_.cube_threads, num_cubes_)),
+      tick_gen_(0),
+      workers_busy_(0),
+      stop_workers_(false) {
+    // 128b flits over link_width lanes, each at link_speed Mbps
+    double flits_per_cycle =
+        config_.link_width * config_.link_speed * config_.tCK * 1e-3 / 128;
+    size_t depth = static_cast<size_t>(config_.xbar_queue_depth);
+    // the logic layer on the far side of a hop adds its latency too
+    int hop_latency = config_.hop_latency + config_.logic_latency;
+    for (int i = 0; i < num_cubes_; i++) {
+        // every cube gets its own copy of the config to write its own stats
+        Config *cube_config = new Config(config_);
+        cube_config->output_prefix += "cube" + std::to_string(i);
+        cube_config->json_stats_name = cube_config->output_prefix + ".json";
+        cube_config->json_epoch_name =
+            cube_config->output_prefix + "epoch.json";
+        cube_config->txt_stats_name = cube_config->output_prefix + ".txt";
+        cube_configs_.push_back(cube_config);
+        auto read_cb = std::bind(&HMCNetwork::CubeCallback, this, i,
+                                 std::placeholders::_1, false);
+        auto write_cb = std::bind(&HMCNetwork::CubeCallback, this, i,
+                                  std::placeholders::_1, true);
+        cubes_.push_back(
+            new HMCMemorySystem(*cube_config, output_dir, read_cb, write_cb));
+        if (i == 0) {
+            down_links_.push_back(nullptr);
+            up_links_.push_back(nullptr);
+        } else {
+            down_links_.push_back(
+                new HMCDevLink(flits_per_cycle, hop_latency, depth));
+            up_links_.push_back(
+                new HMCDevLink(flits_per_cycle, hop_latency, depth));
+        }
+    }
+    for (int i = 1; i < num_threads_; i++) {
+        workers_.push_back(std::thread(&HMCNetwork::WorkerLoop, this, i));
+    }
+}
+
+HMCNetwork::~HMCNetwork() {
+    {
+        std::lock_guard<std::mutex> lock(tick_mutex_);
+        stop_workers_ = true;
+    }
+    tick_cv_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+    for (int i = 0; i < num_cubes_; i++) {
+        delete cubes_[i];
+        delete cube_configs_[i];
+        delete down_links_[i];
+        delete up_links_[i];
+    }
+}
+
+int HMCNetwork::GetCube(uint64_t hex_addr) const {
+    return static_cast<int>((hex_addr / cube_bytes_) % num_cubes_);
+}
+
+bool HMCNetwork::WillAcceptTransaction(uint64_t hex_addr,
+                                       bool is_write) const {
+    // everything enters through the host links of the host cube
+    return cubes_[0]->WillAcceptTransaction(hex_addr, is_write);
+}
+
+bool HMCNetwork::AddTransaction(uint64_t hex_addr, bool is_write,
+                                int source_id) {
+    int cube = GetCube(hex_addr);
+    if (cube == 0) {
+        if (!cubes_[0]->AddTransaction(hex_addr, is_write)) {
+            return false;
+        }
+    } else {
+        // crosses the host links and the xbar of the host cube first
+        if (!cubes_[0]->AddPassThrough(hex_addr, is_write)) {
+            return false;
+        }
+    }
+    pending_.insert(std::make_pair(std::make_pair(hex_addr, is_write), clk_));
+    last_req_clk_ = clk_;
+    return true;
+}
+
+void HMCNetwork::ClockTick() {
+    TickCubes();
+
+    // requests for other cubes that made it through the host cube's xbar
+    while (cubes_[0]->HasEgress()) {
+        const auto &req = cubes_[0]->EgressFront();
+        int cube = GetCube(req.first);
+        auto link = down_links_[NextHop(0, cube)];
+        if (link->IsFull()) {
+            break;
+        }
+        int flits = req.second ? req_flits_ + data_flits_ : req_flits_;
+        link->Push({req.first, req.second, cube, flits, 0});
+        pass_through_[0]++;
+        cubes_[0]->PopEgress();
+    }
+
+    for (int c = 0; c < num_cubes_; c++) {
+        for (const auto &pkt : completed_[c]) {
+            if (c == 0) {
+                HostCompletion(pkt);
+            } else {
+                up_links_[c]->Push(pkt);
+            }
+        }
+        completed_[c].clear();
+    }
+
+    for (int c = 1; c < num_cubes_; c++) {
+        down_links_[c]->ClockTick(clk_);
+        while (down_links_[c]->HasArrived(clk_)) {
+            const auto &pkt = down_links_[c]->Front();
+            if (pkt.dest_cube == c) {
+                ingress_[c].push_back(pkt);
+            } else {
+                // stalls the whole link until the next hop has room
+                auto next_link = down_links_[NextHop(c, pkt.dest_cube)];
+                if (next_link->IsFull()) {
+                    break;
+                }
+                next_link->Push(pkt);
+                pass_through_[c]++;
+            }
+            down_links_[c]->Pop();
+        }
+        up_links_[c]->ClockTick(clk_);
+        while (up_links_[c]->HasArrived(clk_)) {
+            const auto &pkt = up_links_[c]->Front();
+            int parent = Parent(c);
+            if (parent == 0) {
+                // back to the host over the host cube's xbar and host links
+                cubes_[0]->PassThroughDone(pkt.addr, pkt.is_write);
+                pass_through_[0]++;
+            } else {
+                up_links_[parent]->Push(pkt);
+                pass_through_[parent]++;
+            }
+            up_links_[c]->Pop();
+        }
+    }
+
+    for (int c = 1; c < num_cubes_; c++) {
+        while (!ingress_[c].empty()) {
+            const auto &pkt = ingress_[c].front();
+            if (!cubes_[c]->WillAcceptTransaction(pkt.addr, pkt.is_write)) {
+                break;
+            }
+            cubes_[c]->AddTransaction(pkt.addr, pkt.is_write);
+            ingress_[c].pop_front();
+        }
+    }
+    clk_++;
+    return;
+}
+
+void HMCNetwork::CubeCallback(int cube, uint64_t addr, bool is_write) {
+    // called from whichever thread ticks this cube, only touch its own slot
+    int flits = is_write ? req_flits_ : req_flits_ + data_flits_;
+    completed_[cube].push_back({addr, is_write, 0, flits, 0});
+}
+
+void HMCNetwork::HostCompletion(const HMCHopPacket &pkt) {
+    int cube = GetCube(pkt.addr);
+    auto it = pending_.find(std::make_pair(pkt.addr, pkt.is_write));
+    if (it == pending_.end()) {
+        std::cerr << pkt.addr << " not pending in HMC network" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    if (pkt.is_write) {
+        cube_writes_[cube]++;
+        pending_.erase(it);
+        write_callback_(pkt.addr);
+    } else {
+        cube_reads_[cube]++;
+        cube_read_cycles_[cube] += clk_ - it->second;
+        pending_.erase(it);
+        read_callback_(pkt.addr);
+    }
+}
+
+void HMCNetwork::TickCubes() {
+    if (workers_.empty()) {
+        TickCubeSlice(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(tick_mutex_);
+        tick_gen_++;
+        workers_busy_ = static_cast<int>(workers_.size());
+    }
+    tick_cv_.notify_all();
+    TickCubeSlice(0);
+    std::unique_lock<std::mutex> lock(tick_mutex_);
+    done_cv_.wait(lock, [this] { return workers_busy_ == 0; });
+}
+
+void HMCNetwork::TickCubeSlice(int thread_id) {
+    for (int c = thread_id; c < num_cubes_; c += num_threads_) {
+        cubes_[c]->ClockTick();
+    }
+}
+
+void HMCNetwork::WorkerLoop(int thread_id) {
+    uint64_t seen_gen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(tick_mutex_);
+            tick_cv_.wait(lock, [this, seen_gen] {
+                return stop_workers_ || tick_gen_ != seen_gen;
+            });
+            if (stop_workers_) {
+                return;
+            }
+            seen_gen = tick_gen_;
+        }
+        TickCubeSlice(thread_id);
+        std::lock_guard<std::mutex> lock(tick_mutex_);
+        if (--workers_busy_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+void HMCNetwork::PrintStats() {
+    for (auto cube : cubes_) {
+        cube->PrintStats();
+    }
+
+    std::vector<std::pair<std::string, double> > stats;
+    nlohmann::json j_data;
+    for (int c = 0; c < num_cubes_; c++) {
+        std::string cube = "cube" + std::to_string(c) + "_";
+        double latency = cube_reads_[c] == 0
+                             ? 0.0
+                             : static_cast<double>(cube_read_cycles_[c]) /
+                                   cube_reads_[c];
+        stats.push_back({cube + "reads", cube_reads_[c]});
+        stats.push_back({cube + "writes", cube_writes_[c]});
+        stats.push_back({cube + "read_latency", latency});
+        stats.push_back({cube + "pass_through", pass_through_[c]});
+        if (c > 0) {
+            stats.push_back({cube + "down_flits", down_links_[c]->NumFlits()});
+            stats.push_back({cube + "up_flits", up_links_[c]->NumFlits()});
+            double busy = clk_ == 0 ? 0.0
+                                    : static_cast<double>(
+                                          down_links_[c]->BusyCycles()) /
+                                          clk_;
+            stats.push_back({cube + "down_link_busy", busy});
+        }
+    }
+
+    std::ofstream txt_out(config_.txt_stats_name);
+    txt_out << "###########################################\n"
+            << "## Statistics of HMC network (" << config_.cube_topology
+            << ")\n"
+            << "###########################################\n";
+    for (const auto &it : stats) {
+        txt_out << fmt::format("{:<30}{:^3}{:>12}", it.first, " = ", it.second)
+                << std::endl;
+        j_data[it.first] = it.second;
+    }
+    std::ofstream json_out(config_.json_stats_name);
+    json_out << j_data;
+}
+
+void HMCNetwork::ResetStats() {
+    for (int c = 0; c < num_cubes_; c++) {
+        cubes_[c]->ResetStats();
+        cube_reads_[c] = cube_writes_[c] = cube_read_cycles_[c] = 0;
+        pass_through_[c] = 0;
+        if (c > 0) {
+            down_links_[c]->ResetStats();
+            up_links_[c]->ResetStats();
+        }
+    }
+}
+
 }  // namespace dramsim3
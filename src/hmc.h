@@ -1,8 +1,14 @@
 #ifndef __HMC_H
 #define __HMC_H
 
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "dram_system.h"
@@ -73,7 +79,7 @@ enum class HMCReqType {
 
 enum class HMCRespType { NONE, RD_RS, WR_RS, ERR, SIZE };
 
-// for future use
+// host links live inside HMCMemorySystem, device links in HMCNetwork
 enum class HMCLinkType { HOST_TO_DEV, DEV_TO_DEV, SIZE };
 
 class HMCRequest {
@@ -86,6 +92,9 @@ class HMCRequest {
     int vault;
     int flits;
     bool is_write;
+    // for a cube further down the network, leaves the xbar towards the
+    // device-to-device links instead of going to a vault
+    bool pass_through;
     // this exit_time is the time to exit xbar to vaults
     uint64_t exit_time;
 };
@@ -95,11 +104,48 @@ class HMCResponse {
     HMCResponse(uint64_t id, HMCReqType reqtype, int dest_link, int src_quad);
     uint64_t resp_id;
     HMCRespType type;
+    bool is_write;  // of the request, what the vault calls back with
     int link;
     int quad;
     int flits;
     // this exit_time is the time to exit xbar to cpu
     uint64_t exit_time;
+    // logic cycle the request went on its link
+    uint64_t issue_time;
+};
+
+// One direction of a host link when the link model is on. Packets are
+// serialized at one flit per logic cycle and stay in the sender's retry
+// buffer until they are acknowledged, a retry round trip after they are
+// received. A packet failing its CRC is replayed, together with everything
+// sent after it, once that round trip is over, the link is stalled
+// meanwhile.
+class HMCHostLink {
+   public:
+    HMCHostLink(double ber, int retry_buffer_flits, int retry_cycles,
+                uint64_t seed);
+    bool CanSend(uint64_t clk, int flits) const;
+    // returns the logic cycle the packet is received correctly
+    uint64_t Send(uint64_t clk, int flits);
+    uint64_t NumFlits() const { return num_flits_; }
+    uint64_t NumRetries() const { return num_retries_; }
+    uint64_t RetryCycles() const { return retry_cycles_lost_; }
+    void ResetStats() { num_flits_ = num_retries_ = retry_cycles_lost_ = 0; }
+
+   private:
+    double ber_;
+    int retry_buffer_flits_;
+    int retry_cycles_;
+    uint64_t tx_free_;  // when the last flit sent so far is through
+    // acknowledge cycle and flits of the packets in the retry buffer
+    std::deque<std::pair<uint64_t, int> > retry_buffer_;
+    int buffered_flits_;
+    std::mt19937_64 gen_;
+    std::uniform_real_distribution<double> dist_;
+
+    uint64_t num_flits_;
+    uint64_t num_retries_;
+    uint64_t retry_cycles_lost_;  // of replays and stalled retries
 };
 
 class HMCMemorySystem : public BaseDRAMSystem {
@@ -115,9 +161,25 @@ class HMCMemorySystem : public BaseDRAMSystem {
 
     // had to have 3 insert interfaces cuz HMC is so different...
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+    // source ids are not used for vault mapping
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        int source_id = 0) override;
     bool InsertReqToLink(HMCRequest* req, int link);
     bool InsertHMCReq(HMCRequest* req);
+    void PrintStats() override;
+    void ResetStats() override;
+
+    // a request for another cube of a network, it takes a host link and the
+    // xbar like any other and then waits in the egress queue for the
+    // device-to-device links. Its response comes back with PassThroughDone()
+    // and returns over the host link with the regular callbacks.
+    bool AddPassThrough(uint64_t hex_addr, bool is_write);
+    bool HasEgress() const { return !egress_.empty(); }
+    const std::pair<uint64_t, bool>& EgressFront() const {
+        return egress_.front();
+    }
+    void PopEgress() { egress_.pop_front(); }
+    void PassThroughDone(uint64_t hex_addr, bool is_write);
 
    private:
     uint64_t logic_clk_, ps_per_dram_, ps_per_logic_, logic_ps_, dram_ps_;
@@ -126,8 +188,9 @@ class HMCMemorySystem : public BaseDRAMSystem {
     void DRAMClockTick();
     void DrainRequests();
     void DrainResponses();
+    HMCRequest* BlockRequest(uint64_t hex_addr, bool is_write);
     void InsertReqToDRAM(HMCRequest* req);
-    void VaultCallback(uint64_t req_id);
+    void VaultCallback(uint64_t req_id, bool is_write);
     std::vector<int> BuildAgeQueue(std::vector<int>& age_counter);
     void XbarArbitrate();
     inline void IterateNextLink();
@@ -147,6 +210,8 @@ class HMCMemorySystem : public BaseDRAMSystem {
     std::vector<std::vector<HMCResponse*>> link_resp_queues_;
     std::vector<std::vector<HMCRequest*>> quad_req_queues_;
     std::vector<std::vector<HMCResponse*>> quad_resp_queues_;
+    // pass-through requests out of the xbar, (address, is write)
+    std::deque<std::pair<uint64_t, bool>> egress_;
 
     // input/output busy indicators, since each packet could be several
     // flits, as long as this != 0 then they're busy
@@ -155,6 +220,117 @@ class HMCMemorySystem : public BaseDRAMSystem {
     // used for arbitration
     std::vector<int> link_age_counter_;
     std::vector<int> quad_age_counter_ = {0, 0, 0, 0};
+
+    // only with the link model on, request and response direction of each
+    // link, the free flits of the link input buffers, and the histogram of
+    // the logic cycles from sending a request to its response
+    std::vector<HMCHostLink*> req_links_;
+    std::vector<HMCHostLink*> resp_links_;
+    std::vector<int> link_tokens_;
+    std::vector<uint64_t> token_stalls_;
+    std::map<int, uint64_t> round_trips_;
+
+    bool LinkCanSend(int link, int flits) const;
+    void PrintLinkStats() const;
+};
+
+// a packet crossing device-to-device links, requests travel away from the
+// host cube and responses back towards it
+struct HMCHopPacket {
+    uint64_t addr;
+    bool is_write;
+    int dest_cube;
+    int flits;
+    uint64_t arrive_cycle;  // reaches the far end of the current link
+};
+
+// One direction of a device-to-device link. Packets are serialized at
+// flits_per_cycle and arrive hop_latency cycles after their last flit.
+// Only the send queue is bounded, packets on the wire always land.
+class HMCDevLink {
+   public:
+    HMCDevLink(double flits_per_cycle, int hop_latency, size_t depth);
+    bool IsFull() const { return tx_queue_.size() >= depth_; }
+    void Push(const HMCHopPacket& pkt) { tx_queue_.push_back(pkt); }
+    void ClockTick(uint64_t clk);
+    bool HasArrived(uint64_t clk) const {
+        return !rx_queue_.empty() && rx_queue_.front().arrive_cycle <= clk;
+    }
+    const HMCHopPacket& Front() const { return rx_queue_.front(); }
+    void Pop() { rx_queue_.pop_front(); }
+    uint64_t NumFlits() const { return num_flits_; }
+    uint64_t BusyCycles() const { return busy_cycles_; }
+    void ResetStats() { num_flits_ = busy_cycles_ = 0; }
+
+   private:
+    double flits_per_cycle_;
+    int hop_latency_;
+    size_t depth_;
+    double flit_budget_;
+    int front_flits_sent_;
+    std::deque<HMCHopPacket> tx_queue_;
+    std::deque<HMCHopPacket> rx_queue_;
+
+    uint64_t num_flits_;
+    uint64_t busy_cycles_;  // cycles with something left to send
+};
+
+// Several cubes behind the host cube (cube 0), either daisy chained or in a
+// star around cube 0. Address ranges of one cube capacity are interleaved
+// across the cubes, packets for other cubes pass through the logic layers
+// on the way without touching their vaults.
+class HMCNetwork : public BaseDRAMSystem {
+   public:
+    HMCNetwork(Config& config, const std::string& output_dir,
+               std::function<void(uint64_t)> read_callback,
+               std::function<void(uint64_t)> write_callback);
+    ~HMCNetwork();
+    bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        int source_id = 0) override;
+    void ClockTick() override;
+    void PrintStats() override;
+    void ResetStats() override;
+    int GetCube(uint64_t hex_addr) const;
+
+   private:
+    int num_cubes_;
+    bool is_star_;
+    uint64_t cube_bytes_;
+    int req_flits_, data_flits_;
+    std::vector<Config*> cube_configs_;
+    std::vector<HMCMemorySystem*> cubes_;
+    // index c is the link between cube c and its parent, index 0 is unused
+    std::vector<HMCDevLink*> down_links_;
+    std::vector<HMCDevLink*> up_links_;
+    // requests that arrived at their cube but were not accepted yet
+    std::vector<std::deque<HMCHopPacket> > ingress_;
+    // completions of each cube, filled from the cube callbacks
+    std::vector<std::vector<HMCHopPacket> > completed_;
+    // (addr, is write) -> added cycle, a read and a write of the same line
+    // can be out at once and finish in either order
+    std::multimap<std::pair<uint64_t, bool>, uint64_t> pending_;
+
+    std::vector<uint64_t> cube_reads_, cube_read_cycles_, cube_writes_;
+    std::vector<uint64_t> pass_through_;  // packets forwarded by each cube
+
+    // persistent workers ticking cubes in parallel, one barrier per cycle
+    int num_threads_;
+    std::vector<std::thread> workers_;
+    std::mutex tick_mutex_;
+    std::condition_variable tick_cv_, done_cv_;
+    uint64_t tick_gen_;
+    int workers_busy_;
+    bool stop_workers_;
+
+    int Parent(int cube) const { return is_star_ ? 0 : cube - 1; }
+    // the neighbor of cube on the way away from the host towards dest
+    int NextHop(int cube, int dest) const { return is_star_ ? dest : cube + 1; }
+    void CubeCallback(int cube, uint64_t addr, bool is_write);
+    void HostCompletion(const HMCHopPacket& pkt);
+    void TickCubes();
+    void TickCubeSlice(int thread_id);
+    void WorkerLoop(int thread_id);
 };
 
 }  // namespace dramsim3
@@ -1,6 +1,9 @@
 #include <iostream>
+#include <limits>
+#include <thread>
 #include "./../ext/headers/args.hxx"
 #include "cpu.h"
+#include "trace_cluster.h"
 
 using namespace dramsim3;
 
@@ -10,7 +13,12 @@ int main(int argc, const char **argv) {
         "Examples: \n."
         "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -c 100 -t "
         "sample_trace.txt\n"
-        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -s random -c 100");
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -s random -c 100\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -t "
+        "sample_trace.txt -k 10 -i 100000 -w 10000\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -m mix.txt\n"
+        "./build/dramsim3main configs/DDR4_8Gb_x8_3200.ini -t "
+        "sample_trace.txt -r -p 1000000");
     args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
     args::ValueFlag<uint64_t> num_cycles_arg(parser, "num_cycles",
                                              "Number of cycles to simulate",
@@ -25,6 +33,33 @@ int main(int argc, const char **argv) {
         parser, "trace",
         "Trace file, setting this option will ignore -s option",
         {'t', "trace"});
+    args::ValueFlag<std::string> mix_file_arg(
+        parser, "mix",
+        "Mix file listing per-core traces to replay together, setting this "
+        "option will ignore -s and -t options",
+        {'m', "mix"});
+    args::Flag complete_arg(
+        parser, "complete",
+        "Run the trace or mix until all of its requests have completed, -c "
+        "then only caps the cycles if given",
+        {'r', "run-to-completion"});
+    args::ValueFlag<uint64_t> progress_arg(
+        parser, "progress", "Report progress every this many cycles",
+        {'p', "progress"}, 0);
+    args::ValueFlag<int> clusters_arg(
+        parser, "clusters",
+        "Cluster trace intervals and only simulate one per cluster, "
+        "0 simulates the whole trace",
+        {'k', "clusters"}, 0);
+    args::ValueFlag<uint64_t> interval_arg(
+        parser, "interval", "Interval length (cycles) for trace clustering",
+        {'i', "interval"}, 100000);
+    args::ValueFlag<uint64_t> warmup_arg(
+        parser, "warmup", "Warm-up cycles before each simulated interval",
+        {'w', "warmup"}, 10000);
+    args::ValueFlag<int> threads_arg(
+        parser, "threads", "Threads for clustering, 0 uses all cores",
+        {'j', "threads"}, 0);
     args::Positional<std::string> config_arg(
         parser, "config", "The config file name (mandatory)");
 
@@ -49,9 +84,38 @@ int main(int argc, const char **argv) {
     std::string output_dir = args::get(output_dir_arg);
     std::string trace_file = args::get(trace_file_arg);
     std::string stream_type = args::get(stream_arg);
+    std::string mix_file = args::get(mix_file_arg);
+    bool to_completion = args::get(complete_arg);
+    if (to_completion && trace_file.empty() && mix_file.empty()) {
+        std::cerr << "Only traces can run to completion" << std::endl;
+        return 1;
+    }
+    if (to_completion && !num_cycles_arg) {
+        cycles = std::numeric_limits<uint64_t>::max();
+    }
+
+    int num_clusters = args::get(clusters_arg);
+    if (num_clusters > 0 && !trace_file.empty()) {
+        int num_threads = args::get(threads_arg);
+        if (num_threads <= 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        Config config(config_file, output_dir);
+        TraceClusterer clusterer(config, trace_file, args::get(interval_arg));
+        clusterer.BuildSignatures();
+        auto reps = clusterer.Cluster(num_clusters, num_threads);
+        std::cout << "Simulating " << reps.size() << " of "
+                  << clusterer.Intervals().size() << " intervals"
+                  << std::endl;
+        clusterer.SimulateRepresentatives(config_file, output_dir, reps,
+                                          args::get(warmup_arg));
+        return 0;
+    }
 
     CPU *cpu;
-    if (!trace_file.empty()) {
+    if (!mix_file.empty()) {
+        cpu = new MixedTraceCPU(config_file, output_dir, mix_file);
+    } else if (!trace_file.empty()) {
         cpu = new TraceBasedCPU(config_file, output_dir, trace_file);
     } else {
         if (stream_type == "stream" || stream_type == "s") {
@@ -61,9 +125,7 @@ int main(int argc, const char **argv) {
         }
     }
 
-    for (uint64_t clk = 0; clk < cycles; clk++) {
-        cpu->ClockTick();
-    }
+    cpu->Run(cycles, to_completion, args::get(progress_arg));
     cpu->PrintStats();
 
     delete cpu;
@@ -1,27 +1,46 @@
 #include "memory_system.h"
+#include "cxl.h"
+#include "nvm.h"
 
 namespace dramsim3 {
 MemorySystem::MemorySystem(const std::string &config_file,
                            const std::string &output_dir,
                            std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback)
-    : config_(new Config(config_file, output_dir)) {
-    // TODO: ideal memory type?
-    if (config_->IsHMC()) {
-        dram_system_ = new HMCMemorySystem(*config_, output_dir, read_callback,
-                                           write_callback);
-    } else {
-        dram_system_ = new JedecDRAMSystem(*config_, output_dir, read_callback,
-                                           write_callback);
+    : config_(new Config(config_file, output_dir)), recorder_(nullptr) {
+    if (config_->record_requests) {
+        recorder_ =
+            new RequestRecorder(config_->output_prefix + "requests.bin");
+        read_callback = RecordCallback(read_callback, false);
+        write_callback = RecordCallback(write_callback, true);
     }
+    dram_system_ =
+        GetDRAMSystem(*config_, output_dir, read_callback, write_callback);
 }
 
 MemorySystem::~MemorySystem() {
+    delete (recorder_);
     delete (dram_system_);
     delete (config_);
 }
 
-void MemorySystem::ClockTick() { dram_system_->ClockTick(); }
+void MemorySystem::ClockTick() {
+    dram_system_->ClockTick();
+    if (recorder_) {
+        recorder_->Tick();
+    }
+}
+
+uint64_t MemorySystem::NextEventCycle() const {
+    return dram_system_->NextEventCycle();
+}
+
+void MemorySystem::AdvanceTo(uint64_t cycle) {
+    dram_system_->AdvanceTo(cycle);
+    if (recorder_) {
+        recorder_->AdvanceTo(cycle);
+    }
+}
 
 double MemorySystem::GetTCK() const { return config_->tCK; }
 
@@ -34,21 +53,102 @@ int MemorySystem::GetQueueSize() const { return config_->trans_queue_size; }
 void MemorySystem::RegisterCallbacks(
     std::function<void(uint64_t)> read_callback,
     std::function<void(uint64_t)> write_callback) {
-    dram_system_->RegisterCallbacks(read_callback, write_callback);
+    dram_system_->RegisterCallbacks(RecordCallback(read_callback, false),
+                                    RecordCallback(write_callback, true));
 }
 
 bool MemorySystem::WillAcceptTransaction(uint64_t hex_addr,
                                          bool is_write) const {
-    return dram_system_->WillAcceptTransaction(hex_addr, is_write);
+    bool ok = dram_system_->WillAcceptTransaction(hex_addr, is_write);
+    if (recorder_) {
+        recorder_->Record(RequestOp::WILL_ACCEPT, hex_addr, is_write, 0, ok);
+    }
+    return ok;
+}
+
+bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                  int source_id) {
+    bool ok = dram_system_->AddTransaction(hex_addr, is_write, source_id);
+    if (recorder_) {
+        recorder_->Record(RequestOp::ADD, hex_addr, is_write, source_id, ok);
+    }
+    return ok;
+}
+
+bool MemorySystem::AddPartialWrite(uint64_t hex_addr, int source_id) {
+    bool ok = dram_system_->AddPartialWrite(hex_addr, source_id);
+    if (recorder_) {
+        recorder_->Record(RequestOp::ADD_PARTIAL_WRITE, hex_addr, true,
+                          source_id, ok);
+    }
+    return ok;
 }
 
-bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
-    return dram_system_->AddTransaction(hex_addr, is_write);
+bool MemorySystem::AddBulkCopy(uint64_t src_addr, uint64_t dst_addr) {
+    bool ok = dram_system_->AddBulkCopy(src_addr, dst_addr);
+    if (recorder_) {
+        recorder_->Record(RequestOp::BULK_SOURCE, src_addr, false, 0, true);
+        recorder_->Record(RequestOp::BULK_COPY, dst_addr, true, 0, ok);
+    }
+    return ok;
+}
+
+bool MemorySystem::AddBulkInit(uint64_t dst_addr) {
+    bool ok = dram_system_->AddBulkInit(dst_addr);
+    if (recorder_) {
+        recorder_->Record(RequestOp::BULK_INIT, dst_addr, true, 0, ok);
+    }
+    return ok;
+}
+
+void MemorySystem::PrintStats() const {
+    if (recorder_) {
+        recorder_->Record(RequestOp::PRINT_STATS, 0, false, 0, true);
+    }
+    dram_system_->PrintStats();
+}
+
+void MemorySystem::ResetStats() {
+    if (recorder_) {
+        recorder_->Record(RequestOp::RESET_STATS, 0, false, 0, true);
+    }
+    dram_system_->ResetStats();
 }
 
-void MemorySystem::PrintStats() const { dram_system_->PrintStats(); }
+std::function<void(uint64_t)> MemorySystem::RecordCallback(
+    std::function<void(uint64_t)> callback, bool is_write) {
+    if (recorder_ == nullptr) {
+        return callback;
+    }
+    RequestRecorder *recorder = recorder_;
+    RequestOp op = is_write ? RequestOp::WRITE_DONE : RequestOp::READ_DONE;
+    return [recorder, op, is_write, callback](uint64_t addr) {
+        recorder->Record(op, addr, is_write, 0, true);
+        callback(addr);
+    };
+}
 
-void MemorySystem::ResetStats() { dram_system_->ResetStats(); }
+BaseDRAMSystem *GetDRAMSystem(Config &config, const std::string &output_dir,
+                              std::function<void(uint64_t)> read_callback,
+                              std::function<void(uint64_t)> write_callback) {
+    // TODO: ideal memory type?
+    if (config.IsHMC() && config.num_cubes > 1) {
+        return new HMCNetwork(config, output_dir, read_callback,
+                              write_callback);
+    } else if (config.IsHMC()) {
+        return new HMCMemorySystem(config, output_dir, read_callback,
+                                   write_callback);
+    } else if (config.IsNVM()) {
+        return new NVMMemorySystem(config, output_dir, read_callback,
+                                   write_callback);
+    } else if (config.cxl_enabled) {
+        return new CXLMemorySystem(config, output_dir, read_callback,
+                                   write_callback);
+    } else {
+        return new JedecDRAMSystem(config, output_dir, read_callback,
+                                   write_callback);
+    }
+}
 
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t)> read_callback,
@@ -7,6 +7,7 @@
 #include "configuration.h"
 #include "dram_system.h"
 #include "hmc.h"
+#include "request_log.h"
 
 namespace dramsim3 {
 
@@ -18,6 +19,12 @@ class MemorySystem {
                  std::function<void(uint64_t)> write_callback);
     ~MemorySystem();
     void ClockTick();
+    // earliest cycle at which a ClockTick() can complete a request, refresh
+    // or change any other state. Event-driven hosts can jump straight there
+    // with AdvanceTo(), which ticks up to the given cycle and skips idle
+    // stretches in bulk. Stats are the same as with ClockTick() every cycle
+    uint64_t NextEventCycle() const;
+    void AdvanceTo(uint64_t cycle);
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
     double GetTCK() const;
@@ -28,7 +35,15 @@ class MemorySystem {
     void ResetStats();
 
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
-    bool AddTransaction(uint64_t hex_addr, bool is_write);
+    // source_id tells cores/tenants apart, see bank partitioning in config
+    bool AddTransaction(uint64_t hex_addr, bool is_write, int source_id = 0);
+    // write to part of a line, needs a read-modify-write when ECC is modeled
+    bool AddPartialWrite(uint64_t hex_addr, int source_id = 0);
+    // copy a whole DRAM row, or zero one, in DRAM when row_clone is on and
+    // the rows share a subarray, otherwise with reads and writes. Completes
+    // with a single write callback for dst_addr
+    bool AddBulkCopy(uint64_t src_addr, uint64_t dst_addr);
+    bool AddBulkInit(uint64_t dst_addr);
 
    private:
     // These have to be pointers because Gem5 will try to push this object
@@ -36,8 +51,19 @@ class MemorySystem {
     // here is safe
     Config *config_;
     BaseDRAMSystem *dram_system_;
+    // only set when record_requests is on
+    RequestRecorder *recorder_;
+
+    std::function<void(uint64_t)> RecordCallback(
+        std::function<void(uint64_t)> callback, bool is_write);
 };
 
+// the backend a config asks for, MemorySystem and request log replay both
+// build theirs here so that they always agree
+BaseDRAMSystem *GetDRAMSystem(Config &config, const std::string &output_dir,
+                              std::function<void(uint64_t)> read_callback,
+                              std::function<void(uint64_t)> write_callback);
+
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t)> read_callback,
                  std::function<void(uint64_t)> write_callback);
@@ -0,0 +1,267 @@
+#include "nvm.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "fmt/format.h"
+#include "json.hpp"
+
+namespace dramsim3 {
+
+NVMController::NVMController(int channel, const Config& config)
+    : channel_id_(channel),
+      clk_(0),
+      config_(config),
+      write_draining_(false),
+      bank_free_(config_.ranks * config_.banks, 0),
+      data_bus_free_(0) {
+    read_queue_.reserve(config_.trans_queue_size);
+    wpq_.reserve(config_.nvm_wpq_size);
+    ResetStats();
+}
+
+int NVMController::BankIndex(uint64_t hex_addr) const {
+    Address addr = config_.AddressMapping(hex_addr);
+    return addr.rank * config_.banks + addr.bankgroup * config_.banks_per_group +
+           addr.bank;
+}
+
+bool NVMController::WillAcceptTransaction(uint64_t hex_addr,
+                                          bool is_write) const {
+    if (is_write) {
+        return wpq_.size() < static_cast<size_t>(config_.nvm_wpq_size);
+    }
+    return read_queue_.size() < static_cast<size_t>(config_.trans_queue_size);
+}
+
+bool NVMController::AddTransaction(Transaction trans) {
+    trans.added_cycle = clk_;
+    if (trans.is_write) {
+        // the line crosses the channel into the WPQ, where it is persistent
+        data_bus_free_ = std::max(data_bus_free_, clk_) + config_.burst_cycle;
+        if (wpq_addrs_.count(trans.addr) > 0) {
+            wpq_write_merges_++;
+        } else {
+            wpq_addrs_.insert(trans.addr);
+            wpq_.push_back(trans);
+        }
+        trans.complete_cycle = data_bus_free_;
+    } else if (wpq_addrs_.count(trans.addr) > 0) {
+        wpq_read_hits_++;
+        trans.complete_cycle = clk_ + 1;
+    } else {
+        read_queue_.push_back(trans);
+        return true;
+    }
+    return_queue_.push_back(trans);
+    return true;
+}
+
+std::pair<uint64_t, int> NVMController::ReturnDoneTrans(uint64_t clk) {
+    for (auto it = return_queue_.begin(); it != return_queue_.end(); it++) {
+        if (clk >= it->complete_cycle) {
+            if (it->is_write) {
+                num_writes_done_++;
+            } else {
+                num_reads_done_++;
+                read_latency_sum_ += clk_ - it->added_cycle;
+            }
+            auto pair = std::make_pair(it->addr, it->is_write);
+            return_queue_.erase(it);
+            return pair;
+        }
+    }
+    return std::make_pair(-1, -1);
+}
+
+void NVMController::ClockTick() {
+    // finished writes give their share of the power budget back
+    write_ends_.erase(
+        std::remove_if(write_ends_.begin(), write_ends_.end(),
+                       [this](uint64_t end) { return end <= clk_; }),
+        write_ends_.end());
+
+    // drain the WPQ when the reads leave the media alone or when it is
+    // filling up, until it is half empty again
+    size_t wpq_size = static_cast<size_t>(config_.nvm_wpq_size);
+    if (!write_draining_) {
+        write_draining_ = !wpq_.empty() &&
+                          (read_queue_.empty() || wpq_.size() >= wpq_size * 3 / 4);
+    } else if (wpq_.empty() ||
+               (!read_queue_.empty() && wpq_.size() <= wpq_size / 2)) {
+        write_draining_ = false;
+    }
+
+    // one request a cycle goes to the media
+    if (!(write_draining_ && IssueWrite())) {
+        IssueRead();
+    }
+
+    if (wpq_.size() >= wpq_size) {
+        wpq_full_cycles_++;
+    }
+    clk_++;
+    return;
+}
+
+bool NVMController::IssueRead() {
+    for (auto it = read_queue_.begin(); it != read_queue_.end(); it++) {
+        int bank = BankIndex(it->addr);
+        if (clk_ < bank_free_[bank]) {
+            continue;
+        }
+        bank_free_[bank] = clk_ + config_.nvm_read_latency;
+        data_bus_free_ = std::max(data_bus_free_, bank_free_[bank]) +
+                         config_.burst_cycle;
+        it->complete_cycle = data_bus_free_;
+        return_queue_.push_back(*it);
+        read_queue_.erase(it);
+        media_reads_++;
+        return true;
+    }
+    return false;
+}
+
+bool NVMController::IssueWrite() {
+    if (write_ends_.size() >= static_cast<size_t>(config_.nvm_write_budget)) {
+        write_budget_stall_cycles_++;
+        return false;
+    }
+    for (auto it = wpq_.begin(); it != wpq_.end(); it++) {
+        int bank = BankIndex(it->addr);
+        if (clk_ < bank_free_[bank]) {
+            continue;
+        }
+        bank_free_[bank] = clk_ + config_.nvm_write_latency;
+        write_ends_.push_back(bank_free_[bank]);
+        line_writes_[it->addr >> config_.shift_bits]++;
+        wpq_addrs_.erase(it->addr);
+        wpq_.erase(it);
+        media_writes_++;
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::pair<std::string, double> > NVMController::GetStats() const {
+    uint64_t max_line_writes = 0;
+    for (const auto& line : line_writes_) {
+        max_line_writes = std::max(max_line_writes, line.second);
+    }
+    double avg_read_latency =
+        num_reads_done_ == 0
+            ? 0.0
+            : static_cast<double>(read_latency_sum_) / num_reads_done_;
+    double avg_line_writes =
+        line_writes_.empty()
+            ? 0.0
+            : static_cast<double>(media_writes_) / line_writes_.size();
+    std::vector<std::pair<std::string, double> > stats = {
+        {"num_reads_done", num_reads_done_},
+        {"num_writes_done", num_writes_done_},
+        {"wpq_read_hits", wpq_read_hits_},
+        {"wpq_write_merges", wpq_write_merges_},
+        {"media_reads", media_reads_},
+        {"media_writes", media_writes_},
+        {"average_read_latency", avg_read_latency},
+        {"wpq_full_cycles", wpq_full_cycles_},
+        {"write_budget_stall_cycles", write_budget_stall_cycles_},
+        {"lines_written", line_writes_.size()},
+        {"max_line_writes", max_line_writes},
+        {"average_line_writes", avg_line_writes}};
+    return stats;
+}
+
+void NVMController::ResetStats() {
+    num_reads_done_ = 0;
+    num_writes_done_ = 0;
+    wpq_read_hits_ = 0;
+    wpq_write_merges_ = 0;
+    media_reads_ = 0;
+    media_writes_ = 0;
+    read_latency_sum_ = 0;
+    wpq_full_cycles_ = 0;
+    write_budget_stall_cycles_ = 0;
+    line_writes_.clear();
+}
+
+NVMMemorySystem::NVMMemorySystem(Config& config, const std::string& output_dir,
+                                 std::function<void(uint64_t)> read_callback,
+                                 std::function<void(uint64_t)> write_callback)
+    : BaseDRAMSystem(config, output_dir, read_callback, write_callback) {
+    nvm_ctrls_.reserve(config_.channels);
+    for (int i = 0; i < config_.channels; i++) {
+        nvm_ctrls_.push_back(new NVMController(i, config_));
+    }
+}
+
+NVMMemorySystem::~NVMMemorySystem() {
+    for (auto ctrl : nvm_ctrls_) {
+        delete ctrl;
+    }
+}
+
+bool NVMMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
+                                            bool is_write) const {
+    int channel = GetChannel(hex_addr);
+    return nvm_ctrls_[channel]->WillAcceptTransaction(hex_addr, is_write);
+}
+
+bool NVMMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     int source_id) {
+    int channel = GetChannel(hex_addr);
+    if (!nvm_ctrls_[channel]->WillAcceptTransaction(hex_addr, is_write)) {
+        return false;
+    }
+    Transaction trans(hex_addr, is_write);
+    trans.source_id = source_id;
+    nvm_ctrls_[channel]->AddTransaction(trans);
+    last_req_clk_ = clk_;
+    return true;
+}
+
+void NVMMemorySystem::ClockTick() {
+    for (auto ctrl : nvm_ctrls_) {
+        while (true) {
+            auto pair = ctrl->ReturnDoneTrans(clk_);
+            if (pair.second == 1) {
+                write_callback_(pair.first);
+            } else if (pair.second == 0) {
+                read_callback_(pair.first);
+            } else {
+                break;
+            }
+        }
+    }
+    for (auto ctrl : nvm_ctrls_) {
+        ctrl->ClockTick();
+    }
+    clk_++;
+    return;
+}
+
+void NVMMemorySystem::PrintStats() {
+    std::ofstream txt_out(config_.txt_stats_name);
+    nlohmann::json j_data;
+    for (size_t i = 0; i < nvm_ctrls_.size(); i++) {
+        txt_out << "###########################################\n"
+                << "## Statistics of NVM Channel " << i << "\n"
+                << "###########################################\n";
+        for (const auto& it : nvm_ctrls_[i]->GetStats()) {
+            txt_out << fmt::format("{:<30}{:^3}{:>12}", it.first, " = ",
+                                   it.second)
+                    << std::endl;
+            j_data[std::to_string(i)][it.first] = it.second;
+        }
+    }
+    std::ofstream json_out(config_.json_stats_name);
+    json_out << j_data;
+}
+
+void NVMMemorySystem::ResetStats() {
+    for (auto ctrl : nvm_ctrls_) {
+        ctrl->ResetStats();
+    }
+}
+
+}  // namespace dramsim3
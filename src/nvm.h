@@ -0,0 +1,81 @@
+#ifndef __NVM_H
+#define __NVM_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "dram_system.h"
+
+namespace dramsim3 {
+
+// One channel of a PCM/3D XPoint-like memory. There are no rows or
+// refreshes, every bank is busy for the read or (much longer) write latency
+// of the media. Writes complete once they are in the large on-DIMM write
+// pending queue (WPQ), which is drained to the media in the background, or
+// with priority over reads when it fills up, and no more than write_budget
+// writes can be in flight in a channel at a time to stay within its power
+// budget.
+class NVMController {
+   public:
+    NVMController(int channel, const Config& config);
+    void ClockTick();
+    bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
+    bool AddTransaction(Transaction trans);
+    std::pair<uint64_t, int> ReturnDoneTrans(uint64_t clk);
+    // name and value of every stat of the channel
+    std::vector<std::pair<std::string, double> > GetStats() const;
+    void ResetStats();
+
+   private:
+    int channel_id_;
+    uint64_t clk_;
+    const Config& config_;
+
+    std::vector<Transaction> read_queue_;
+    std::vector<Transaction> wpq_;
+    std::unordered_set<uint64_t> wpq_addrs_;
+    std::vector<Transaction> return_queue_;
+    bool write_draining_;
+
+    std::vector<uint64_t> bank_free_;  // per bank, when it is idle again
+    std::vector<uint64_t> write_ends_;  // of the writes in flight
+    uint64_t data_bus_free_;
+
+    // wear, the media writes to every line written so far
+    std::unordered_map<uint64_t, uint64_t> line_writes_;
+
+    uint64_t num_reads_done_, num_writes_done_;
+    uint64_t wpq_read_hits_, wpq_write_merges_;
+    uint64_t media_reads_, media_writes_;
+    uint64_t read_latency_sum_;
+    uint64_t wpq_full_cycles_;
+    uint64_t write_budget_stall_cycles_;
+
+    int BankIndex(uint64_t hex_addr) const;
+    bool IssueRead();
+    bool IssueWrite();
+};
+
+class NVMMemorySystem : public BaseDRAMSystem {
+   public:
+    NVMMemorySystem(Config& config, const std::string& output_dir,
+                    std::function<void(uint64_t)> read_callback,
+                    std::function<void(uint64_t)> write_callback);
+    ~NVMMemorySystem();
+    bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        int source_id = 0) override;
+    void ClockTick() override;
+    void PrintStats() override;
+    void ResetStats() override;
+
+   private:
+    std::vector<NVMController*> nvm_ctrls_;
+};
+
+}  // namespace dramsim3
+#endif
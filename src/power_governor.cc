@@ -0,0 +1,179 @@
+#include "power_governor.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace dramsim3 {
+
+namespace {
+const uint64_t kNever = std::numeric_limits<uint64_t>::max();
+}  // namespace
+
+PowerGovernor::PowerGovernor(const Config& config,
+                             const ChannelState& channel_state,
+                             SimpleStats& simple_stats)
+    : clk_(0),
+      config_(config),
+      channel_state_(channel_state),
+      simple_stats_(simple_stats),
+      was_busy_(config.ranks, false),
+      idle_since_(config.ranks, 0),
+      predicted_idle_(config.ranks, 0),
+      wake_at_(config.ranks, kNever),
+      woke_early_(config.ranks, false),
+      was_sref_(config.ranks, false),
+      was_pd_(config.ranks, false),
+      awake_at_(config.ranks, 0) {}
+
+void PowerGovernor::Update(const std::vector<bool>& rank_busy) {
+    for (int i = 0; i < config_.ranks; i++) {
+        if (rank_busy[i] && !was_busy_[i]) {
+            // an idle period ended, weigh it in with the earlier ones
+            uint64_t idle = clk_ - idle_since_[i];
+            predicted_idle_[i] = (3 * predicted_idle_[i] + idle) / 4;
+            woke_early_[i] = false;
+        } else if (!rank_busy[i] && was_busy_[i]) {
+            idle_since_[i] = clk_;
+        }
+        was_busy_[i] = rank_busy[i];
+
+        bool is_sref = channel_state_.IsRankSelfRefreshing(i);
+        bool is_pd = channel_state_.IsRankPoweredDown(i);
+        if (is_sref && !was_sref_[i]) {
+            // wake up early enough for the predicted request, unless the
+            // rank only got here because the prediction was too short
+            uint64_t due = idle_since_[i] + predicted_idle_[i];
+            wake_at_[i] =
+                config_.power_governor && due > clk_ + config_.tXS
+                    ? due - config_.tXS
+                    : kNever;
+        } else if (!is_sref && was_sref_[i]) {
+            awake_at_[i] = clk_ + config_.tXS;
+            woke_early_[i] = !rank_busy[i];
+        } else if (!is_pd && was_pd_[i]) {
+            awake_at_[i] = clk_ + config_.tXP;
+        }
+        was_sref_[i] = is_sref;
+        was_pd_[i] = is_pd;
+
+        if (rank_busy[i] && (is_sref || is_pd || clk_ < awake_at_[i])) {
+            simple_stats_.Increment("lowpower_wait_cycles");
+        }
+    }
+    return;
+}
+
+Command PowerGovernor::GetCommandToIssue(
+    const std::vector<bool>& rank_busy) const {
+    for (int i = 0; i < config_.ranks; i++) {
+        Command cmd = config_.power_governor
+                          ? PredictiveCommand(i, rank_busy[i])
+                          : ThresholdCommand(i, rank_busy[i]);
+        if (cmd.IsValid()) {
+            return cmd;
+        }
+    }
+    return Command();
+}
+
+uint64_t PowerGovernor::NextEventCycle() const {
+    uint64_t next = kNever;
+    for (int i = 0; i < config_.ranks; i++) {
+        bool is_sref = channel_state_.IsRankSelfRefreshing(i);
+        bool is_pd = channel_state_.IsRankPoweredDown(i);
+        // Update() has yet to see the last transition
+        if (was_busy_[i] || is_sref != was_sref_[i] || is_pd != was_pd_[i]) {
+            return clk_;
+        }
+        uint64_t sref_threshold = static_cast<uint64_t>(config_.sref_threshold);
+        uint64_t pd_threshold = static_cast<uint64_t>(config_.pd_threshold);
+        if (is_sref) {
+            if (config_.power_governor) {
+                next = std::min(next, wake_at_[i]);
+            }
+        } else if (is_pd) {
+            if (!woke_early_[i]) {
+                next = std::min(next, idle_since_[i] + sref_threshold);
+            }
+        } else if (!config_.power_governor) {
+            // rank_idle_cycles is counted before the governor looks at it
+            if (channel_state_.IsAllBankIdleInRank(i)) {
+                uint64_t idle = channel_state_.rank_idle_cycles[i] + 1;
+                next = std::min(next, idle >= sref_threshold
+                                          ? clk_
+                                          : clk_ + sref_threshold - idle);
+            }
+        } else {
+            uint64_t idle = clk_ - idle_since_[i];
+            uint64_t remaining =
+                predicted_idle_[i] > idle ? predicted_idle_[i] - idle : 0;
+            // the prediction only gets shorter from here
+            if (remaining >= pd_threshold ||
+                (!woke_early_[i] && remaining >= sref_threshold)) {
+                return clk_;
+            }
+            uint64_t wait = woke_early_[i]
+                                ? pd_threshold
+                                : std::min(pd_threshold, sref_threshold);
+            next = std::min(next, idle_since_[i] + wait);
+        }
+    }
+    return std::max(next, clk_);
+}
+
+Command PowerGovernor::ThresholdCommand(int rank, bool busy) const {
+    if (channel_state_.IsRankSelfRefreshing(rank)) {
+        return busy ? ReadyRankCommand(CommandType::SREF_EXIT, rank)
+                    : Command();
+    }
+    if (!busy && !channel_state_.IsRankRefreshWaiting(rank) &&
+        channel_state_.rank_idle_cycles[rank] >= config_.sref_threshold) {
+        return ReadyRankCommand(CommandType::SREF_ENTER, rank);
+    }
+    return Command();
+}
+
+Command PowerGovernor::PredictiveCommand(int rank, bool busy) const {
+    bool refresh_waiting = channel_state_.IsRankRefreshWaiting(rank);
+    uint64_t idle = clk_ - idle_since_[rank];
+    if (channel_state_.IsRankSelfRefreshing(rank)) {
+        if (busy || clk_ >= wake_at_[rank]) {
+            return ReadyRankCommand(CommandType::SREF_EXIT, rank);
+        }
+        return Command();
+    }
+    bool sref_pays_off =
+        !woke_early_[rank] &&
+        idle >= static_cast<uint64_t>(config_.sref_threshold);
+    if (channel_state_.IsRankPoweredDown(rank)) {
+        // refreshes need the rank awake, and so does self-refresh entry
+        if (busy || refresh_waiting || sref_pays_off) {
+            return ReadyRankCommand(CommandType::PD_EXIT, rank);
+        }
+        return Command();
+    }
+    if (busy || refresh_waiting) {
+        return Command();
+    }
+    uint64_t remaining =
+        predicted_idle_[rank] > idle ? predicted_idle_[rank] - idle : 0;
+    if (sref_pays_off ||
+        (!woke_early_[rank] &&
+         remaining >= static_cast<uint64_t>(config_.sref_threshold))) {
+        return ReadyRankCommand(CommandType::SREF_ENTER, rank);
+    }
+    if (std::max(idle, remaining) >=
+        static_cast<uint64_t>(config_.pd_threshold)) {
+        return ReadyRankCommand(CommandType::PD_ENTER, rank);
+    }
+    return Command();
+}
+
+Command PowerGovernor::ReadyRankCommand(CommandType cmd_type, int rank) const {
+    // the banks of the rank may have to be precharged first
+    Address addr;
+    addr.rank = rank;
+    return channel_state_.GetReadyCommand(Command(cmd_type, addr, -1), clk_);
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,56 @@
+#ifndef __POWER_GOVERNOR_H
+#define __POWER_GOVERNOR_H
+
+#include <vector>
+#include "channel_state.h"
+#include "common.h"
+#include "configuration.h"
+#include "simple_stats.h"
+
+namespace dramsim3 {
+
+// Moves idle ranks into precharge power-down or self-refresh and wakes them
+// up again. Without power_governor a rank enters self-refresh after
+// sref_threshold idle cycles. With it, the length of every idle period is
+// predicted from the previous ones, a rank goes into the deepest state the
+// prediction pays off for right away, and leaves self-refresh tXS before
+// the next request is due. Idle periods longer than predicted fall back to
+// the thresholds.
+class PowerGovernor {
+   public:
+    PowerGovernor(const Config& config, const ChannelState& channel_state,
+                  SimpleStats& simple_stats);
+    // rank_busy tells which ranks have requests waiting for them, in the
+    // command queue or still in the transaction queues
+    void Update(const std::vector<bool>& rank_busy);
+    // the power state command to issue this cycle, if any
+    Command GetCommandToIssue(const std::vector<bool>& rank_busy) const;
+    void ClockTick() { clk_++; }
+    // earliest cycle the governor may change a power state at, provided no
+    // rank gets busy until then
+    uint64_t NextEventCycle() const;
+    void SkipCycles(uint64_t cycles) { clk_ += cycles; }
+
+   private:
+    uint64_t clk_;
+    const Config& config_;
+    const ChannelState& channel_state_;
+    SimpleStats& simple_stats_;
+
+    // per rank
+    std::vector<bool> was_busy_;
+    std::vector<uint64_t> idle_since_;  // when the rank ran out of requests
+    std::vector<uint64_t> predicted_idle_;  // moving average of idle periods
+    std::vector<uint64_t> wake_at_;         // early self-refresh exit
+    std::vector<bool> woke_early_;  // left self-refresh before a request
+    std::vector<bool> was_sref_;
+    std::vector<bool> was_pd_;
+    std::vector<uint64_t> awake_at_;  // when the last exit latency is over
+
+    Command ThresholdCommand(int rank, bool busy) const;
+    Command PredictiveCommand(int rank, bool busy) const;
+    Command ReadyRankCommand(CommandType cmd_type, int rank) const;
+};
+
+}  // namespace dramsim3
+#endif
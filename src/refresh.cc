@@ -13,6 +13,10 @@ Refresh::Refresh(const Config &config, ChannelState &channel_state)
         refresh_interval_ = config_.tREFI;
     } else if (refresh_policy_ == RefreshPolicy::BANK_LEVEL_STAGGERED) {
         refresh_interval_ = config_.tREFIb;
+    } else if (refresh_policy_ == RefreshPolicy::SAME_BANK_STAGGERED) {
+        // every bank index has to be refreshed once per tREFI in each rank
+        refresh_interval_ =
+            config_.tREFI / config_.banks_per_group / config_.ranks;
     } else {  // default refresh scheme: RANK STAGGERED
         refresh_interval_ = config_.tREFI / config_.ranks;
     }
@@ -26,6 +30,14 @@ void Refresh::ClockTick() {
     return;
 }
 
+uint64_t Refresh::NextRefreshCycle() const {
+    uint64_t interval = static_cast<uint64_t>(refresh_interval_);
+    if (clk_ == 0) {
+        return interval;
+    }
+    return (clk_ + interval - 1) / interval * interval;
+}
+
 void Refresh::InsertRefresh() {
     switch (refresh_policy_) {
         // Simultaneous all rank refresh
@@ -52,6 +64,14 @@ void Refresh::InsertRefresh() {
             }
             IterateNext();
             break;
+        // DDR5 same bank refresh, one bank index of all bankgroups at a time
+        case RefreshPolicy::SAME_BANK_STAGGERED:
+            if (!channel_state_.IsRankSelfRefreshing(next_rank_)) {
+                channel_state_.SameBankNeedRefresh(next_rank_, next_bank_,
+                                                   true);
+            }
+            IterateNext();
+            break;
         default:
             AbruptExit(__FILE__, __LINE__);
             break;
@@ -75,6 +95,12 @@ void Refresh::IterateNext() {
                 }
             }
             return;
+        case RefreshPolicy::SAME_BANK_STAGGERED:
+            next_bank_ = (next_bank_ + 1) % config_.banks_per_group;
+            if (next_bank_ == 0) {
+                next_rank_ = (next_rank_ + 1) % config_.ranks;
+            }
+            return;
         default:
             AbruptExit(__FILE__, __LINE__);
             return;
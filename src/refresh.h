@@ -12,6 +12,9 @@ class Refresh {
    public:
     Refresh(const Config& config, ChannelState& channel_state);
     void ClockTick();
+    // cycle at which the next refresh is inserted
+    uint64_t NextRefreshCycle() const;
+    void SkipCycles(uint64_t cycles) { clk_ += cycles; }
 
    private:
     uint64_t clk_;
@@ -0,0 +1,50 @@
+#include <iostream>
+#include "./../ext/headers/args.hxx"
+#include "configuration.h"
+#include "request_log.h"
+
+using namespace dramsim3;
+
+int main(int argc, const char **argv) {
+    args::ArgumentParser parser(
+        "Replay a request log recorded with record_requests = true.",
+        "Examples: \n"
+        "./build/dramsim3replay configs/DDR4_8Gb_x8_3200.ini "
+        "dramsim3requests.bin -o replay_out");
+    args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
+    args::ValueFlag<std::string> output_dir_arg(
+        parser, "output_dir", "Output directory for stats files",
+        {'o', "output-dir"}, ".");
+    args::Positional<std::string> config_arg(
+        parser, "config", "The config file name (mandatory)");
+    args::Positional<std::string> log_arg(parser, "log",
+                                          "Request log (mandatory)");
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (const args::Help&) {
+        std::cout << parser;
+        return 0;
+    } catch (const args::ParseError& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::string config_file = args::get(config_arg);
+    std::string log_file = args::get(log_arg);
+    if (config_file.empty() || log_file.empty()) {
+        std::cerr << parser;
+        return 1;
+    }
+
+    // same as MemorySystem, except that the replay is never recorded again
+    Config config(config_file, args::get(output_dir_arg));
+    config.record_requests = false;
+    ReplayResult result = ReplayRequestLog(config, log_file);
+
+    std::cout << "Replayed " << result.num_records << " records over "
+              << result.num_cycles << " cycles, " << result.mismatches
+              << " mismatches" << std::endl;
+    return result.mismatches == 0 ? 0 : 1;
+}
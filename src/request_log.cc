@@ -0,0 +1,182 @@
+#include "request_log.h"
+
+#include <deque>
+#include <iostream>
+
+#include "memory_system.h"
+
+namespace dramsim3 {
+
+namespace {
+const size_t kRecordsPerChunk = 1 << 14;
+
+// completions the memory system produced but the log has not matched yet
+struct Completion {
+    uint64_t clk;
+    uint64_t addr;
+    bool is_write;
+};
+}  // namespace
+
+RequestRecorder::RequestRecorder(const std::string& log_file) : clk_(0) {
+    file_ = fopen(log_file.c_str(), "wb");
+    if (file_ == nullptr) {
+        std::cerr << "Cannot open request log " << log_file << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    buffer_.reserve(kRecordsPerChunk);
+}
+
+RequestRecorder::~RequestRecorder() {
+    Record(RequestOp::END, 0, false, 0, true);
+    Flush();
+    fclose(file_);
+}
+
+void RequestRecorder::Record(RequestOp op, uint64_t addr, bool is_write,
+                             int source_id, bool result) {
+    RequestRecord rec = {};
+    rec.clk = clk_;
+    rec.addr = addr;
+    rec.source_id = static_cast<uint16_t>(source_id);
+    rec.op = static_cast<uint8_t>(op);
+    rec.is_write = is_write;
+    rec.result = result;
+    buffer_.push_back(rec);
+    if (buffer_.size() == kRecordsPerChunk) {
+        Flush();
+    }
+}
+
+void RequestRecorder::Flush() {
+    fwrite(buffer_.data(), sizeof(RequestRecord), buffer_.size(), file_);
+    buffer_.clear();
+}
+
+RequestLogReader::RequestLogReader(const std::string& log_file)
+    : buffer_(kRecordsPerChunk), buf_pos_(0), buf_len_(0) {
+    file_ = fopen(log_file.c_str(), "rb");
+    if (file_ == nullptr) {
+        std::cerr << "Cannot open request log " << log_file << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+RequestLogReader::~RequestLogReader() { fclose(file_); }
+
+bool RequestLogReader::Next(RequestRecord& rec) {
+    if (buf_pos_ == buf_len_) {
+        buf_len_ = fread(buffer_.data(), sizeof(RequestRecord), buffer_.size(),
+                         file_);
+        buf_pos_ = 0;
+        if (buf_len_ == 0) {
+            return false;
+        }
+    }
+    rec = buffer_[buf_pos_++];
+    return true;
+}
+
+ReplayResult ReplayRequestLog(Config& config, const std::string& log_file) {
+    uint64_t clk = 0;
+    std::deque<Completion> completions;
+    auto read_callback = [&](uint64_t addr) {
+        completions.push_back({clk, addr, false});
+    };
+    auto write_callback = [&](uint64_t addr) {
+        completions.push_back({clk, addr, true});
+    };
+    BaseDRAMSystem* dram_system = GetDRAMSystem(
+        config, config.output_dir, read_callback, write_callback);
+
+    RequestLogReader reader(log_file);
+    RequestRecord rec;
+    uint64_t bulk_src = 0;
+    uint64_t num_records = 0;
+    uint64_t mismatches = 0;
+    auto mismatch = [&](const std::string& what) {
+        if (mismatches++ < 10) {
+            std::cerr << "Replay diverged at cycle " << rec.clk << ": " << what
+                      << " 0x" << std::hex << rec.addr << std::dec
+                      << std::endl;
+        }
+    };
+    while (reader.Next(rec)) {
+        num_records++;
+        auto op = static_cast<RequestOp>(rec.op);
+        // completions are recorded during the tick at rec.clk, everything
+        // else between ticks
+        bool is_completion =
+            op == RequestOp::READ_DONE || op == RequestOp::WRITE_DONE;
+        while (clk < rec.clk || (is_completion && clk == rec.clk)) {
+            dram_system->ClockTick();
+            clk++;
+        }
+        switch (op) {
+            case RequestOp::WILL_ACCEPT:
+                if (dram_system->WillAcceptTransaction(rec.addr,
+                                                       rec.is_write) !=
+                    static_cast<bool>(rec.result)) {
+                    mismatch("acceptance differs for");
+                }
+                break;
+            case RequestOp::ADD:
+                if (dram_system->AddTransaction(rec.addr, rec.is_write,
+                                                rec.source_id) !=
+                    static_cast<bool>(rec.result)) {
+                    mismatch("add result differs for");
+                }
+                break;
+            case RequestOp::ADD_PARTIAL_WRITE:
+                if (dram_system->AddPartialWrite(rec.addr, rec.source_id) !=
+                    static_cast<bool>(rec.result)) {
+                    mismatch("add result differs for");
+                }
+                break;
+            case RequestOp::BULK_SOURCE:
+                bulk_src = rec.addr;
+                break;
+            case RequestOp::BULK_COPY:
+                if (dram_system->AddBulkCopy(bulk_src, rec.addr) !=
+                    static_cast<bool>(rec.result)) {
+                    mismatch("bulk copy result differs for");
+                }
+                break;
+            case RequestOp::BULK_INIT:
+                if (dram_system->AddBulkInit(rec.addr) !=
+                    static_cast<bool>(rec.result)) {
+                    mismatch("bulk init result differs for");
+                }
+                break;
+            case RequestOp::READ_DONE:
+            case RequestOp::WRITE_DONE:
+                if (completions.empty() ||
+                    completions.front().clk != rec.clk ||
+                    completions.front().addr != rec.addr ||
+                    completions.front().is_write !=
+                        (op == RequestOp::WRITE_DONE)) {
+                    mismatch("completion differs for");
+                }
+                if (!completions.empty()) {
+                    completions.pop_front();
+                }
+                break;
+            case RequestOp::RESET_STATS:
+                dram_system->ResetStats();
+                break;
+            case RequestOp::PRINT_STATS:
+                dram_system->PrintStats();
+                break;
+            case RequestOp::END:
+                break;
+            default:
+                std::cerr << "Unknown record in request log" << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+        }
+    }
+    mismatches += completions.size();
+    delete dram_system;
+    return {num_records, clk, mismatches};
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,84 @@
+#ifndef __REQUEST_LOG_H
+#define __REQUEST_LOG_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+enum class RequestOp : uint8_t {
+    WILL_ACCEPT,
+    ADD,
+    ADD_PARTIAL_WRITE,
+    READ_DONE,
+    WRITE_DONE,
+    RESET_STATS,
+    PRINT_STATS,
+    BULK_SOURCE,  // source row of the BULK_COPY that follows
+    BULK_COPY,
+    BULK_INIT,
+    END,  // last record, clk is the total number of ticks
+    SIZE
+};
+
+// fixed size record of one MemorySystem interaction, clk is the number of
+// ClockTick() calls before it happened
+struct RequestRecord {
+    uint64_t clk;
+    uint64_t addr;
+    uint16_t source_id;
+    uint8_t op;
+    uint8_t is_write;
+    uint8_t result;  // what the call returned, for replay verification
+    uint8_t padding[3];
+};
+
+// Records every host interaction with a memory system into a binary log,
+// records are buffered and written out in large chunks
+class RequestRecorder {
+   public:
+    explicit RequestRecorder(const std::string& log_file);
+    ~RequestRecorder();
+    void Tick() { clk_++; }
+    void AdvanceTo(uint64_t clk) { clk_ = clk; }
+    void Record(RequestOp op, uint64_t addr, bool is_write, int source_id,
+                bool result);
+
+   private:
+    FILE* file_;
+    std::vector<RequestRecord> buffer_;
+    uint64_t clk_;
+
+    void Flush();
+};
+
+class RequestLogReader {
+   public:
+    explicit RequestLogReader(const std::string& log_file);
+    ~RequestLogReader();
+    bool Next(RequestRecord& rec);
+
+   private:
+    FILE* file_;
+    std::vector<RequestRecord> buffer_;
+    size_t buf_pos_;
+    size_t buf_len_;
+};
+
+struct ReplayResult {
+    uint64_t num_records;
+    uint64_t num_cycles;
+    uint64_t mismatches;
+};
+
+// Replays a request log on the backend config asks for and checks every
+// return value and completion against the recorded ones, the first few
+// mismatches are reported on stderr. Set record_requests to false first.
+ReplayResult ReplayRequestLog(Config& config, const std::string& log_file);
+
+}  // namespace dramsim3
+#endif
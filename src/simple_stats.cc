@@ -1,13 +1,18 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <mutex>
 
 #include "fmt/format.h"
+#include "json.hpp"
 #include "simple_stats.h"
 
 namespace dramsim3 {
 
 template <class T>
-void PrintStatText(std::ostream& where, std::string name, T value,
-                   std::string description) {
+void PrintStatText(std::ostream& where, const std::string& name, T value,
+                   const std::string& description) {
     // not making this a class method because we need to calculate
     // power & bw later, which are not BaseStat members
     where << fmt::format("{:<30}{:^3}{:>12}{:>5}{}", name, " = ", value, " # ",
@@ -16,8 +21,32 @@ void PrintStatText(std::ostream& where, std::string name, T value,
     return;
 }
 
-SimpleStats::SimpleStats(const Config& config, int channel_id)
-    : config_(config), channel_id_(channel_id) {
+// numbers written the way nlohmann::json dumps them
+void AppendUint(std::string& out, uint64_t value) {
+    char digits[20];
+    int len = 0;
+    do {
+        digits[len++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (len > 0) {
+        out += digits[--len];
+    }
+}
+
+void AppendDouble(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    char number[64];
+    char* end = nlohmann::detail::to_chars(number, number + sizeof(number),
+                                           value);
+    out.append(number, end - number);
+}
+
+StatsSchema::StatsSchema(const Config& config)
+    : num_counters_(0), num_doubles_(0), num_histos_(0) {
     // counter stats
     InitStat("num_cycles", "counter", "Number of DRAM cycles");
     InitStat("epoch_num", "counter", "Number of epochs");
@@ -34,9 +63,16 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
     InitStat("num_ondemand_pres", "counter", "Number of ondemend PRE commands");
     InitStat("num_ref_cmds", "counter", "Number of REF commands");
     InitStat("num_refb_cmds", "counter", "Number of REFb commands");
+    InitStat("num_refsb_cmds", "counter", "Number of REFsb commands");
     InitStat("num_srefe_cmds", "counter", "Number of SREFE commands");
     InitStat("num_srefx_cmds", "counter", "Number of SREFX commands");
     InitStat("hbm_dual_cmds", "counter", "Number of cycles dual cmds issued");
+    InitStat("num_scrub_reads", "counter", "Number of patrol scrub reads");
+    InitStat("num_partial_writes", "counter",
+             "Number of partial writes needing RMW");
+    InitStat("num_rmw_reads", "counter", "Number of ECC RMW reads");
+    InitStat("internal_read_cycles", "counter",
+             "Data bus cycles of scrub/RMW reads while host reads waited");
 
     // double stats
     InitStat("act_energy", "double", "Activation energy");
@@ -44,46 +80,281 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
     InitStat("write_energy", "double", "Write energy");
     InitStat("ref_energy", "double", "Refresh energy");
     InitStat("refb_energy", "double", "Refresh-bank energy");
+    InitStat("refsb_energy", "double", "Same-bank refresh energy");
 
     // Vector counter stats
     InitVecStat("all_bank_idle_cycles", "vec_counter",
-                "Cyles of all bank idle in rank", "rank", config_.ranks);
+                "Cyles of all bank idle in rank", "rank", config.ranks);
     InitVecStat("rank_active_cycles", "vec_counter", "Cyles of rank active",
-                "rank", config_.ranks);
+                "rank", config.ranks);
     InitVecStat("sref_cycles", "vec_counter", "Cyles of rank in SREF mode",
-                "rank", config_.ranks);
+                "rank", config.ranks);
+    InitVecStat("bank_act_cmds", "vec_counter", "Number of ACT commands to",
+                "bank", config.ranks * config.banks);
+    InitVecStat("bank_read_cmds", "vec_counter", "Number of READ commands to",
+                "bank", config.ranks * config.banks);
+    InitVecStat("bank_write_cmds", "vec_counter",
+                "Number of WRITE commands to", "bank",
+                config.ranks * config.banks);
+    InitVecStat("bank_ref_cmds", "vec_counter", "Number of refreshes covering",
+                "bank", config.ranks * config.banks);
+    InitVecStat("source_act_cmds", "vec_counter", "Number of ACT commands for",
+                "source", config.num_sources);
+    InitVecStat("interference_misses", "vec_counter",
+                "Row misses caused by another source for", "source",
+                config.num_sources);
 
     // Vector of double stats
     InitVecStat("act_stb_energy", "vec_double", "Active standby energy", "rank",
-                config_.ranks);
+                config.ranks);
     InitVecStat("pre_stb_energy", "vec_double", "Precharge standby energy",
-                "rank", config_.ranks);
+                "rank", config.ranks);
     InitVecStat("sref_energy", "vec_double", "SREF energy", "rank",
-                config_.ranks);
+                config.ranks);
+    InitVecStat("bank_energy", "vec_double",
+                "Energy (pJ) incl. background share of", "bank",
+                config.ranks * config.banks);
 
     // Histogram stats
     InitHistoStat("read_latency", "Read request latency (cycles)", 0, 200, 10);
     InitHistoStat("write_latency", "Write cmd latency (cycles)", 0, 200, 10);
+    InitHistoStat("rmw_latency", "Partial write wait for RMW read (cycles)",
+                  0, 200, 10);
     InitHistoStat("interarrival_latency",
                   "Request interarrival latency (cycles)", 0, 100, 10);
 
+    // sampled read latency breakdown, only when enabled
+    if (config.latency_sample_interval > 0) {
+        InitStat("num_sampled_reads", "counter",
+                 "Number of reads sampled for latency breakdown");
+        InitStat("sampled_bank_conflicts", "counter",
+                 "Sampled reads that needed a PRE");
+        InitStat("sampled_refresh_waits", "counter",
+                 "Sampled reads whose bank refreshed while they waited");
+        InitHistoStat("lat_trans_queue",
+                      "Sampled read wait in transaction queue (cycles)", 0,
+                      200, 10);
+        InitHistoStat("lat_cmd_queue",
+                      "Sampled read wait in command queue (cycles)", 0, 200,
+                      10);
+        InitHistoStat("lat_pre_to_act", "Sampled read PRE to ACT (cycles)", 0,
+                      100, 10);
+        InitHistoStat("lat_act_to_cas", "Sampled read ACT to CAS (cycles)", 0,
+                      100, 10);
+    }
+
+    // in-DRAM row copy/init, only when enabled
+    if (config.row_clone) {
+        InitStat("num_row_clone_copies", "counter",
+                 "Number of rows copied in DRAM");
+        InitStat("num_row_clone_inits", "counter",
+                 "Number of rows initialized in DRAM");
+        InitStat("row_clone_energy", "double", "Row clone energy");
+        InitStat("row_clone_saved_bandwidth", "calculated",
+                 "Bus bandwidth row clones did not need (GB/s)");
+        InitStat("row_clone_saved_energy", "calculated",
+                 "Energy saved vs copying with reads/writes (pJ)");
+    }
+
+    if (config.ca_bus_model) {
+        InitStat("ca_bus_cycles", "counter",
+                 "Command bus cycles taken by commands");
+        InitStat("ca_bus_utilization", "calculated",
+                 "Fraction of command bus cycles in use");
+    }
+
+    // power-down, only registered when ranks can leave standby at all
+    if (config.enable_self_refresh) {
+        InitStat("num_pde_cmds", "counter", "Number of PDE commands");
+        InitStat("num_pdx_cmds", "counter", "Number of PDX commands");
+        InitStat("lowpower_wait_cycles", "counter",
+                 "Cycles requests waited for a rank to wake up");
+        InitVecStat("pd_cycles", "vec_counter",
+                    "Cyles of rank in power-down mode", "rank", config.ranks);
+        InitVecStat("pd_energy", "vec_double", "Power-down energy", "rank",
+                    config.ranks);
+        InitStat("lowpower_energy_saved", "calculated",
+                 "Energy saved vs precharge standby (pJ)");
+    }
+
+    if (config.salp != SALPMode::NONE) {
+        InitStat("num_subarray_overlap_acts", "counter",
+                 "ACTs overlapped with another subarray of the bank");
+    }
+
     // some irregular stats
     InitStat("average_bandwidth", "calculated", "Average bandwidth");
+    InitStat("scrub_bandwidth", "calculated", "Patrol scrub bandwidth");
+    InitStat("rmw_bandwidth", "calculated", "ECC RMW read bandwidth");
     InitStat("total_energy", "calculated", "Total energy (pJ)");
     InitStat("average_power", "calculated", "Average power (mW)");
+    InitStat("energy_per_bit", "calculated",
+             "Energy per bit transferred (pJ/bit)");
+    InitStat("energy_delay_product", "calculated",
+             "Total energy x average read latency (pJ*ns)");
+    InitStat("bandwidth_per_watt", "calculated",
+             "Average bandwidth per watt (GB/s/W)");
     InitStat("average_read_latency", "calculated",
              "Average read request latency (cycles)");
     InitStat("average_interarrival", "calculated",
              "Average request interarrival latency (cycles)");
+    InitJsonFields();
+}
+
+const StatsSchema& StatsSchema::Get(const Config& config) {
+    // every config parameter the schema depends on
+    std::string key = fmt::format(
+        "{} {} {} {} {} {} {} {}", config.ranks, config.banks,
+        config.num_sources, config.latency_sample_interval > 0,
+        config.row_clone, config.ca_bus_model, config.enable_self_refresh,
+        config.salp != SALPMode::NONE);
+    static std::mutex schemas_mutex;
+    static std::map<std::string, StatsSchema> schemas;
+    std::lock_guard<std::mutex> lock(schemas_mutex);
+    auto it = schemas.find(key);
+    if (it == schemas.end()) {
+        it = schemas.emplace(key, StatsSchema(config)).first;
+    }
+    return it->second;
+}
+
+const StatsSchema::Stat& StatsSchema::GetStat(const std::string& name) const {
+    auto it = ids_.find(name);
+    if (it == ids_.end()) {
+        std::cerr << "Unknown stat " << name << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return stats_[it->second];
+}
+
+void StatsSchema::InitStat(std::string name, std::string stat_type,
+                           std::string description) {
+    Stat stat = {name, Type::COUNTER, num_counters_, 1,
+                 static_cast<int>(headers_.size()), 0, 0, 0};
+    if (stat_type == "counter") {
+        num_counters_++;
+    } else {
+        stat.type = stat_type == "double" ? Type::DOUBLE : Type::CALCULATED;
+        stat.offset = num_doubles_++;
+    }
+    headers_.push_back(name);
+    descs_.push_back(description);
+    ids_.emplace(name, stats_.size());
+    stats_.push_back(stat);
 }
 
-void SimpleStats::AddValue(const std::string name, const int value) {
-    auto& epoch_counts = epoch_histo_counts_[name];
-    if (epoch_counts.count(value) <= 0) {
-        epoch_counts[value] = 1;
+void StatsSchema::InitVecStat(std::string name, std::string stat_type,
+                              std::string description, std::string part_name,
+                              int vec_len) {
+    Stat stat = {name, Type::VEC_COUNTER, num_counters_, vec_len,
+                 static_cast<int>(headers_.size()), 0, 0, 0};
+    if (stat_type == "vec_counter") {
+        num_counters_ += vec_len;
     } else {
-        epoch_counts[value] += 1;
+        stat.type = Type::VEC_DOUBLE;
+        stat.offset = num_doubles_;
+        num_doubles_ += vec_len;
+    }
+    for (int i = 0; i < vec_len; i++) {
+        std::string trailing = "." + std::to_string(i);
+        headers_.push_back(name + trailing);
+        descs_.push_back(description + " " + part_name + trailing);
     }
+    ids_.emplace(name, stats_.size());
+    stats_.push_back(stat);
+}
+
+void StatsSchema::InitHistoStat(std::string name, std::string description,
+                                int start_val, int end_val, int num_bins) {
+    int bin_width = (end_val - start_val) / num_bins;
+    // +2 for front and end
+    Stat stat = {name,    Type::HISTO, num_histos_++, num_bins + 2,
+                 static_cast<int>(headers_.size()), start_val, end_val,
+                 bin_width};
+
+    // initialize headers, descriptions
+    headers_.push_back(fmt::format("{}[-{}]", name, start_val));
+    for (int i = 1; i < num_bins + 1; i++) {
+        int bucket_start = start_val + (i - 1) * bin_width;
+        int bucket_end = start_val + i * bin_width - 1;
+        headers_.push_back(
+            fmt::format("{}[{}-{}]", name, bucket_start, bucket_end));
+    }
+    headers_.push_back(fmt::format("{}[{}-]", name, end_val));
+    descs_.resize(headers_.size(), description);
+    ids_.emplace(name, stats_.size());
+    stats_.push_back(stat);
+}
+
+void StatsSchema::InitJsonFields() {
+    json_fields_.push_back({"channel", Field::CHANNEL, 0, 0, {}});
+    for (const auto& stat : stats_) {
+        if (stat.type == Type::HISTO) {
+            for (int i = 0; i < stat.length; i++) {
+                json_fields_.push_back({headers_[stat.header_offset + i],
+                                        Field::HISTO_BIN, stat.offset, i, {}});
+            }
+            json_fields_.push_back(
+                {stat.name, Field::HISTO, stat.offset, 0, {}});
+            continue;
+        }
+        JsonField json_field = {stat.name, Field::COUNTER, stat.offset, 0, {}};
+        if (stat.name == "epoch_num") {
+            json_field.field = Field::EPOCH_NUM;
+        } else if (stat.type == Type::DOUBLE || stat.type == Type::CALCULATED) {
+            json_field.field = Field::DOUBLE;
+        } else if (stat.type == Type::VEC_COUNTER ||
+                   stat.type == Type::VEC_DOUBLE) {
+            json_field.field = stat.type == Type::VEC_COUNTER
+                                   ? Field::VEC_COUNTER
+                                   : Field::VEC_DOUBLE;
+            for (int i = 0; i < stat.length; i++) {
+                json_field.elements.emplace_back(stat.offset + i,
+                                                 std::to_string(i));
+            }
+            std::sort(json_field.elements.begin(), json_field.elements.end(),
+                      [](const std::pair<int, std::string>& a,
+                         const std::pair<int, std::string>& b) {
+                          return a.second < b.second;
+                      });
+        }
+        json_fields_.push_back(json_field);
+    }
+    std::sort(json_fields_.begin(), json_fields_.end(),
+              [](const JsonField& a, const JsonField& b) {
+                  return a.key < b.key;
+              });
+    // quote the keys only once sorted, as unquoted strings
+    for (auto& json_field : json_fields_) {
+        json_field.key = nlohmann::json(json_field.key).dump() + ":";
+        for (auto& element : json_field.elements) {
+            element.second = nlohmann::json(element.second).dump() + ":";
+        }
+    }
+}
+
+SimpleStats::SimpleStats(const Config& config, int channel_id)
+    : config_(config),
+      schema_(StatsSchema::Get(config)),
+      channel_id_(channel_id),
+      counters_(schema_.NumCounters(), 0),
+      epoch_counters_(schema_.NumCounters(), 0),
+      printed_epoch_counters_(schema_.NumCounters(), 0),
+      doubles_(schema_.NumDoubles(), 0.0),
+      histo_counts_(schema_.NumHistos()),
+      epoch_histo_counts_(schema_.NumHistos()),
+      printed_epoch_histo_counts_(schema_.NumHistos()),
+      histo_bins_(schema_.NumHistos()),
+      epoch_histo_bins_(schema_.NumHistos()),
+      delta_base_(false) {
+    for (const auto& stat : schema_.Stats()) {
+        if (stat.type == StatsSchema::Type::HISTO) {
+            histo_bins_[stat.offset].resize(stat.length, 0);
+            epoch_histo_bins_[stat.offset].resize(stat.length, 0);
+        }
+    }
+    // room for an epoch record, final records only grow it once
+    json_buf_.reserve(schema_.Headers().size() * 32);
 }
 
 std::string SimpleStats::GetTextHeader(bool is_final) const {
@@ -92,35 +363,40 @@ std::string SimpleStats::GetTextHeader(bool is_final) const {
         "Channel " +
         std::to_string(channel_id_);
     if (!is_final) {
-        header += " of epoch " + std::to_string(counters_.at("epoch_num"));
+        header += " of epoch " + std::to_string(Counter("epoch_num", false));
     }
     header += "\n###########################################\n";
     return header;
 }
 
 void SimpleStats::PrintEpochStats() {
-    UpdateEpochStats();
+    UpdateStats(true);
     if (config_.output_level >= 1) {
+        WriteJson(true);
         std::ofstream j_out(config_.json_epoch_name, std::ofstream::app);
-        j_out << j_data_;
+        j_out.write(json_buf_.data(), json_buf_.size());
     }
     if (config_.output_level >= 2) {
         std::cout << GetTextHeader(false);
-        for (const auto& it : print_pairs_) {
-            PrintStatText(std::cout, it.first, it.second,
-                          header_descs_[it.first]);
-        }
+        PrintText(std::cout, true);
+    }
+    // keep the epoch printed around, start the next one from scratch
+    printed_epoch_counters_.swap(epoch_counters_);
+    printed_epoch_histo_counts_.swap(epoch_histo_counts_);
+    std::fill(epoch_counters_.begin(), epoch_counters_.end(), 0);
+    for (auto& it : epoch_histo_counts_) {
+        it.clear();
     }
-    print_pairs_.clear();
 }
 
 void SimpleStats::PrintFinalStats() {
-    UpdateFinalStats();
+    UpdateStats(false);
 
     if (config_.output_level >= 0) {
+        WriteJson(false);
         std::ofstream j_out(config_.json_stats_name, std::ofstream::app);
         j_out << "\"" << std::to_string(channel_id_) << "\":";
-        j_out << j_data_;
+        j_out.write(json_buf_.data(), json_buf_.size());
     }
 
     if (config_.output_level >= 1) {
@@ -128,153 +404,64 @@ void SimpleStats::PrintFinalStats() {
         auto perm = channel_id_ == 0 ? std::ofstream::out : std::ofstream::app;
         std::ofstream txt_out(config_.txt_stats_name, perm);
         txt_out << GetTextHeader(true);
-        for (const auto& it : print_pairs_) {
-            PrintStatText(txt_out, it.first, it.second,
-                          header_descs_[it.first]);
-        }
+        PrintText(txt_out, false);
     }
-
-    print_pairs_.clear();
 }
 
 void SimpleStats::Reset() {
-    for (auto& it : counters_) {
-        it.second = 0;
-    }
-    for (auto& it : epoch_counters_) {
-        it.second = 0;
-    }
-    for (auto& vec : vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& vec : epoch_vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& it : doubles_) {
-        it.second = 0.0;
-    }
-    for (auto& vec : vec_doubles_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0.0);
-    }
-    for (auto& it : calculated_) {
-        it.second = 0.0;
-    }
+    std::fill(counters_.begin(), counters_.end(), 0);
+    std::fill(epoch_counters_.begin(), epoch_counters_.end(), 0);
+    std::fill(printed_epoch_counters_.begin(), printed_epoch_counters_.end(),
+              0);
+    std::fill(doubles_.begin(), doubles_.end(), 0.0);
     for (auto& it : histo_counts_) {
-        it.second.clear();
+        it.clear();
     }
     for (auto& it : epoch_histo_counts_) {
-        it.second.clear();
+        it.clear();
     }
-}
-
-void SimpleStats::InitStat(std::string name, std::string stat_type,
-                           std::string description) {
-    header_descs_.emplace(name, description);
-    if (stat_type == "counter") {
-        counters_.emplace(name, 0);
-        epoch_counters_.emplace(name, 0);
-    } else if (stat_type == "double") {
-        doubles_.emplace(name, 0.0);
-    } else if (stat_type == "calculated") {
-        calculated_.emplace(name, 0.0);
+    for (auto& it : printed_epoch_histo_counts_) {
+        it.clear();
     }
-}
-
-void SimpleStats::InitVecStat(std::string name, std::string stat_type,
-                              std::string description, std::string part_name,
-                              int vec_len) {
-    for (int i = 0; i < vec_len; i++) {
-        std::string trailing = "." + std::to_string(i);
-        std::string actual_name = name + trailing;
-        std::string actual_desc = description + " " + part_name + trailing;
-        header_descs_.emplace(actual_name, actual_desc);
-    }
-    if (stat_type == "vec_counter") {
-        vec_counters_.emplace(name, std::vector<uint64_t>(vec_len, 0));
-        epoch_vec_counters_.emplace(name, std::vector<uint64_t>(vec_len, 0));
-    } else if (stat_type == "vec_double") {
-        vec_doubles_.emplace(name, std::vector<double>(vec_len, 0));
-    }
-}
-
-void SimpleStats::InitHistoStat(std::string name, std::string description,
-                                int start_val, int end_val, int num_bins) {
-    int bin_width = (end_val - start_val) / num_bins;
-    bin_widths_.emplace(name, bin_width);
-    histo_bounds_.emplace(name, std::make_pair(start_val, end_val));
-    histo_counts_.emplace(name, std::unordered_map<int, uint64_t>());
-    epoch_histo_counts_.emplace(name, std::unordered_map<int, uint64_t>());
-
-    // initialize headers, descriptions
-    std::vector<std::string> headers;
-    auto header = fmt::format("{}[-{}]", name, start_val);
-    headers.push_back(header);
-    header_descs_.emplace(header, description);
-    for (int i = 1; i < num_bins + 1; i++) {
-        int bucket_start = start_val + (i - 1) * bin_width;
-        int bucket_end = start_val + i * bin_width - 1;
-        header = fmt::format("{}[{}-{}]", name, bucket_start, bucket_end);
-        headers.push_back(header);
-        header_descs_.emplace(header, description);
-    }
-    header = fmt::format("{}[{}-]", name, end_val);
-    headers.push_back(header);
-    header_descs_.emplace(header, description);
-
-    histo_headers_.emplace(name, headers);
-
-    // +2 for front and end
-    histo_bins_.emplace(name, std::vector<uint64_t>(num_bins + 2, 0));
-    epoch_histo_bins_.emplace(name, std::vector<uint64_t>(num_bins + 2, 0));
+    // the next epoch record is a complete one
+    delta_base_ = false;
 }
 
 void SimpleStats::UpdateCounters() {
-    for (const auto& it : epoch_counters_) {
-        counters_[it.first] += it.second;
-    }
-    for (const auto& vec : epoch_vec_counters_) {
-        for (size_t i = 0; i < vec.second.size(); i++) {
-            vec_counters_[vec.first][i] += vec.second[i];
-        }
+    for (size_t i = 0; i < counters_.size(); i++) {
+        counters_[i] += epoch_counters_[i];
     }
 }
 
 void SimpleStats::UpdateHistoBins() {
-    for (auto& name_bins : epoch_histo_bins_) {
-        const auto& name = name_bins.first;
-        auto& bins = name_bins.second;
+    for (const auto& stat : schema_.Stats()) {
+        if (stat.type != StatsSchema::Type::HISTO) {
+            continue;
+        }
+        auto& bins = epoch_histo_bins_[stat.offset];
         std::fill(bins.begin(), bins.end(), 0);
-        for (const auto it : epoch_histo_counts_[name]) {
+        for (const auto it : epoch_histo_counts_[stat.offset]) {
             int value = it.first;
             uint64_t count = it.second;
             int bin_idx = 0;
-            if (value < histo_bounds_[name].first) {
+            if (value < stat.start_val) {
                 bin_idx = 0;
-            } else if (value > histo_bounds_[name].second) {
+            } else if (value > stat.end_val) {
                 bin_idx = bins.size() - 1;
             } else {
-                bin_idx =
-                    (value - histo_bounds_[name].first) / bin_widths_[name] + 1;
+                bin_idx = (value - stat.start_val) / stat.bin_width + 1;
             }
             bins[bin_idx] += count;
         }
-    }
 
-    // update overall histogram counts based on epoch histo counts
-    for (auto& name_counts : epoch_histo_counts_) {
-        const auto& name = name_counts.first;
-        auto& epoch_counts = name_counts.second;
-        auto& final_counts = histo_counts_[name];
-        for (const auto& val_cnt : epoch_counts) {
-            if (final_counts.count(val_cnt.first) <= 0) {
-                final_counts[val_cnt.first] = val_cnt.second;
-            } else {
-                final_counts[val_cnt.first] += val_cnt.second;
-            }
+        // update overall histogram counts based on epoch histo counts
+        auto& final_counts = histo_counts_[stat.offset];
+        for (const auto& val_cnt : epoch_histo_counts_[stat.offset]) {
+            final_counts[val_cnt.first] += val_cnt.second;
         }
-        auto& final_bins = histo_bins_[name];
+        auto& final_bins = histo_bins_[stat.offset];
         for (size_t i = 0; i < final_bins.size(); i++) {
-            final_bins[i] += epoch_histo_bins_[name][i];
+            final_bins[i] += bins[i];
         }
     }
 }
@@ -291,183 +478,320 @@ double SimpleStats::GetHistoAvg(const HistoCount& hist_counts) const {
                : static_cast<double>(accu_sum) / static_cast<double>(count);
 }
 
-void SimpleStats::UpdatePrints(bool epoch) {
-    j_data_["channel"] = channel_id_;
-
-    std::unordered_map<std::string, uint64_t>& ref_counters =
-        epoch ? epoch_counters_ : counters_;
-    for (const auto& it : ref_counters) {
-        print_pairs_.emplace_back(it.first, std::to_string(it.second));
-        j_data_[it.first] = it.second;
+bool SimpleStats::Changed(const StatsSchema::JsonField& field) const {
+    // epoch values against the ones of the last epoch record
+    using Field = StatsSchema::Field;
+    switch (field.field) {
+        case Field::COUNTER:
+            return epoch_counters_[field.offset] !=
+                   printed_epoch_counters_[field.offset];
+        case Field::VEC_COUNTER:
+            for (const auto& element : field.elements) {
+                if (epoch_counters_[element.first] !=
+                    printed_epoch_counters_[element.first]) {
+                    return true;
+                }
+            }
+            return false;
+        case Field::HISTO_BIN:
+            return epoch_histo_bins_[field.offset][field.index] !=
+                   last_epoch_bins_[field.offset][field.index];
+        case Field::DOUBLE:
+            return doubles_[field.offset] != last_doubles_[field.offset];
+        case Field::VEC_DOUBLE:
+            for (const auto& element : field.elements) {
+                if (doubles_[element.first] != last_doubles_[element.first]) {
+                    return true;
+                }
+            }
+            return false;
+        default:
+            return true;
     }
-    j_data_["epoch_num"] = counters_["epoch_num"];
+}
 
-    VecStat& ref_vcounter = epoch ? epoch_vec_counters_ : vec_counters_;
-    for (const auto& it : ref_vcounter) {
-        Json j_list;
-        for (size_t i = 0; i < it.second.size(); i++) {
-            std::string name = it.first + "." + std::to_string(i);
-            print_pairs_.emplace_back(name, std::to_string(it.second[i]));
-            j_list[std::to_string(i)] = it.second[i];
+void SimpleStats::WriteJson(bool epoch) {
+    // straight from the values into the buffer, no JSON objects or strings
+    // of single values in between
+    using Field = StatsSchema::Field;
+    bool delta = epoch && config_.epoch_delta && delta_base_;
+    const auto& counters = epoch ? epoch_counters_ : counters_;
+    const auto& hbins = epoch ? epoch_histo_bins_ : histo_bins_;
+    json_buf_.clear();
+    json_buf_ += '{';
+    for (const auto& field : schema_.JsonFields()) {
+        // if we dump complete histogram data each epoch the output file will
+        // be huge therefore we only put aggregated histo in each epoch but
+        // complete data at the end
+        if ((epoch && field.field == Field::HISTO) ||
+            (delta && !Changed(field))) {
+            continue;
         }
-        j_data_[it.first] = j_list;
-    }
-    VecStat& ref_hbins = epoch ? epoch_histo_bins_ : histo_bins_;
-    for (const auto& it : ref_hbins) {
-        const auto& names = histo_headers_[it.first];
-        for (size_t i = 0; i < it.second.size(); i++) {
-            print_pairs_.emplace_back(names[i], std::to_string(it.second[i]));
-            j_data_[names[i]] = it.second[i];
-        }
-    }
-
-    // if we dump complete histogram data each epoch the output file will be
-    // huge therefore we only put aggregated histo in each epoch but
-    // complete data at the end
-    if (!epoch) {
-        for (const auto& name_hist : histo_counts_) {
-            Json j_list;
-            for (const auto& it : name_hist.second) {
-                j_list[std::to_string(it.first)] = it.second;
+        json_buf_ += field.key;
+        switch (field.field) {
+            case Field::CHANNEL:
+                AppendUint(json_buf_, channel_id_);
+                break;
+            case Field::EPOCH_NUM:
+                AppendUint(json_buf_, counters_[field.offset]);
+                break;
+            case Field::COUNTER:
+                AppendUint(json_buf_, counters[field.offset]);
+                break;
+            case Field::HISTO_BIN:
+                AppendUint(json_buf_, hbins[field.offset][field.index]);
+                break;
+            case Field::DOUBLE:
+                AppendDouble(json_buf_, doubles_[field.offset]);
+                break;
+            case Field::VEC_COUNTER:
+            case Field::VEC_DOUBLE:
+                if (field.elements.empty()) {
+                    json_buf_ += "null";
+                    break;
+                }
+                json_buf_ += '{';
+                for (const auto& element : field.elements) {
+                    json_buf_ += element.second;
+                    if (field.field == Field::VEC_COUNTER) {
+                        AppendUint(json_buf_, counters[element.first]);
+                    } else {
+                        AppendDouble(json_buf_, doubles_[element.first]);
+                    }
+                    json_buf_ += ',';
+                }
+                json_buf_.back() = '}';
+                break;
+            case Field::HISTO: {
+                const auto& counts = histo_counts_[field.offset];
+                if (counts.empty()) {
+                    json_buf_ += "null";
+                    break;
+                }
+                // keyed by the values as strings
+                std::vector<std::pair<std::string, uint64_t> > sorted;
+                sorted.reserve(counts.size());
+                for (const auto& it : counts) {
+                    sorted.emplace_back(std::to_string(it.first), it.second);
+                }
+                std::sort(sorted.begin(), sorted.end());
+                json_buf_ += '{';
+                for (const auto& it : sorted) {
+                    json_buf_ += '"' + it.first + "\":";
+                    AppendUint(json_buf_, it.second);
+                    json_buf_ += ',';
+                }
+                json_buf_.back() = '}';
+                break;
             }
-            j_data_[name_hist.first] = j_list;
         }
+        json_buf_ += ',';
     }
+    // there is always the channel
+    json_buf_.back() = '}';
 
-    for (const auto& it : doubles_) {
-        print_pairs_.emplace_back(it.first, fmt::format("{}", it.second));
-        j_data_[it.first] = it.second;
+    if (epoch && config_.epoch_delta) {
+        last_doubles_ = doubles_;
+        last_epoch_bins_ = epoch_histo_bins_;
+        delta_base_ = true;
     }
+}
 
-    for (const auto& it : vec_doubles_) {
-        Json j_list;
-        for (size_t i = 0; i < it.second.size(); i++) {
-            std::string name = it.first + "." + std::to_string(i);
-            print_pairs_.emplace_back(name, fmt::format("{}", it.second[i]));
-            j_list[std::to_string(i)] = it.second[i];
+void SimpleStats::PrintText(std::ostream& where, bool epoch) const {
+    // grouped by type, in the order they are defined in
+    using Type = StatsSchema::Type;
+    const auto& counters = epoch ? epoch_counters_ : counters_;
+    const auto& hbins = epoch ? epoch_histo_bins_ : histo_bins_;
+    const auto& headers = schema_.Headers();
+    const auto& descs = schema_.Descriptions();
+    for (auto type : {Type::COUNTER, Type::VEC_COUNTER, Type::HISTO,
+                      Type::DOUBLE, Type::VEC_DOUBLE, Type::CALCULATED}) {
+        for (const auto& stat : schema_.Stats()) {
+            if (stat.type != type) {
+                continue;
+            }
+            for (int i = 0; i < stat.length; i++) {
+                int header = stat.header_offset + i;
+                if (type == Type::COUNTER || type == Type::VEC_COUNTER) {
+                    PrintStatText(where, headers[header],
+                                  counters[stat.offset + i], descs[header]);
+                } else if (type == Type::HISTO) {
+                    PrintStatText(where, headers[header],
+                                  hbins[stat.offset][i], descs[header]);
+                } else {
+                    PrintStatText(where, headers[header],
+                                  doubles_[stat.offset + i], descs[header]);
+                }
+            }
         }
-        j_data_[it.first] = j_list;
-    }
-    for (const auto& it : calculated_) {
-        print_pairs_.emplace_back(it.first, fmt::format("{}", it.second));
-        j_data_[it.first] = it.second;
     }
 }
 
-void SimpleStats::UpdateEpochStats() {
+void SimpleStats::UpdateStats(bool epoch) {
     // push counter values as is
     UpdateCounters();
 
     // update computed stats
-    doubles_["act_energy"] =
-        epoch_counters_["num_act_cmds"] * config_.act_energy_inc;
-    doubles_["read_energy"] =
-        epoch_counters_["num_read_cmds"] * config_.read_energy_inc;
-    doubles_["write_energy"] =
-        epoch_counters_["num_write_cmds"] * config_.write_energy_inc;
-    doubles_["ref_energy"] =
-        epoch_counters_["num_ref_cmds"] * config_.ref_energy_inc;
-    doubles_["refb_energy"] =
-        epoch_counters_["num_refb_cmds"] * config_.refb_energy_inc;
+    Double("act_energy") =
+        Counter("num_act_cmds", epoch) * config_.act_energy_inc;
+    Double("read_energy") =
+        Counter("num_read_cmds", epoch) * config_.read_energy_inc;
+    Double("write_energy") =
+        Counter("num_write_cmds", epoch) * config_.write_energy_inc;
+    Double("ref_energy") =
+        Counter("num_ref_cmds", epoch) * config_.ref_energy_inc;
+    Double("refb_energy") =
+        Counter("num_refb_cmds", epoch) * config_.refb_energy_inc;
+    Double("refsb_energy") =
+        Counter("num_refsb_cmds", epoch) * config_.refsb_energy_inc;
 
     // vector doubles, update first, then push
     double background_energy = 0.0;
     for (int i = 0; i < config_.ranks; i++) {
-        double act_stb = epoch_vec_counters_["rank_active_cycles"][i] *
+        double act_stb = Counter("rank_active_cycles", epoch, i) *
                          config_.act_stb_energy_inc;
-        double pre_stb = epoch_vec_counters_["all_bank_idle_cycles"][i] *
+        double pre_stb = Counter("all_bank_idle_cycles", epoch, i) *
                          config_.pre_stb_energy_inc;
         double sref_energy =
-            epoch_vec_counters_["sref_cycles"][i] * config_.sref_energy_inc;
-        vec_doubles_["act_stb_energy"][i] = act_stb;
-        vec_doubles_["pre_stb_energy"][i] = pre_stb;
-        vec_doubles_["sref_energy"][i] = sref_energy;
+            Counter("sref_cycles", epoch, i) * config_.sref_energy_inc;
+        Double("act_stb_energy", i) = act_stb;
+        Double("pre_stb_energy", i) = pre_stb;
+        Double("sref_energy", i) = sref_energy;
         background_energy += act_stb + pre_stb + sref_energy;
     }
 
+    // histograms
     UpdateHistoBins();
 
     // calculated stats
     uint64_t total_reqs =
-        epoch_counters_["num_reads_done"] + epoch_counters_["num_writes_done"];
-    double total_time = epoch_counters_["num_cycles"] * config_.tCK;
+        Counter("num_reads_done", epoch) + Counter("num_writes_done", epoch);
+    uint64_t num_cycles = Counter("num_cycles", epoch);
+    double total_time = num_cycles * config_.tCK;
     double avg_bw = total_reqs * config_.request_size_bytes / total_time;
-    calculated_["average_bandwidth"] = avg_bw;
-
-    double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
-                          doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
-    calculated_["total_energy"] = total_energy;
-    calculated_["average_power"] = total_energy / epoch_counters_["num_cycles"];
-    calculated_["average_read_latency"] =
-        GetHistoAvg(epoch_histo_counts_.at("read_latency"));
-    calculated_["average_interarrival"] =
-        GetHistoAvg(epoch_histo_counts_.at("interarrival_latency"));
+    Double("average_bandwidth") = avg_bw;
+    Double("scrub_bandwidth") = Counter("num_scrub_reads", epoch) *
+                                config_.request_size_bytes / total_time;
+    Double("rmw_bandwidth") = Counter("num_rmw_reads", epoch) *
+                              config_.request_size_bytes / total_time;
+    if (config_.ca_bus_model) {
+        Double("ca_bus_utilization") =
+            static_cast<double>(Counter("ca_bus_cycles", epoch)) /
+            (num_cycles * (config_.split_ca_bus ? 2 : 1));
+    }
+
+    double total_energy = Double("act_energy") + Double("read_energy") +
+                          Double("write_energy") + Double("ref_energy") +
+                          Double("refb_energy") + Double("refsb_energy") +
+                          background_energy +
+                          UpdateRowCloneStats(epoch, total_time) +
+                          UpdateLowPowerStats(epoch);
+    Double("total_energy") = total_energy;
+    Double("average_power") = total_energy / num_cycles;
+    Double("average_read_latency") = GetHistoAvg(Histo("read_latency", epoch));
+    Double("average_interarrival") =
+        GetHistoAvg(Histo("interarrival_latency", epoch));
+    UpdateBankEnergy(epoch);
+    UpdateEfficiency(epoch, total_energy, total_time);
+    return;
+}
 
-    UpdatePrints(true);
-    for (auto& it : epoch_counters_) {
-        it.second = 0;
-    }
-    for (auto& vec : epoch_vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& it : epoch_histo_counts_) {
-        it.second.clear();
+void SimpleStats::UpdateBankEnergy(bool epoch) {
+    // must be called after rank background energies are updated
+    double bank_ref_inc = 0.0;
+    switch (config_.refresh_policy) {
+        case RefreshPolicy::RANK_LEVEL_SIMULTANEOUS:
+        case RefreshPolicy::RANK_LEVEL_STAGGERED:
+            bank_ref_inc = config_.ref_energy_inc / config_.banks;
+            break;
+        case RefreshPolicy::BANK_LEVEL_STAGGERED:
+            bank_ref_inc = config_.refb_energy_inc;
+            break;
+        case RefreshPolicy::SAME_BANK_STAGGERED:
+            bank_ref_inc = config_.refsb_energy_inc / config_.bankgroups;
+            break;
+        default:
+            break;
+    }
+    int num_banks = config_.ranks * config_.banks;
+    for (int i = 0; i < num_banks; i++) {
+        // background energy is a rank property, split evenly among banks
+        int rank = i / config_.banks;
+        double background = Double("act_stb_energy", rank) +
+                            Double("pre_stb_energy", rank) +
+                            Double("sref_energy", rank);
+        if (config_.enable_self_refresh) {
+            background += Double("pd_energy", rank);
+        }
+        Double("bank_energy", i) =
+            Counter("bank_act_cmds", epoch, i) * config_.act_energy_inc +
+            Counter("bank_read_cmds", epoch, i) * config_.read_energy_inc +
+            Counter("bank_write_cmds", epoch, i) * config_.write_energy_inc +
+            Counter("bank_ref_cmds", epoch, i) * bank_ref_inc +
+            background / config_.banks;
     }
     return;
 }
 
-void SimpleStats::UpdateFinalStats() {
-    UpdateCounters();
+void SimpleStats::UpdateEfficiency(bool epoch, double total_energy,
+                                   double total_time) {
+    // must be called after bandwidth and read latency are calculated
+    uint64_t bits =
+        (Counter("num_read_cmds", epoch) + Counter("num_write_cmds", epoch)) *
+        config_.request_size_bytes * 8;
+    Double("energy_per_bit") = bits == 0 ? 0.0 : total_energy / bits;
+    Double("energy_delay_product") =
+        total_energy * Double("average_read_latency") * config_.tCK;
+    // pJ / ns = mW, B / ns = GB/s
+    double power_watt = total_energy / total_time / 1000.0;
+    Double("bandwidth_per_watt") =
+        power_watt == 0.0 ? 0.0 : Double("average_bandwidth") / power_watt;
+    return;
+}
 
-    // update computed stats
-    doubles_["act_energy"] = counters_["num_act_cmds"] * config_.act_energy_inc;
-    doubles_["read_energy"] =
-        counters_["num_read_cmds"] * config_.read_energy_inc;
-    doubles_["write_energy"] =
-        counters_["num_write_cmds"] * config_.write_energy_inc;
-    doubles_["ref_energy"] = counters_["num_ref_cmds"] * config_.ref_energy_inc;
-    doubles_["refb_energy"] =
-        counters_["num_refb_cmds"] * config_.refb_energy_inc;
+double SimpleStats::UpdateRowCloneStats(bool epoch, double total_time) {
+    // returns the energy of the clones themselves, compared against moving
+    // the rows with row buffer hit reads and writes over the bus
+    if (!config_.row_clone) {
+        return 0.0;
+    }
+    double copies = Counter("num_row_clone_copies", epoch);
+    double inits = Counter("num_row_clone_inits", epoch);
+    double clone_energy = (copies + inits) * config_.row_clone_energy_inc;
+    Double("row_clone_energy") = clone_energy;
+
+    double lines = static_cast<double>(config_.co_mask + 1);
+    double saved_bytes =
+        (2 * copies + inits) * lines * config_.request_size_bytes;
+    Double("row_clone_saved_bandwidth") = saved_bytes / total_time;
+    double bus_energy =
+        copies * (2 * config_.act_energy_inc +
+                  lines * (config_.read_energy_inc + config_.write_energy_inc)) +
+        inits * (config_.act_energy_inc + lines * config_.write_energy_inc);
+    Double("row_clone_saved_energy") = bus_energy - clone_energy;
+    return clone_energy;
+}
 
-    // vector doubles, update first, then push
-    double background_energy = 0.0;
-    for (int i = 0; i < config_.ranks; i++) {
-        double act_stb =
-            vec_counters_["rank_active_cycles"][i] * config_.act_stb_energy_inc;
-        double pre_stb = vec_counters_["all_bank_idle_cycles"][i] *
-                         config_.pre_stb_energy_inc;
-        double sref_energy =
-            vec_counters_["sref_cycles"][i] * config_.sref_energy_inc;
-        vec_doubles_["act_stb_energy"][i] = act_stb;
-        vec_doubles_["pre_stb_energy"][i] = pre_stb;
-        vec_doubles_["sref_energy"][i] = sref_energy;
-        background_energy += act_stb + pre_stb + sref_energy;
+double SimpleStats::UpdateLowPowerStats(bool epoch) {
+    // returns the power-down background energy, savings are against spending
+    // the same cycles in precharge standby
+    if (!config_.enable_self_refresh) {
+        return 0.0;
     }
-
-    // histograms
-    UpdateHistoBins();
-
-    // calculated stats
-    uint64_t total_reqs =
-        counters_["num_reads_done"] + counters_["num_writes_done"];
-    double total_time = counters_["num_cycles"] * config_.tCK;
-    double avg_bw = total_reqs * config_.request_size_bytes / total_time;
-    calculated_["average_bandwidth"] = avg_bw;
-
-    double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
-                          doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
-    calculated_["total_energy"] = total_energy;
-    calculated_["average_power"] = total_energy / counters_["num_cycles"];
-    // calculated_["average_read_latency"] = GetHistoAvg("read_latency");
-    calculated_["average_read_latency"] =
-        GetHistoAvg(histo_counts_.at("read_latency"));
-    calculated_["average_interarrival"] =
-        GetHistoAvg(histo_counts_.at("interarrival_latency"));
-
-    UpdatePrints(false);
-    return;
+    double pd_energy = 0.0;
+    double saved = 0.0;
+    for (int i = 0; i < config_.ranks; i++) {
+        double pd_cycles = Counter("pd_cycles", epoch, i);
+        double sref_cycles = Counter("sref_cycles", epoch, i);
+        Double("pd_energy", i) = pd_cycles * config_.pre_pd_energy_inc;
+        pd_energy += Double("pd_energy", i);
+        saved += pd_cycles *
+                     (config_.pre_stb_energy_inc - config_.pre_pd_energy_inc) +
+                 sref_cycles *
+                     (config_.pre_stb_energy_inc - config_.sref_energy_inc);
+    }
+    Double("lowpower_energy_saved") = saved;
+    return pd_energy;
 }
 
-}  // namespace dramsim3
\ No newline at end of file
+}  // namespace dramsim3
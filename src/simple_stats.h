@@ -2,33 +2,126 @@
 #define __SIMPLE_STATS_
 
 #include <fstream>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "configuration.h"
-#include "json.hpp"
 
 namespace dramsim3 {
 
+// Names, descriptions and layout of the stats of a channel. It only depends
+// on the shape of the config, so all channels (and all memory systems) of
+// the same shape share one, built the first time it is asked for. Channels
+// keep nothing but the values, in flat arrays at the slots given here.
+class StatsSchema {
+   public:
+    enum class Type {
+        COUNTER,
+        DOUBLE,
+        CALCULATED,
+        VEC_COUNTER,
+        VEC_DOUBLE,
+        HISTO
+    };
+    struct Stat {
+        std::string name;
+        Type type;
+        // first slot in the counters (counters, vec counters), doubles
+        // (doubles, calculated, vec doubles) or histograms
+        int offset;
+        int length;  // elements of a vector, bins of a histogram incl. ends
+        // printed names and their descriptions start here in Headers()
+        int header_offset;
+        int start_val;  // histograms only
+        int end_val;
+        int bin_width;
+    };
+    // Where a key of a JSON record takes its value from. The fields are
+    // sorted by key, the way nlohmann::json orders objects, so that records
+    // can be written straight from the flat values and read the same.
+    enum class Field {
+        CHANNEL,
+        EPOCH_NUM,  // overall, not of the epoch
+        COUNTER,
+        VEC_COUNTER,
+        HISTO_BIN,
+        HISTO,  // all values counted, final record only
+        DOUBLE,
+        VEC_DOUBLE
+    };
+    struct JsonField {
+        std::string key;  // quoted, with the colon
+        Field field;
+        int offset;  // slot, or histogram
+        int index;   // bin of a histogram
+        // element slots of a vector in the order of their keys, and the keys
+        std::vector<std::pair<int, std::string> > elements;
+    };
+
+    explicit StatsSchema(const Config& config);
+    static const StatsSchema& Get(const Config& config);
+
+    const std::vector<Stat>& Stats() const { return stats_; }
+    const Stat& GetStat(const std::string& name) const;
+    const std::vector<std::string>& Headers() const { return headers_; }
+    const std::vector<std::string>& Descriptions() const { return descs_; }
+    const std::vector<JsonField>& JsonFields() const { return json_fields_; }
+    int NumCounters() const { return num_counters_; }
+    int NumDoubles() const { return num_doubles_; }
+    int NumHistos() const { return num_histos_; }
+
+   private:
+    std::vector<Stat> stats_;
+    std::unordered_map<std::string, int> ids_;
+    std::vector<std::string> headers_;
+    std::vector<std::string> descs_;
+    std::vector<JsonField> json_fields_;
+    int num_counters_;
+    int num_doubles_;
+    int num_histos_;
+
+    void InitStat(std::string name, std::string stat_type,
+                  std::string description);
+    void InitVecStat(std::string name, std::string stat_type,
+                     std::string description, std::string part_name,
+                     int vec_len);
+    void InitHistoStat(std::string name, std::string description, int start_val,
+                       int end_val, int num_bins);
+    void InitJsonFields();
+};
+
 class SimpleStats {
    public:
+    using HistoCount = std::unordered_map<int, uint64_t>;
+
     SimpleStats(const Config& config, int channel_id);
     // incrementing counter
-    void Increment(const std::string name) { epoch_counters_[name] += 1; }
+    void Increment(const std::string& name) {
+        epoch_counters_[schema_.GetStat(name).offset] += 1;
+    }
+
+    // increment counter by number
+    void IncrementBy(const std::string& name, int num) {
+        epoch_counters_[schema_.GetStat(name).offset] += num;
+    }
 
     // incrementing for vec counter
-    void IncrementVec(const std::string name, int pos) {
-        epoch_vec_counters_[name][pos] += 1;
+    void IncrementVec(const std::string& name, int pos) {
+        epoch_counters_[schema_.GetStat(name).offset + pos] += 1;
     }
 
     // increment vec counter by number
-    void IncrementVecBy(const std::string name, int pos, int num) {
-        epoch_vec_counters_[name][pos] += num;
+    void IncrementVecBy(const std::string& name, int pos, int num) {
+        epoch_counters_[schema_.GetStat(name).offset + pos] += num;
     }
 
     // add historgram value
-    void AddValue(const std::string name, const int value);
+    void AddValue(const std::string& name, const int value) {
+        epoch_histo_counts_[schema_.GetStat(name).offset][value] += 1;
+    }
 
     // Epoch update
     void PrintEpochStats();
@@ -39,64 +132,78 @@ class SimpleStats {
     // Reset (usually after one phase of simulation)
     void Reset();
 
-   private:
-    using VecStat = std::unordered_map<std::string, std::vector<uint64_t> >;
-    using HistoCount = std::unordered_map<int, uint64_t>;
-    using Json = nlohmann::json;
-    void InitStat(std::string name, std::string stat_type,
-                  std::string description);
-    void InitVecStat(std::string name, std::string stat_type,
-                     std::string description, std::string part_name,
-                     int vec_len);
-    void InitHistoStat(std::string name, std::string description, int start_val,
-                       int end_val, int num_bins);
+    // values last printed, of the last epoch or of the whole run, for
+    // summing up channels after they printed
+    uint64_t PrintedCounter(const std::string& name, bool epoch,
+                            int pos = 0) const {
+        const auto& counters = epoch ? printed_epoch_counters_ : counters_;
+        return counters[schema_.GetStat(name).offset + pos];
+    }
+    double PrintedDouble(const std::string& name, int pos = 0) const {
+        return doubles_[schema_.GetStat(name).offset + pos];
+    }
+    const HistoCount& PrintedHisto(const std::string& name, bool epoch) const {
+        const auto& counts =
+            epoch ? printed_epoch_histo_counts_ : histo_counts_;
+        return counts[schema_.GetStat(name).offset];
+    }
 
+   private:
     void UpdateCounters();
     void UpdateHistoBins();
-    void UpdatePrints(bool epoch);
+    bool Changed(const StatsSchema::JsonField& field) const;
+    void WriteJson(bool epoch);
+    void PrintText(std::ostream& where, bool epoch) const;
     double GetHistoAvg(const HistoCount& histo_counts) const;
     std::string GetTextHeader(bool is_final) const;
-    void UpdateEpochStats();
-    void UpdateFinalStats();
+    void UpdateStats(bool epoch);
+    void UpdateBankEnergy(bool epoch);
+    void UpdateEfficiency(bool epoch, double total_energy, double total_time);
+    double UpdateRowCloneStats(bool epoch, double total_time);
+    double UpdateLowPowerStats(bool epoch);
+
+    // values by name, of the epoch or overall for counters
+    uint64_t Counter(const std::string& name, bool epoch, int pos = 0) const {
+        const auto& counters = epoch ? epoch_counters_ : counters_;
+        return counters[schema_.GetStat(name).offset + pos];
+    }
+    double& Double(const std::string& name, int pos = 0) {
+        return doubles_[schema_.GetStat(name).offset + pos];
+    }
+    const HistoCount& Histo(const std::string& name, bool epoch) const {
+        const auto& counts = epoch ? epoch_histo_counts_ : histo_counts_;
+        return counts[schema_.GetStat(name).offset];
+    }
 
     const Config& config_;
+    const StatsSchema& schema_;
     int channel_id_;
 
-    // map names to descriptions
-    std::unordered_map<std::string, std::string> header_descs_;
-
-    // counter stats, indexed by their name
-    std::unordered_map<std::string, uint64_t> counters_;
-    std::unordered_map<std::string, uint64_t> epoch_counters_;
-
-    // vectored counter stats, first indexed by name then by index
-    VecStat vec_counters_;
-    VecStat epoch_vec_counters_;
+    // counter and vectored counter stats, overall and of this epoch
+    std::vector<uint64_t> counters_;
+    std::vector<uint64_t> epoch_counters_;
+    std::vector<uint64_t> printed_epoch_counters_;
 
-    // NOTE: doubles_ vec_doubles_ and calculated_ are basically one time
+    // NOTE: doubles, vec doubles and calculated stats are basically one time
     // placeholders after each epoch they store the value for that epoch
     // (different from the counters) and in the end updated to the overall value
-    std::unordered_map<std::string, double> doubles_;
-
-    std::unordered_map<std::string, std::vector<double> > vec_doubles_;
-
-    // calculated stats, similar to double, but not the same
-    std::unordered_map<std::string, double> calculated_;
-
-    // histogram stats
-    std::unordered_map<std::string, std::vector<std::string> > histo_headers_;
-
-    std::unordered_map<std::string, std::pair<int, int> > histo_bounds_;
-    std::unordered_map<std::string, int> bin_widths_;
-    std::unordered_map<std::string, HistoCount> histo_counts_;
-    std::unordered_map<std::string, HistoCount> epoch_histo_counts_;
-    VecStat histo_bins_;
-    VecStat epoch_histo_bins_;
-
-    // outputs
-    Json j_data_;
-    std::vector<std::pair<std::string, std::string> > print_pairs_;
+    std::vector<double> doubles_;
+
+    // histogram stats, the raw values counted and the binned counts
+    std::vector<HistoCount> histo_counts_;
+    std::vector<HistoCount> epoch_histo_counts_;
+    std::vector<HistoCount> printed_epoch_histo_counts_;
+    std::vector<std::vector<uint64_t> > histo_bins_;
+    std::vector<std::vector<uint64_t> > epoch_histo_bins_;
+
+    // JSON record being written, its capacity kept from record to record
+    std::string json_buf_;
+    // with epoch_delta, values of the last epoch record to compare against,
+    // once there is one since the start or the last reset
+    bool delta_base_;
+    std::vector<double> last_doubles_;
+    std::vector<std::vector<uint64_t> > last_epoch_bins_;
 };
 
 }  // namespace dramsim3
-#endif
\ No newline at end of file
+#endif
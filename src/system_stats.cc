@@ -0,0 +1,170 @@
+#include "system_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "fmt/format.h"
+
+namespace dramsim3 {
+
+SystemStats::SystemStats(const Config& config)
+    : config_(config),
+      num_epochs_(0),
+      has_peak_(false),
+      peak_bandwidth_(0.0) {}
+
+void SystemStats::Reset() {
+    // epochs already written stay in the epoch file
+    has_peak_ = false;
+    peak_bandwidth_ = 0.0;
+}
+
+SystemStats::Stats SystemStats::Aggregate(
+    const std::vector<const SimpleStats*>& channels, bool epoch,
+    std::map<int, uint64_t>& read_latency, std::vector<double>& utilization) {
+    uint64_t num_cycles = channels[0]->PrintedCounter("num_cycles", epoch);
+    uint64_t reads = 0, writes = 0;
+    double bandwidth = 0.0, energy = 0.0, power = 0.0;
+    for (auto stats : channels) {
+        reads += stats->PrintedCounter("num_reads_done", epoch);
+        writes += stats->PrintedCounter("num_writes_done", epoch);
+        bandwidth += stats->PrintedDouble("average_bandwidth");
+        energy += stats->PrintedDouble("total_energy");
+        power += stats->PrintedDouble("average_power");
+        for (const auto& it : stats->PrintedHisto("read_latency", epoch)) {
+            read_latency[it.first] += it.second;
+        }
+        // fraction of the cycles the data bus is busy
+        uint64_t bursts = stats->PrintedCounter("num_read_cmds", epoch) +
+                          stats->PrintedCounter("num_write_cmds", epoch);
+        utilization.push_back(
+            num_cycles == 0
+                ? 0.0
+                : static_cast<double>(bursts * config_.burst_cycle) /
+                      num_cycles);
+    }
+    if (epoch) {
+        has_peak_ = true;
+        peak_bandwidth_ = std::max(peak_bandwidth_, bandwidth);
+    }
+
+    uint64_t latency_count = 0, latency_sum = 0;
+    for (const auto& it : read_latency) {
+        latency_count += it.second;
+        latency_sum += it.first * it.second;
+    }
+    double avg_latency =
+        latency_count == 0
+            ? 0.0
+            : static_cast<double>(latency_sum) / latency_count;
+
+    double max_util = 0.0, sum_util = 0.0;
+    for (auto util : utilization) {
+        max_util = std::max(max_util, util);
+        sum_util += util;
+    }
+    double mean_util = sum_util / utilization.size();
+    double var_util = 0.0;
+    for (auto util : utilization) {
+        var_util += (util - mean_util) * (util - mean_util);
+    }
+    var_util /= utilization.size();
+    double imbalance = mean_util == 0.0 ? 0.0 : max_util / mean_util;
+    double cv = mean_util == 0.0 ? 0.0 : std::sqrt(var_util) / mean_util;
+
+    Stats stats = {
+        {"num_cycles", num_cycles},
+        {"num_reads_done", reads},
+        {"num_writes_done", writes},
+        {"total_bandwidth", bandwidth},
+        {"total_energy", energy},
+        {"average_power", power},
+        {"average_read_latency", avg_latency},
+        {"read_latency_p50", HistoPercentile(read_latency, latency_count, 0.5)},
+        {"read_latency_p90", HistoPercentile(read_latency, latency_count, 0.9)},
+        {"read_latency_p99",
+         HistoPercentile(read_latency, latency_count, 0.99)},
+        {"mean_channel_utilization", mean_util},
+        {"max_channel_utilization", max_util},
+        {"channel_imbalance", imbalance},
+        {"channel_utilization_cv", cv}};
+    // there is no peak without epochs, e.g. in runs shorter than one
+    if (has_peak_) {
+        stats.insert(stats.begin() + 4,
+                     std::make_pair("peak_epoch_bandwidth", peak_bandwidth_));
+    }
+    return stats;
+}
+
+void SystemStats::PrintText(std::ostream& where, const Stats& stats,
+                            const std::string& title) const {
+    where << "###########################################\n"
+          << "## " << title << "\n"
+          << "###########################################\n";
+    for (const auto& it : stats) {
+        where << fmt::format("{:<30}{:^3}{:>12}", it.first, " = ", it.second)
+              << std::endl;
+    }
+}
+
+void SystemStats::PrintEpochStats(
+    const std::vector<const SimpleStats*>& channels) {
+    std::map<int, uint64_t> read_latency;
+    std::vector<double> utilization;
+    Stats stats = Aggregate(channels, true, read_latency, utilization);
+    if (config_.output_level < 1) {
+        return;
+    }
+
+    uint64_t epoch_num = channels[0]->PrintedCounter("epoch_num", false);
+    nlohmann::json j_data;
+    j_data["epoch_num"] = epoch_num;
+    for (const auto& it : stats) {
+        j_data[it.first] = it.second;
+    }
+    // the file is a list of epochs, closed by PrintFinalStats
+    auto perm = num_epochs_ == 0 ? std::ofstream::out : std::ofstream::app;
+    std::ofstream j_out(config_.json_system_epoch_name, perm);
+    j_out << (num_epochs_ == 0 ? "[" : ",\n") << j_data;
+    num_epochs_++;
+
+    if (config_.output_level >= 2) {
+        PrintText(std::cout, stats,
+                  "Statistics of System of epoch " + std::to_string(epoch_num));
+    }
+}
+
+void SystemStats::PrintFinalStats(
+    const std::vector<const SimpleStats*>& channels) {
+    std::map<int, uint64_t> read_latency;
+    std::vector<double> utilization;
+    Stats stats = Aggregate(channels, false, read_latency, utilization);
+
+    if (config_.output_level >= 1) {
+        std::ofstream j_out(config_.json_system_epoch_name,
+                            num_epochs_ == 0 ? std::ofstream::out
+                                             : std::ofstream::app);
+        j_out << (num_epochs_ == 0 ? "[" : "") << "]";
+        std::ofstream txt_out(config_.txt_stats_name, std::ofstream::app);
+        PrintText(txt_out, stats, "Statistics of System");
+    }
+
+    if (config_.output_level >= 0) {
+        nlohmann::json j_data;
+        for (const auto& it : stats) {
+            j_data[it.first] = it.second;
+        }
+        for (size_t i = 0; i < utilization.size(); i++) {
+            j_data["channel_utilization"][std::to_string(i)] = utilization[i];
+        }
+        for (const auto& it : read_latency) {
+            j_data["read_latency"][std::to_string(it.first)] = it.second;
+        }
+        std::ofstream j_out(config_.json_system_name);
+        j_out << j_data;
+    }
+}
+
+}  // namespace dramsim3
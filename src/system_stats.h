@@ -0,0 +1,45 @@
+#ifndef __SYSTEM_STATS_H
+#define __SYSTEM_STATS_H
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "configuration.h"
+#include "json.hpp"
+#include "simple_stats.h"
+
+namespace dramsim3 {
+
+// Totals over all channels of a memory system, and how evenly the traffic is
+// spread over them. A few busy channels next to idle ones is usually the
+// address mapping interleaving poorly for the workload.
+class SystemStats {
+   public:
+    explicit SystemStats(const Config& config);
+    // the channels must have printed the same epoch, or their final stats,
+    // right before
+    void PrintEpochStats(const std::vector<const SimpleStats*>& channels);
+    void PrintFinalStats(const std::vector<const SimpleStats*>& channels);
+    void Reset();
+
+   private:
+    using Stats = std::vector<std::pair<std::string, double> >;
+
+    const Config& config_;
+    int num_epochs_;
+    // of all epochs since the start or the last reset, if there were any
+    bool has_peak_;
+    double peak_bandwidth_;
+
+    Stats Aggregate(const std::vector<const SimpleStats*>& channels, bool epoch,
+                    std::map<int, uint64_t>& read_latency,
+                    std::vector<double>& utilization);
+    void PrintText(std::ostream& where, const Stats& stats,
+                   const std::string& title) const;
+};
+
+}  // namespace dramsim3
+#endif
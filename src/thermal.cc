@@ -494,6 +494,9 @@ void ThermalCalculator::UpdateCMDPower(const int channel, const Command &cmd,
             case CommandType::ACTIVATE:
                 energy = config_.act_energy_inc;
                 break;
+            case CommandType::ROW_CLONE:
+                energy = config_.row_clone_energy_inc;
+                break;
             case CommandType::READ:
             case CommandType::READ_PRECHARGE:
                 energy = config_.read_energy_inc;
@@ -6,28 +6,22 @@ namespace dramsim3 {
 
 Timing::Timing(const Config& config)
     : same_bank(static_cast<int>(CommandType::SIZE)),
+      same_subarray(static_cast<int>(CommandType::SIZE)),
       other_banks_same_bankgroup(static_cast<int>(CommandType::SIZE)),
       other_bankgroups_same_rank(static_cast<int>(CommandType::SIZE)),
-      other_ranks(static_cast<int>(CommandType::SIZE)),
       same_rank(static_cast<int>(CommandType::SIZE)) {
     int read_to_read_l = std::max(config.burst_cycle, config.tCCD_L);
     int read_to_read_s = std::max(config.burst_cycle, config.tCCD_S);
-    int read_to_read_o = config.burst_cycle + config.tRTRS;
     int read_to_write = config.RL + config.burst_cycle - config.WL +
                         config.tRTRS;
-    int read_to_write_o = config.read_delay + config.burst_cycle +
-                          config.tRTRS - config.write_delay;
     int read_to_precharge = config.AL + config.tRTP;
     int readp_to_act =
         config.AL + config.burst_cycle + config.tRTP + config.tRP;
 
     int write_to_read_l = config.write_delay + config.tWTR_L;
     int write_to_read_s = config.write_delay + config.tWTR_S;
-    int write_to_read_o = config.write_delay + config.burst_cycle +
-                          config.tRTRS - config.read_delay;
-    int write_to_write_l = std::max(config.burst_cycle, config.tCCD_L);
+    int write_to_write_l = std::max(config.burst_cycle, config.tCCD_L_WR);
     int write_to_write_s = std::max(config.burst_cycle, config.tCCD_S);
-    int write_to_write_o = config.burst_cycle;
     int write_to_precharge = config.WL + config.burst_cycle + config.tWR;
 
     int precharge_to_activate = config.tRP;
@@ -55,11 +49,15 @@ Timing::Timing(const Config& config)
         config.tREFI;  // refresh intervals (per rank level)
     int refresh_to_activate = config.tRFC;  // tRFC is defined as ref to act
     int refresh_to_activate_bank = config.tRFCb;
+    int refresh_sb_to_activate = config.tRFCsb;
+    int refresh_sb_to_other_banks = config.tREFSBRD;
+
+    int clone_to_activate = config.tCLONE + config.tRP;
 
     int self_refresh_entry_to_exit = config.tCKESR;
     int self_refresh_exit = config.tXS;
-    // int powerdown_to_exit = config.tCKE;
-    // int powerdown_exit = config.tXP;
+    int powerdown_to_exit = config.tCKE;
+    int powerdown_exit = config.tXP;
 
     if (config.bankgroups == 1) {
         // for a bankgroup can be disabled, in that case
@@ -93,12 +91,6 @@ Timing::Timing(const Config& config)
             {CommandType::WRITE, read_to_write},
             {CommandType::READ_PRECHARGE, read_to_read_s},
             {CommandType::WRITE_PRECHARGE, read_to_write}};
-    other_ranks[static_cast<int>(CommandType::READ)] =
-        std::vector<std::pair<CommandType, int> >{
-            {CommandType::READ, read_to_read_o},
-            {CommandType::WRITE, read_to_write_o},
-            {CommandType::READ_PRECHARGE, read_to_read_o},
-            {CommandType::WRITE_PRECHARGE, read_to_write_o}};
 
     // command WRITE
     same_bank[static_cast<int>(CommandType::WRITE)] =
@@ -120,12 +112,6 @@ Timing::Timing(const Config& config)
             {CommandType::WRITE, write_to_write_s},
             {CommandType::READ_PRECHARGE, write_to_read_s},
             {CommandType::WRITE_PRECHARGE, write_to_write_s}};
-    other_ranks[static_cast<int>(CommandType::WRITE)] =
-        std::vector<std::pair<CommandType, int> >{
-            {CommandType::READ, write_to_read_o},
-            {CommandType::WRITE, write_to_write_o},
-            {CommandType::READ_PRECHARGE, write_to_read_o},
-            {CommandType::WRITE_PRECHARGE, write_to_write_o}};
 
     // command READ_PRECHARGE
     same_bank[static_cast<int>(CommandType::READ_PRECHARGE)] =
@@ -133,6 +119,7 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, readp_to_act},
             {CommandType::REFRESH, read_to_activate},
             {CommandType::REFRESH_BANK, read_to_activate},
+            {CommandType::REFRESH_SAME_BANK, read_to_activate},
             {CommandType::SREF_ENTER, read_to_activate}};
     other_banks_same_bankgroup[static_cast<int>(CommandType::READ_PRECHARGE)] =
         std::vector<std::pair<CommandType, int> >{
@@ -146,12 +133,6 @@ Timing::Timing(const Config& config)
             {CommandType::WRITE, read_to_write},
             {CommandType::READ_PRECHARGE, read_to_read_s},
             {CommandType::WRITE_PRECHARGE, read_to_write}};
-    other_ranks[static_cast<int>(CommandType::READ_PRECHARGE)] =
-        std::vector<std::pair<CommandType, int> >{
-            {CommandType::READ, read_to_read_o},
-            {CommandType::WRITE, read_to_write_o},
-            {CommandType::READ_PRECHARGE, read_to_read_o},
-            {CommandType::WRITE_PRECHARGE, read_to_write_o}};
 
     // command WRITE_PRECHARGE
     same_bank[static_cast<int>(CommandType::WRITE_PRECHARGE)] =
@@ -159,6 +140,7 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, write_to_activate},
             {CommandType::REFRESH, write_to_activate},
             {CommandType::REFRESH_BANK, write_to_activate},
+            {CommandType::REFRESH_SAME_BANK, write_to_activate},
             {CommandType::SREF_ENTER, write_to_activate}};
     other_banks_same_bankgroup[static_cast<int>(CommandType::WRITE_PRECHARGE)] =
         std::vector<std::pair<CommandType, int> >{
@@ -172,12 +154,6 @@ Timing::Timing(const Config& config)
             {CommandType::WRITE, write_to_write_s},
             {CommandType::READ_PRECHARGE, write_to_read_s},
             {CommandType::WRITE_PRECHARGE, write_to_write_s}};
-    other_ranks[static_cast<int>(CommandType::WRITE_PRECHARGE)] =
-        std::vector<std::pair<CommandType, int> >{
-            {CommandType::READ, write_to_read_o},
-            {CommandType::WRITE, write_to_write_o},
-            {CommandType::READ_PRECHARGE, write_to_read_o},
-            {CommandType::WRITE_PRECHARGE, write_to_write_o}};
 
     // command ACTIVATE
     same_bank[static_cast<int>(CommandType::ACTIVATE)] =
@@ -206,6 +182,7 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, precharge_to_activate},
             {CommandType::REFRESH, precharge_to_activate},
             {CommandType::REFRESH_BANK, precharge_to_activate},
+            {CommandType::REFRESH_SAME_BANK, precharge_to_activate},
             {CommandType::SREF_ENTER, precharge_to_activate}};
 
     // for those who need tPPD
@@ -222,7 +199,7 @@ Timing::Timing(const Config& config)
     }
 
     // command REFRESH_BANK
-    same_rank[static_cast<int>(CommandType::REFRESH_BANK)] =
+    same_bank[static_cast<int>(CommandType::REFRESH_BANK)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::ACTIVATE, refresh_to_activate_bank},
             {CommandType::REFRESH, refresh_to_activate_bank},
@@ -241,16 +218,31 @@ Timing::Timing(const Config& config)
             {CommandType::REFRESH_BANK, refresh_to_refresh},
         };
 
+    // command REFRESH_SAME_BANK, the refreshed bank in every bankgroup uses
+    // same_bank and all the other banks of the rank use other_banks_*
+    same_bank[static_cast<int>(CommandType::REFRESH_SAME_BANK)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, refresh_sb_to_activate},
+            {CommandType::REFRESH, refresh_sb_to_activate},
+            {CommandType::REFRESH_SAME_BANK, refresh_sb_to_activate},
+            {CommandType::SREF_ENTER, refresh_sb_to_activate}};
+
+    other_banks_same_bankgroup[static_cast<int>(
+        CommandType::REFRESH_SAME_BANK)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, refresh_sb_to_other_banks},
+            {CommandType::REFRESH_SAME_BANK, refresh_sb_to_other_banks}};
+
     // REFRESH, SREF_ENTER and SREF_EXIT are isued to the entire
     // rank  command REFRESH
     same_rank[static_cast<int>(CommandType::REFRESH)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::ACTIVATE, refresh_to_activate},
             {CommandType::REFRESH, refresh_to_activate},
+            {CommandType::REFRESH_SAME_BANK, refresh_to_activate},
             {CommandType::SREF_ENTER, refresh_to_activate}};
 
     // command SREF_ENTER
-    // TODO: add power down commands
     same_rank[static_cast<int>(CommandType::SREF_ENTER)] =
         std::vector<std::pair<CommandType, int> >{
             {CommandType::SREF_EXIT, self_refresh_entry_to_exit}};
@@ -261,7 +253,106 @@ Timing::Timing(const Config& config)
             {CommandType::ACTIVATE, self_refresh_exit},
             {CommandType::REFRESH, self_refresh_exit},
             {CommandType::REFRESH_BANK, self_refresh_exit},
+            {CommandType::REFRESH_SAME_BANK, self_refresh_exit},
             {CommandType::SREF_ENTER, self_refresh_exit}};
+
+    // command PD_ENTER
+    same_rank[static_cast<int>(CommandType::PD_ENTER)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::PD_EXIT, powerdown_to_exit}};
+
+    // command PD_EXIT
+    same_rank[static_cast<int>(CommandType::PD_EXIT)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, powerdown_exit},
+            {CommandType::REFRESH, powerdown_exit},
+            {CommandType::REFRESH_BANK, powerdown_exit},
+            {CommandType::REFRESH_SAME_BANK, powerdown_exit},
+            {CommandType::SREF_ENTER, powerdown_exit}};
+
+    // a row clone starts with an ACT, so it waits on everything an ACT
+    // waits on
+    for (auto table : {&same_bank, &other_banks_same_bankgroup,
+                       &other_bankgroups_same_rank, &same_rank}) {
+        for (auto& cmd_timings : *table) {
+            for (size_t i = 0; i < cmd_timings.size(); i++) {
+                if (cmd_timings[i].first == CommandType::ACTIVATE) {
+                    cmd_timings.emplace_back(CommandType::ROW_CLONE,
+                                             cmd_timings[i].second);
+                }
+            }
+        }
+    }
+
+    // command ROW_CLONE, the bank is precharged again when it is done
+    same_bank[static_cast<int>(CommandType::ROW_CLONE)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, clone_to_activate},
+            {CommandType::ROW_CLONE, clone_to_activate},
+            {CommandType::REFRESH, clone_to_activate},
+            {CommandType::REFRESH_BANK, clone_to_activate},
+            {CommandType::REFRESH_SAME_BANK, clone_to_activate},
+            {CommandType::SREF_ENTER, clone_to_activate}};
+    other_banks_same_bankgroup[static_cast<int>(CommandType::ROW_CLONE)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, activate_to_activate_l},
+            {CommandType::ROW_CLONE, activate_to_activate_l},
+            {CommandType::REFRESH_BANK, activate_to_refresh}};
+    other_bankgroups_same_rank[static_cast<int>(CommandType::ROW_CLONE)] =
+        std::vector<std::pair<CommandType, int> >{
+            {CommandType::ACTIVATE, activate_to_activate_s},
+            {CommandType::ROW_CLONE, activate_to_activate_s},
+            {CommandType::REFRESH_BANK, activate_to_refresh}};
+
+    // precharge power-down is entered under the same conditions as self
+    // refresh
+    for (auto table : {&same_bank, &other_banks_same_bankgroup,
+                       &other_bankgroups_same_rank, &same_rank}) {
+        for (auto& cmd_timings : *table) {
+            for (size_t i = 0; i < cmd_timings.size(); i++) {
+                if (cmd_timings[i].first == CommandType::SREF_ENTER) {
+                    cmd_timings.emplace_back(CommandType::PD_ENTER,
+                                             cmd_timings[i].second);
+                }
+            }
+        }
+    }
+
+    if (config.salp != SALPMode::NONE) {
+        // every subarray has its own row buffer, so the timings between
+        // ACT/PRE and the commands to the same row only hold within a
+        // subarray. Column to column timings are for the whole bank, and
+        // so is everything to or from a bank wide command
+        auto is_column = [](CommandType type) {
+            return type == CommandType::READ || type == CommandType::WRITE ||
+                   type == CommandType::READ_PRECHARGE ||
+                   type == CommandType::WRITE_PRECHARGE;
+        };
+        auto is_row = [](CommandType type) {
+            return type == CommandType::ACTIVATE ||
+                   type == CommandType::PRECHARGE;
+        };
+        for (int i = 0; i < static_cast<int>(CommandType::SIZE); i++) {
+            auto type = static_cast<CommandType>(i);
+            if (!is_column(type) && !is_row(type)) {
+                continue;
+            }
+            std::vector<std::pair<CommandType, int> > bank_wide;
+            for (const auto& cmd_timing : same_bank[i]) {
+                auto target = cmd_timing.first;
+                if (is_row(target) || (is_column(target) && is_row(type))) {
+                    same_subarray[i].push_back(cmd_timing);
+                } else {
+                    bank_wide.push_back(cmd_timing);
+                }
+            }
+            same_bank[i] = bank_wide;
+        }
+        // activations of different subarrays are spaced like those of
+        // different banks in the bankgroup
+        same_bank[static_cast<int>(CommandType::ACTIVATE)].emplace_back(
+            CommandType::ACTIVATE, activate_to_activate_l);
+    }
 }
 
 }  // namespace dramsim3
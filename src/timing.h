@@ -11,11 +11,15 @@ class Timing {
    public:
     Timing(const Config& config);
     std::vector<std::vector<std::pair<CommandType, int> > > same_bank;
+    // the part of same_bank that only holds within a subarray with SALP,
+    // empty otherwise
+    std::vector<std::vector<std::pair<CommandType, int> > > same_subarray;
     std::vector<std::vector<std::pair<CommandType, int> > >
         other_banks_same_bankgroup;
     std::vector<std::vector<std::pair<CommandType, int> > >
         other_bankgroups_same_rank;
-    std::vector<std::vector<std::pair<CommandType, int> > > other_ranks;
+    // there is no table for other ranks, they only share the data bus,
+    // which ChannelState keeps a reservation timeline of
     std::vector<std::vector<std::pair<CommandType, int> > > same_rank;
 };
 
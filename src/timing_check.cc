@@ -0,0 +1,65 @@
+#include <iostream>
+#include "./../ext/headers/args.hxx"
+#include "configuration.h"
+#include "timing_checker.h"
+
+using namespace dramsim3;
+
+int main(int argc, const char **argv) {
+    args::ArgumentParser parser(
+        "DRAM command trace timing checker.",
+        "Examples: \n"
+        "./build/dramsim3check configs/DDR4_8Gb_x8_3200.ini "
+        "dramsim3ch_0cmd.trace\n"
+        "./build/dramsim3check configs/DDR4_8Gb_x8_3200.ini -b "
+        "dramsim3ch_0cmd.bin");
+    args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
+    args::Flag binary_arg(parser, "binary",
+                          "Traces are in binary (CmdTraceRecord) format",
+                          {'b', "binary"});
+    args::ValueFlag<int> max_reports_arg(
+        parser, "max_reports", "Number of violations reported in detail",
+        {'m', "max-reports"}, 20);
+    args::Positional<std::string> config_arg(
+        parser, "config", "The config file the trace was generated with");
+    args::PositionalList<std::string> trace_args(
+        parser, "traces", "Command trace files, one per channel");
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (const args::Help&) {
+        std::cout << parser;
+        return 0;
+    } catch (const args::ParseError& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    std::string config_file = args::get(config_arg);
+    auto trace_files = args::get(trace_args);
+    if (config_file.empty() || trace_files.empty()) {
+        std::cerr << parser;
+        return 1;
+    }
+
+    Config config(config_file, ".");
+    bool is_binary = args::get(binary_arg);
+    int max_reports = args::get(max_reports_arg);
+
+    uint64_t total_violations = 0;
+    for (const auto &trace_file : trace_files) {
+        CmdTraceReader reader(trace_file, is_binary);
+        TimingChecker checker(config, max_reports);
+        uint64_t clk = 0;
+        Command cmd;
+        while (reader.Next(clk, cmd)) {
+            checker.Check(clk, cmd);
+        }
+        checker.Finish(clk);
+        std::cout << "## " << trace_file << std::endl;
+        checker.PrintReport(std::cout);
+        total_violations += checker.NumViolations();
+    }
+    return total_violations == 0 ? 0 : 2;
+}
@@ -0,0 +1,691 @@
+#include "timing_checker.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+
+#include "fmt/format.h"
+
+namespace dramsim3 {
+
+namespace {
+// "never happened", far enough from INT64_MIN that adding timings is safe
+const int64_t kNever = INT64_MIN / 4;
+const size_t kBufferSize = 1 << 22;
+}  // namespace
+
+CmdTraceReader::CmdTraceReader(const std::string& trace_file, bool is_binary)
+    : is_binary_(is_binary),
+      buffer_(kBufferSize),
+      buf_pos_(0),
+      buf_len_(0),
+      line_num_(0) {
+    file_ = fopen(trace_file.c_str(), "rb");
+    if (file_ == nullptr) {
+        std::cerr << "Cannot open command trace " << trace_file << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+CmdTraceReader::~CmdTraceReader() { fclose(file_); }
+
+bool CmdTraceReader::FillBuffer() {
+    // keep the unconsumed tail (a partial line or record) at the front
+    size_t remain = buf_len_ - buf_pos_;
+    memmove(buffer_.data(), buffer_.data() + buf_pos_, remain);
+    buf_pos_ = 0;
+    buf_len_ = remain;
+    size_t num_read =
+        fread(buffer_.data() + buf_len_, 1, buffer_.size() - buf_len_, file_);
+    buf_len_ += num_read;
+    return num_read > 0;
+}
+
+bool CmdTraceReader::Next(uint64_t& clk, Command& cmd) {
+    return is_binary_ ? NextBinary(clk, cmd) : NextText(clk, cmd);
+}
+
+bool CmdTraceReader::NextBinary(uint64_t& clk, Command& cmd) {
+    if (buf_len_ - buf_pos_ < sizeof(CmdTraceRecord)) {
+        FillBuffer();
+        if (buf_len_ - buf_pos_ < sizeof(CmdTraceRecord)) {
+            return false;
+        }
+    }
+    CmdTraceRecord rec;
+    memcpy(&rec, buffer_.data() + buf_pos_, sizeof(rec));
+    buf_pos_ += sizeof(rec);
+    line_num_++;
+    clk = rec.clk;
+    cmd.cmd_type = static_cast<CommandType>(rec.cmd_type);
+    // 0xff marks the -1 fields of rank level commands
+    auto field = [](uint8_t v) { return v == 0xff ? -1 : static_cast<int>(v); };
+    cmd.addr = Address(field(rec.channel), field(rec.rank),
+                       field(rec.bankgroup), field(rec.bank), rec.row,
+                       rec.column);
+    cmd.hex_addr = 0;
+    return true;
+}
+
+bool CmdTraceReader::NextText(uint64_t& clk, Command& cmd) {
+    while (true) {
+        char* begin = buffer_.data() + buf_pos_;
+        char* end = static_cast<char*>(memchr(begin, '\n', buf_len_ - buf_pos_));
+        if (end == nullptr) {
+            bool more = FillBuffer();
+            begin = buffer_.data();
+            end = static_cast<char*>(memchr(begin, '\n', buf_len_));
+            if (end == nullptr) {
+                if (!more && buf_len_ == 0) {
+                    return false;
+                }
+                if (buf_len_ >= buffer_.size()) {
+                    std::cerr << "Command trace line too long" << std::endl;
+                    AbruptExit(__FILE__, __LINE__);
+                }
+                // last line without a newline
+                buffer_[buf_len_] = '\n';
+                end = begin + buf_len_;
+                buf_len_++;
+            }
+        }
+        *end = '\0';
+        buf_pos_ = end - buffer_.data() + 1;
+        line_num_++;
+
+        char* p = begin;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        clk = strtoull(p, &p, 10);
+        while (*p == ' ' || *p == '\t') p++;
+        char* name = p;
+        while (*p != ' ' && *p != '\t' && *p != '\0') p++;
+        size_t name_len = p - name;
+        cmd.cmd_type = CommandType::SIZE;
+        for (int i = 0; i < static_cast<int>(CommandType::SIZE); i++) {
+            const auto& type_name = CommandTypeName(static_cast<CommandType>(i));
+            if (type_name.size() == name_len &&
+                memcmp(type_name.data(), name, name_len) == 0) {
+                cmd.cmd_type = static_cast<CommandType>(i);
+                break;
+            }
+        }
+        if (cmd.cmd_type == CommandType::SIZE) {
+            std::cerr << "Unknown command at line " << line_num_ << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        cmd.addr.channel = static_cast<int>(strtol(p, &p, 10));
+        cmd.addr.rank = static_cast<int>(strtol(p, &p, 10));
+        cmd.addr.bankgroup = static_cast<int>(strtol(p, &p, 10));
+        cmd.addr.bank = static_cast<int>(strtol(p, &p, 10));
+        cmd.addr.row = static_cast<int>(strtol(p, &p, 16));
+        cmd.addr.column = static_cast<int>(strtol(p, &p, 16));
+        cmd.hex_addr = 0;
+        return true;
+    }
+}
+
+TimingChecker::TimingChecker(const Config& config, int max_reports)
+    : config_(config),
+      max_reports_(max_reports),
+      num_cmds_(0),
+      num_violations_(0),
+      history_(kContextSize),
+      history_pos_(0) {
+    burst_ = config_.burst_cycle;
+    if (config_.IsGDDR() || config_.IsHBM()) {
+        rcd_rd_ = config_.tRCDRD;
+        rcd_wr_ = config_.tRCDWR;
+    } else {
+        rcd_rd_ = config_.tRCD - config_.AL;
+        rcd_wr_ = config_.tRCD - config_.AL;
+    }
+    // without bankgroups there is no long variant
+    bool has_bg = config_.bankgroups > 1;
+    rrd_l_ = has_bg ? config_.tRRD_L : config_.tRRD_S;
+    ccd_l_ = has_bg ? config_.tCCD_L : config_.tCCD_S;
+    ccd_l_wr_ = has_bg ? config_.tCCD_L_WR : config_.tCCD_S;
+    wtr_l_ = has_bg ? config_.tWTR_L : config_.tWTR_S;
+    read_to_pre_ = config_.AL + config_.tRTP;
+    write_to_pre_ = config_.WL + burst_ + config_.tWR;
+    readp_to_act_ = read_to_pre_ + config_.tRP;
+    writep_to_act_ = write_to_pre_ + config_.tRP;
+    // JEDEC allows up to 8 refreshes to be postponed
+    ref_limit_ = 9 * config_.tREFI;
+
+    int num_banks = config_.ranks * config_.banks;
+    int num_bgs = config_.ranks * config_.bankgroups;
+    num_subarrays_ = config_.salp == SALPMode::NONE ? 1 : config_.subarrays;
+    int num_row_buffers = num_banks * num_subarrays_;
+    open_.resize(num_row_buffers, false);
+    open_row_.resize(num_row_buffers, -1);
+    last_act_.resize(num_row_buffers, kNever);
+    last_read_.resize(num_row_buffers, kNever);
+    last_write_.resize(num_row_buffers, kNever);
+    precharged_at_.resize(num_row_buffers, kNever);
+    open_subarrays_.resize(num_banks, 0);
+    designated_.resize(num_banks, 0);
+    last_refb_.resize(num_banks, kNever);
+    last_refsb_.resize(num_banks, kNever);
+    bg_last_act_.resize(num_bgs, kNever);
+    bg_last_read_.resize(num_bgs, kNever);
+    bg_last_write_.resize(num_bgs, kNever);
+    rank_last_act_.resize(config_.ranks, kNever);
+    rank_last_read_.resize(config_.ranks, kNever);
+    rank_last_write_.resize(config_.ranks, kNever);
+    rank_last_pre_.resize(config_.ranks, kNever);
+    rank_last_ref_.resize(config_.ranks, kNever);
+    rank_last_refsb_.resize(config_.ranks, kNever);
+    rank_refresh_due_.resize(config_.ranks, ref_limit_);
+    rank_sref_enter_.resize(config_.ranks, kNever);
+    rank_sref_exit_.resize(config_.ranks, kNever);
+    rank_in_sref_.resize(config_.ranks, false);
+    rank_pd_enter_.resize(config_.ranks, kNever);
+    rank_pd_exit_.resize(config_.ranks, kNever);
+    rank_in_pd_.resize(config_.ranks, false);
+    act_window_.resize(config_.ranks);
+    ca_bus_free_.resize(config_.split_ca_bus ? 2 : 1, kNever);
+}
+
+int TimingChecker::BankIndex(const Command& cmd) const {
+    return (cmd.Rank() * config_.bankgroups + cmd.Bankgroup()) *
+               config_.banks_per_group +
+           cmd.Bank();
+}
+
+int TimingChecker::SubarrayIndex(const Command& cmd) const {
+    int subarray = cmd.Row() < 0 ? 0 : config_.SubarrayOf(cmd.Row());
+    return BankIndex(cmd) * num_subarrays_ + subarray;
+}
+
+int64_t TimingChecker::BankLatest(const std::vector<int64_t>& values,
+                                  int b) const {
+    int64_t latest = kNever;
+    for (int s = b * num_subarrays_; s < (b + 1) * num_subarrays_; s++) {
+        latest = std::max(latest, values[s]);
+    }
+    return latest;
+}
+
+int TimingChecker::CABus(const Command& cmd) const {
+    return config_.split_ca_bus && cmd.IsReadWrite() ? 1 : 0;
+}
+
+int TimingChecker::BankgroupIndex(const Command& cmd) const {
+    return cmd.Rank() * config_.bankgroups + cmd.Bankgroup();
+}
+
+void TimingChecker::Require(uint64_t clk, const Command& cmd, int64_t earliest,
+                            const char* rule) {
+    if (static_cast<int64_t>(clk) < earliest) {
+        Violate(clk, cmd, static_cast<uint64_t>(earliest), rule);
+    }
+}
+
+void TimingChecker::Violate(uint64_t clk, const Command& cmd,
+                            uint64_t earliest, const std::string& rule) {
+    num_violations_++;
+    auto it = std::find_if(
+        rule_counts_.begin(), rule_counts_.end(),
+        [&rule](const std::pair<std::string, uint64_t>& p) {
+            return p.first == rule;
+        });
+    if (it == rule_counts_.end()) {
+        rule_counts_.emplace_back(rule, 1);
+    } else {
+        it->second++;
+    }
+
+    if (static_cast<int>(violations_.size()) < max_reports_) {
+        violations_.push_back({clk, cmd, rule, earliest});
+        std::stringstream context;
+        size_t num_hist = std::min(num_cmds_, static_cast<uint64_t>(kContextSize));
+        for (size_t i = num_hist; i > 0; i--) {
+            const auto& prev =
+                history_[(history_pos_ + kContextSize - i) % kContextSize];
+            context << fmt::format("    {:<18} ", prev.first) << prev.second
+                    << std::endl;
+        }
+        contexts_.push_back(context.str());
+    }
+}
+
+void TimingChecker::Check(uint64_t clk, const Command& cmd) {
+    if (cmd.Rank() < 0 || cmd.Rank() >= config_.ranks) {
+        Violate(clk, cmd, clk, "invalid rank");
+        return;
+    }
+    if (config_.ca_bus_model) {
+        Require(clk, cmd, ca_bus_free_[CABus(cmd)], "command bus occupied");
+    }
+    switch (cmd.cmd_type) {
+        case CommandType::ACTIVATE:
+        case CommandType::ROW_CLONE:
+            CheckActivate(clk, cmd);
+            break;
+        case CommandType::PRECHARGE:
+            CheckPrecharge(clk, cmd);
+            break;
+        case CommandType::READ:
+        case CommandType::READ_PRECHARGE:
+        case CommandType::WRITE:
+        case CommandType::WRITE_PRECHARGE:
+            CheckReadWrite(clk, cmd);
+            break;
+        case CommandType::REFRESH:
+        case CommandType::REFRESH_BANK:
+        case CommandType::REFRESH_SAME_BANK:
+            CheckRefresh(clk, cmd);
+            break;
+        case CommandType::SREF_ENTER:
+        case CommandType::SREF_EXIT:
+            CheckSelfRefresh(clk, cmd);
+            break;
+        case CommandType::PD_ENTER:
+        case CommandType::PD_EXIT:
+            CheckPowerDown(clk, cmd);
+            break;
+        default:
+            Violate(clk, cmd, clk, "unknown command");
+            return;
+    }
+    Update(clk, cmd);
+
+    history_[history_pos_] = std::make_pair(clk, cmd);
+    history_pos_ = (history_pos_ + 1) % kContextSize;
+    num_cmds_++;
+}
+
+void TimingChecker::CheckActivate(uint64_t clk, const Command& cmd) {
+    int rank = cmd.Rank();
+    int b = BankIndex(cmd);
+    int s = SubarrayIndex(cmd);
+    if (rank_in_sref_[rank]) {
+        Violate(clk, cmd, clk, "ACT in self refresh");
+    }
+    if (rank_in_pd_[rank]) {
+        Violate(clk, cmd, clk, "ACT in power-down");
+    }
+    // SALP2 may have a second subarray activated, MASA any number
+    int max_open = 1;
+    if (config_.salp == SALPMode::SALP2) {
+        max_open = 2;
+    } else if (config_.salp == SALPMode::MASA) {
+        max_open = std::min(config_.masa_subarrays, num_subarrays_);
+    }
+    if (cmd.cmd_type == CommandType::ROW_CLONE) {
+        // it uses the whole bank
+        if (open_subarrays_[b] > 0) {
+            Violate(clk, cmd, clk, "ACT to open bank");
+        }
+        Require(clk, cmd, BankLatest(precharged_at_, b),
+                "tRP (PRE/RDA/WRA to ACT)");
+        Require(clk, cmd, BankLatest(last_act_, b) + config_.tRC, "tRC");
+    } else {
+        if (open_[s] || open_subarrays_[b] >= max_open) {
+            Violate(clk, cmd, clk, "ACT to open bank");
+        }
+        Require(clk, cmd, precharged_at_[s], "tRP (PRE/RDA/WRA to ACT)");
+        Require(clk, cmd, last_act_[s] + config_.tRC, "tRC");
+    }
+    Require(clk, cmd, bg_last_act_[BankgroupIndex(cmd)] + rrd_l_, "tRRD_L");
+    Require(clk, cmd, rank_last_act_[rank] + config_.tRRD_S, "tRRD_S");
+    // a clone activates twice, its second ACT has to fit the windows too
+    const auto& window = act_window_[rank];
+    size_t acts = cmd.cmd_type == CommandType::ROW_CLONE ? 2 : 1;
+    if (window.size() >= 5 - acts) {
+        Require(clk, cmd, window[window.size() - (5 - acts)] + config_.tFAW,
+                "tFAW");
+    }
+    if (config_.IsGDDR() && window.size() >= 33 - acts) {
+        Require(clk, cmd, window[window.size() - (33 - acts)] + config_.t32AW,
+                "t32AW");
+    }
+    Require(clk, cmd, rank_last_ref_[rank] + config_.tRFC, "tRFC");
+    Require(clk, cmd, last_refb_[b] + config_.tRFCb, "tRFCb");
+    Require(clk, cmd, last_refsb_[b] + config_.tRFCsb, "tRFCsb");
+    Require(clk, cmd, rank_last_refsb_[rank] + config_.tREFSBRD, "tREFSBRD");
+    Require(clk, cmd, rank_sref_exit_[rank] + config_.tXS, "tXS");
+    Require(clk, cmd, rank_pd_exit_[rank] + config_.tXP, "tXP");
+}
+
+void TimingChecker::CheckPrecharge(uint64_t clk, const Command& cmd) {
+    int s = SubarrayIndex(cmd);
+    if (!open_[s]) {
+        Violate(clk, cmd, clk, "PRE to closed bank");
+    }
+    Require(clk, cmd, last_act_[s] + config_.tRAS, "tRAS");
+    Require(clk, cmd, last_read_[s] + read_to_pre_, "tRTP");
+    Require(clk, cmd, last_write_[s] + write_to_pre_, "tWR");
+    if (config_.IsGDDR() || config_.protocol == DRAMProtocol::LPDDR4) {
+        Require(clk, cmd, rank_last_pre_[cmd.Rank()] + config_.tPPD, "tPPD");
+    }
+}
+
+void TimingChecker::CheckReadWrite(uint64_t clk, const Command& cmd) {
+    int rank = cmd.Rank();
+    int s = SubarrayIndex(cmd);
+    int bg = BankgroupIndex(cmd);
+    if (rank_in_sref_[rank]) {
+        Violate(clk, cmd, clk, "CAS in self refresh");
+    }
+    if (!open_[s]) {
+        Violate(clk, cmd, clk, "CAS to closed bank");
+    } else if (open_row_[s] != cmd.Row()) {
+        Violate(clk, cmd, clk, "CAS to wrong row");
+    } else if (config_.salp == SALPMode::SALP2 &&
+               designated_[BankIndex(cmd)] != s) {
+        Violate(clk, cmd, clk, "CAS to a subarray activated before the last");
+    }
+
+    if (cmd.IsRead()) {
+        Require(clk, cmd, last_act_[s] + rcd_rd_, "tRCD (read)");
+        Require(clk, cmd, bg_last_read_[bg] + std::max(burst_, ccd_l_),
+                "tCCD_L (read to read)");
+        Require(clk, cmd,
+                rank_last_read_[rank] + std::max(burst_, config_.tCCD_S),
+                "tCCD_S (read to read)");
+        Require(clk, cmd, bg_last_write_[bg] + config_.WL + burst_ + wtr_l_,
+                "tWTR_L");
+        Require(clk, cmd,
+                rank_last_write_[rank] + config_.WL + burst_ + config_.tWTR_S,
+                "tWTR_S");
+    } else {
+        Require(clk, cmd, last_act_[s] + rcd_wr_, "tRCD (write)");
+        Require(clk, cmd, bg_last_write_[bg] + std::max(burst_, ccd_l_wr_),
+                "tCCD_L (write to write)");
+        Require(clk, cmd,
+                rank_last_write_[rank] + std::max(burst_, config_.tCCD_S),
+                "tCCD_S (write to write)");
+        Require(clk, cmd,
+                rank_last_read_[rank] + config_.RL + burst_ - config_.WL +
+                    config_.tRTRS,
+                "read to write turnaround");
+    }
+
+    // data bus sharing across ranks
+    for (int r = 0; r < config_.ranks; r++) {
+        if (r == rank) {
+            continue;
+        }
+        if (cmd.IsRead()) {
+            Require(clk, cmd, rank_last_read_[r] + burst_ + config_.tRTRS,
+                    "tRTRS (read to read, other rank)");
+            Require(clk, cmd,
+                    rank_last_write_[r] + config_.WL + burst_ + config_.tRTRS -
+                        config_.RL,
+                    "tRTRS (write to read, other rank)");
+        } else {
+            Require(clk, cmd,
+                    rank_last_read_[r] + config_.RL + burst_ + config_.tRTRS -
+                        config_.WL,
+                    "tRTRS (read to write, other rank)");
+            Require(clk, cmd, rank_last_write_[r] + burst_ + config_.tODTSW,
+                    "tODTSW (write to write, other rank)");
+        }
+    }
+}
+
+void TimingChecker::CheckRankClosed(uint64_t clk, const Command& cmd) {
+    int first = cmd.Rank() * config_.banks;
+    int64_t precharged = kNever;
+    for (int b = first; b < first + config_.banks; b++) {
+        if (open_subarrays_[b] > 0) {
+            Violate(clk, cmd, clk, "rank command with open bank");
+            break;
+        }
+        precharged = std::max(precharged, BankLatest(precharged_at_, b));
+    }
+    Require(clk, cmd, precharged, "tRP (PRE to rank command)");
+}
+
+void TimingChecker::CheckRefresh(uint64_t clk, const Command& cmd) {
+    int rank = cmd.Rank();
+    if (rank_in_sref_[rank]) {
+        Violate(clk, cmd, clk, "refresh in self refresh");
+    }
+    if (rank_in_pd_[rank]) {
+        Violate(clk, cmd, clk, "refresh in power-down");
+    }
+    Require(clk, cmd, rank_last_ref_[rank] + config_.tRFC, "tRFC");
+    Require(clk, cmd, rank_sref_exit_[rank] + config_.tXS, "tXS");
+    Require(clk, cmd, rank_pd_exit_[rank] + config_.tXP, "tXP");
+    if (cmd.cmd_type == CommandType::REFRESH) {
+        CheckRankClosed(clk, cmd);
+        Require(clk, cmd, rank_last_refsb_[rank] + config_.tRFCsb,
+                "tRFCsb (REFsb to REF)");
+        if (config_.refresh_policy == RefreshPolicy::RANK_LEVEL_STAGGERED ||
+            config_.refresh_policy == RefreshPolicy::RANK_LEVEL_SIMULTANEOUS) {
+            if (static_cast<int64_t>(clk) > rank_refresh_due_[rank]) {
+                Violate(clk, cmd, rank_refresh_due_[rank],
+                        "refresh postponed beyond 8 tREFI");
+            }
+        }
+    } else if (cmd.cmd_type == CommandType::REFRESH_SAME_BANK) {
+        Require(clk, cmd, rank_last_refsb_[rank] + config_.tREFSBRD,
+                "tREFSBRD (REFsb to REFsb)");
+        for (int j = 0; j < config_.bankgroups; j++) {
+            int b = (rank * config_.bankgroups + j) * config_.banks_per_group +
+                    cmd.Bank();
+            if (open_subarrays_[b] > 0) {
+                Violate(clk, cmd, clk, "REFsb to open bank");
+            }
+            Require(clk, cmd, BankLatest(precharged_at_, b),
+                    "tRP (PRE to REFsb)");
+            Require(clk, cmd, last_refsb_[b] + config_.tRFCsb, "tRFCsb");
+        }
+    } else {
+        int b = BankIndex(cmd);
+        if (open_subarrays_[b] > 0) {
+            Violate(clk, cmd, clk, "REFb to open bank");
+        }
+        Require(clk, cmd, BankLatest(precharged_at_, b), "tRP (PRE to REFb)");
+        Require(clk, cmd, last_refb_[b] + config_.tRFCb, "tRFCb");
+    }
+}
+
+void TimingChecker::CheckSelfRefresh(uint64_t clk, const Command& cmd) {
+    int rank = cmd.Rank();
+    if (cmd.cmd_type == CommandType::SREF_ENTER) {
+        if (rank_in_sref_[rank]) {
+            Violate(clk, cmd, clk, "SREF entry while in self refresh");
+        }
+        if (rank_in_pd_[rank]) {
+            Violate(clk, cmd, clk, "SREF entry while in power-down");
+        }
+        CheckRankClosed(clk, cmd);
+        Require(clk, cmd, rank_last_ref_[rank] + config_.tRFC,
+                "tRFC (REF to SREF entry)");
+        Require(clk, cmd, rank_sref_exit_[rank] + config_.tXS,
+                "tXS (SREF exit to entry)");
+        Require(clk, cmd, rank_pd_exit_[rank] + config_.tXP,
+                "tXP (PD exit to SREF entry)");
+    } else {
+        if (!rank_in_sref_[rank]) {
+            Violate(clk, cmd, clk, "SREF exit while not in self refresh");
+        }
+        Require(clk, cmd, rank_sref_enter_[rank] + config_.tCKESR, "tCKESR");
+    }
+}
+
+void TimingChecker::CheckPowerDown(uint64_t clk, const Command& cmd) {
+    int rank = cmd.Rank();
+    if (cmd.cmd_type == CommandType::PD_ENTER) {
+        if (rank_in_pd_[rank] || rank_in_sref_[rank]) {
+            Violate(clk, cmd, clk, "PD entry while in a low power state");
+        }
+        CheckRankClosed(clk, cmd);
+        Require(clk, cmd, rank_last_ref_[rank] + config_.tRFC,
+                "tRFC (REF to PD entry)");
+        Require(clk, cmd, rank_sref_exit_[rank] + config_.tXS,
+                "tXS (SREF exit to PD entry)");
+        Require(clk, cmd, rank_pd_exit_[rank] + config_.tXP,
+                "tXP (PD exit to entry)");
+    } else {
+        if (!rank_in_pd_[rank]) {
+            Violate(clk, cmd, clk, "PD exit while not in power-down");
+        }
+        Require(clk, cmd, rank_pd_enter_[rank] + config_.tCKE, "tCKE");
+    }
+}
+
+void TimingChecker::Update(uint64_t clk, const Command& cmd) {
+    int rank = cmd.Rank();
+    int64_t now = static_cast<int64_t>(clk);
+    if (config_.ca_bus_model) {
+        ca_bus_free_[CABus(cmd)] = now + config_.CommandCycles(cmd.cmd_type);
+    }
+    if (cmd.IsRankCMD()) {
+        switch (cmd.cmd_type) {
+            case CommandType::REFRESH:
+                rank_last_ref_[rank] = now;
+                rank_refresh_due_[rank] = now + ref_limit_;
+                break;
+            case CommandType::SREF_ENTER:
+                rank_in_sref_[rank] = true;
+                rank_sref_enter_[rank] = now;
+                break;
+            case CommandType::SREF_EXIT:
+                rank_in_sref_[rank] = false;
+                rank_sref_exit_[rank] = now;
+                // the device refreshes itself in SREF
+                rank_refresh_due_[rank] = now + ref_limit_;
+                break;
+            case CommandType::PD_ENTER:
+                rank_in_pd_[rank] = true;
+                rank_pd_enter_[rank] = now;
+                break;
+            case CommandType::PD_EXIT:
+                rank_in_pd_[rank] = false;
+                rank_pd_exit_[rank] = now;
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+
+    int b = BankIndex(cmd);
+    int s = SubarrayIndex(cmd);
+    int bg = BankgroupIndex(cmd);
+    // closes the row buffer of subarray s
+    auto close = [&](int64_t precharged_at) {
+        if (open_[s]) {
+            open_[s] = false;
+            open_subarrays_[b]--;
+        }
+        precharged_at_[s] = precharged_at;
+    };
+    switch (cmd.cmd_type) {
+        case CommandType::ACTIVATE: {
+            if (!open_[s]) {
+                open_[s] = true;
+                open_subarrays_[b]++;
+            }
+            open_row_[s] = cmd.Row();
+            designated_[b] = s;
+            last_act_[s] = now;
+            bg_last_act_[bg] = now;
+            rank_last_act_[rank] = now;
+            auto& window = act_window_[rank];
+            if (window.size() >= 32) {
+                window.erase(window.begin());
+            }
+            window.push_back(now);
+            break;
+        }
+        case CommandType::ROW_CLONE: {
+            // ACT, ACT, PRE inside the bank, it is closed again afterwards
+            bg_last_act_[bg] = now;
+            rank_last_act_[rank] = now;
+            auto& window = act_window_[rank];
+            for (int i = 0; i < 2; i++) {
+                if (window.size() >= 32) {
+                    window.erase(window.begin());
+                }
+                window.push_back(now);
+            }
+            for (int i = b * num_subarrays_; i < (b + 1) * num_subarrays_;
+                 i++) {
+                last_act_[i] = now;
+                precharged_at_[i] = now + config_.tCLONE + config_.tRP;
+            }
+            break;
+        }
+        case CommandType::PRECHARGE:
+            close(now + config_.tRP);
+            rank_last_pre_[rank] = now;
+            break;
+        case CommandType::READ:
+        case CommandType::READ_PRECHARGE:
+            last_read_[s] = now;
+            bg_last_read_[bg] = now;
+            rank_last_read_[rank] = now;
+            if (cmd.cmd_type == CommandType::READ_PRECHARGE) {
+                close(now + readp_to_act_);
+            }
+            break;
+        case CommandType::WRITE:
+        case CommandType::WRITE_PRECHARGE:
+            last_write_[s] = now;
+            bg_last_write_[bg] = now;
+            rank_last_write_[rank] = now;
+            if (cmd.cmd_type == CommandType::WRITE_PRECHARGE) {
+                close(now + writep_to_act_);
+            }
+            break;
+        case CommandType::REFRESH_BANK:
+            last_refb_[b] = now;
+            break;
+        case CommandType::REFRESH_SAME_BANK:
+            for (int j = 0; j < config_.bankgroups; j++) {
+                last_refsb_[(rank * config_.bankgroups + j) *
+                                config_.banks_per_group +
+                            cmd.Bank()] = now;
+            }
+            rank_last_refsb_[rank] = now;
+            break;
+        default:
+            break;
+    }
+}
+
+void TimingChecker::Finish(uint64_t last_clk) {
+    // per bank refresh policies are not tracked for postponement
+    if (config_.refresh_policy == RefreshPolicy::BANK_LEVEL_STAGGERED ||
+        config_.refresh_policy == RefreshPolicy::SAME_BANK_STAGGERED) {
+        return;
+    }
+    for (int r = 0; r < config_.ranks; r++) {
+        if (!rank_in_sref_[r] &&
+            static_cast<int64_t>(last_clk) > rank_refresh_due_[r]) {
+            Address addr;
+            addr.rank = r;
+            Violate(last_clk, Command(CommandType::REFRESH, addr, 0),
+                    rank_refresh_due_[r], "refresh postponed beyond 8 tREFI");
+        }
+    }
+}
+
+void TimingChecker::PrintReport(std::ostream& os) const {
+    os << fmt::format("Checked {} commands, {} violations", num_cmds_,
+                      num_violations_)
+       << std::endl;
+    for (const auto& it : rule_counts_) {
+        os << fmt::format("  {:<40} {:>12}", it.first, it.second) << std::endl;
+    }
+    for (size_t i = 0; i < violations_.size(); i++) {
+        const auto& v = violations_[i];
+        os << std::endl
+           << fmt::format("Violation of {} at cycle {} (earliest legal {}):",
+                          v.rule, v.clk, v.earliest)
+           << std::endl;
+        os << contexts_[i];
+        os << fmt::format(" >> {:<18} ", v.clk) << v.cmd << std::endl;
+    }
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,143 @@
+#ifndef __TIMING_CHECKER_H
+#define __TIMING_CHECKER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// Streams a command trace (the text format written by CMD_TRACE builds, or
+// the binary CmdTraceRecord format) one command at a time
+class CmdTraceReader {
+   public:
+    CmdTraceReader(const std::string& trace_file, bool is_binary);
+    ~CmdTraceReader();
+    bool Next(uint64_t& clk, Command& cmd);
+    uint64_t LineNum() const { return line_num_; }
+
+   private:
+    FILE* file_;
+    bool is_binary_;
+    std::vector<char> buffer_;
+    size_t buf_pos_;
+    size_t buf_len_;
+    uint64_t line_num_;
+
+    bool FillBuffer();
+    bool NextText(uint64_t& clk, Command& cmd);
+    bool NextBinary(uint64_t& clk, Command& cmd);
+};
+
+struct TimingViolation {
+    uint64_t clk;
+    Command cmd;
+    std::string rule;
+    // the earliest cycle the command would have been legal
+    uint64_t earliest;
+};
+
+// An independent, deliberately plain implementation of the JEDEC rules that
+// Timing/ChannelState encode, used to verify command traces produced by the
+// simulator. It does not share any timing tables with the simulator, only
+// the raw parameters from Config.
+class TimingChecker {
+   public:
+    TimingChecker(const Config& config, int max_reports);
+    void Check(uint64_t clk, const Command& cmd);
+    // check things that can only be judged at the end of a trace
+    void Finish(uint64_t last_clk);
+    uint64_t NumCommands() const { return num_cmds_; }
+    uint64_t NumViolations() const { return num_violations_; }
+    const std::vector<TimingViolation>& Violations() const {
+        return violations_;
+    }
+    void PrintReport(std::ostream& os) const;
+
+   private:
+    const Config& config_;
+    int max_reports_;
+    uint64_t num_cmds_;
+    uint64_t num_violations_;
+    std::vector<TimingViolation> violations_;
+    std::vector<std::pair<std::string, uint64_t> > rule_counts_;
+
+    // recent commands, printed as context of the first violations
+    static const int kContextSize = 8;
+    std::vector<std::pair<uint64_t, Command> > history_;
+    size_t history_pos_;
+    std::vector<std::string> contexts_;
+
+    // derived parameters
+    int burst_;
+    int rcd_rd_, rcd_wr_;
+    int rrd_l_, ccd_l_, ccd_l_wr_, wtr_l_;
+    int read_to_pre_, write_to_pre_;
+    int readp_to_act_, writep_to_act_;
+    int ref_limit_;
+
+    // per row buffer state, indexed by flat subarray index, there is one
+    // subarray per bank unless SALP is on
+    int num_subarrays_;
+    std::vector<bool> open_;
+    std::vector<int> open_row_;
+    std::vector<int64_t> last_act_;
+    std::vector<int64_t> last_read_;
+    std::vector<int64_t> last_write_;
+    std::vector<int64_t> precharged_at_;  // when the bank finished precharging
+
+    // per bank, indexed by flat bank index
+    std::vector<int> open_subarrays_;
+    std::vector<int> designated_;  // last activated subarray
+    std::vector<int64_t> last_refb_;
+    std::vector<int64_t> last_refsb_;
+
+    // per bankgroup, indexed by rank * bankgroups + bankgroup
+    std::vector<int64_t> bg_last_act_;
+    std::vector<int64_t> bg_last_read_;
+    std::vector<int64_t> bg_last_write_;
+
+    // per rank
+    std::vector<int64_t> rank_last_act_;
+    std::vector<int64_t> rank_last_read_;
+    std::vector<int64_t> rank_last_write_;
+    std::vector<int64_t> rank_last_pre_;
+    std::vector<int64_t> rank_last_ref_;
+    std::vector<int64_t> rank_last_refsb_;
+    std::vector<int64_t> rank_refresh_due_;
+    std::vector<int64_t> rank_sref_enter_;
+    std::vector<int64_t> rank_sref_exit_;
+    std::vector<bool> rank_in_sref_;
+    std::vector<int64_t> rank_pd_enter_;
+    std::vector<int64_t> rank_pd_exit_;
+    std::vector<bool> rank_in_pd_;
+    std::vector<std::vector<int64_t> > act_window_;  // last 32 ACTs per rank
+
+    // first cycle each command bus is free, with ca_bus_model
+    std::vector<int64_t> ca_bus_free_;
+    int CABus(const Command& cmd) const;
+
+    int BankIndex(const Command& cmd) const;
+    int SubarrayIndex(const Command& cmd) const;
+    // latest of values over the subarrays of flat bank b
+    int64_t BankLatest(const std::vector<int64_t>& values, int b) const;
+    int BankgroupIndex(const Command& cmd) const;
+    void Require(uint64_t clk, const Command& cmd, int64_t earliest,
+                 const char* rule);
+    void Violate(uint64_t clk, const Command& cmd, uint64_t earliest,
+                 const std::string& rule);
+    void CheckActivate(uint64_t clk, const Command& cmd);
+    void CheckPrecharge(uint64_t clk, const Command& cmd);
+    void CheckReadWrite(uint64_t clk, const Command& cmd);
+    void CheckRankClosed(uint64_t clk, const Command& cmd);
+    void CheckRefresh(uint64_t clk, const Command& cmd);
+    void CheckSelfRefresh(uint64_t clk, const Command& cmd);
+    void CheckPowerDown(uint64_t clk, const Command& cmd);
+    void Update(uint64_t clk, const Command& cmd);
+};
+
+}  // namespace dramsim3
+#endif
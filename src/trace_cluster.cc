@@ -0,0 +1,321 @@
+#include "trace_cluster.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+#include "json.hpp"
+#include "memory_system.h"
+
+namespace dramsim3 {
+
+namespace {
+
+using Json = nlohmann::json;
+
+double SquaredDistance(const std::vector<double>& a,
+                       const std::vector<double>& b) {
+    double dist = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        dist += (a[i] - b[i]) * (a[i] - b[i]);
+    }
+    return dist;
+}
+
+// adds weight * value for every number in stats, keeping the structure
+void AccumulateWeighted(Json& acc, const Json& stats, double weight) {
+    if (stats.is_number()) {
+        double value = stats.get<double>() * weight;
+        acc = acc.is_null() ? value : acc.get<double>() + value;
+    } else if (stats.is_object()) {
+        for (auto it = stats.begin(); it != stats.end(); it++) {
+            AccumulateWeighted(acc[it.key()], it.value(), weight);
+        }
+    }
+}
+
+}  // namespace
+
+std::vector<int> KMeans(const std::vector<std::vector<double> >& points,
+                        int k, int num_threads, int max_iters,
+                        std::vector<std::vector<double> >& centroids) {
+    int num_points = static_cast<int>(points.size());
+    std::vector<int> assignment(num_points, -1);
+    centroids.clear();
+    if (num_points == 0 || k <= 0) {
+        return assignment;
+    }
+
+    // k-means++ seeding with a fixed seed so that runs are reproducible
+    std::mt19937_64 gen(0);
+    centroids.push_back(points[gen() % num_points]);
+    std::vector<double> min_dist(num_points,
+                                 std::numeric_limits<double>::max());
+    while (static_cast<int>(centroids.size()) < std::min(k, num_points)) {
+        double total = 0.0;
+        for (int i = 0; i < num_points; i++) {
+            double d = SquaredDistance(points[i], centroids.back());
+            min_dist[i] = std::min(min_dist[i], d);
+            total += min_dist[i];
+        }
+        if (total == 0.0) {  // fewer distinct points than clusters
+            break;
+        }
+        std::uniform_real_distribution<double> dist(0.0, total);
+        double target = dist(gen);
+        int chosen = num_points - 1;
+        for (int i = 0; i < num_points; i++) {
+            target -= min_dist[i];
+            if (target <= 0.0) {
+                chosen = i;
+                break;
+            }
+        }
+        centroids.push_back(points[chosen]);
+    }
+
+    int num_clusters = static_cast<int>(centroids.size());
+    size_t dims = points[0].size();
+    num_threads = std::max(1, std::min(num_threads, num_points));
+    for (int iter = 0; iter < max_iters; iter++) {
+        std::vector<int> new_assignment(num_points);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < num_threads; t++) {
+            workers.emplace_back([&, t]() {
+                for (int i = t; i < num_points; i += num_threads) {
+                    double best = std::numeric_limits<double>::max();
+                    for (int c = 0; c < num_clusters; c++) {
+                        double d = SquaredDistance(points[i], centroids[c]);
+                        if (d < best) {
+                            best = d;
+                            new_assignment[i] = c;
+                        }
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (new_assignment == assignment) {
+            break;
+        }
+        assignment.swap(new_assignment);
+
+        std::vector<std::vector<double> > sums(num_clusters,
+                                               std::vector<double>(dims, 0.0));
+        std::vector<int> counts(num_clusters, 0);
+        for (int i = 0; i < num_points; i++) {
+            for (size_t d = 0; d < dims; d++) {
+                sums[assignment[i]][d] += points[i][d];
+            }
+            counts[assignment[i]]++;
+        }
+        for (int c = 0; c < num_clusters; c++) {
+            // an empty cluster keeps its old centroid
+            if (counts[c] == 0) continue;
+            for (size_t d = 0; d < dims; d++) {
+                centroids[c][d] = sums[c][d] / counts[c];
+            }
+        }
+    }
+    return assignment;
+}
+
+TraceClusterer::TraceClusterer(const Config& config,
+                               const std::string& trace_file,
+                               uint64_t interval_cycles)
+    : config_(config),
+      trace_file_(trace_file),
+      interval_cycles_(interval_cycles) {
+    if (interval_cycles_ == 0) {
+        std::cerr << "Interval length must be positive" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+int TraceClusterer::FlatBank(const Address& addr) const {
+    return ((addr.channel * config_.ranks + addr.rank) * config_.bankgroups +
+            addr.bankgroup) *
+               config_.banks_per_group +
+           addr.bank;
+}
+
+void TraceClusterer::BuildSignatures() {
+    std::ifstream trace(trace_file_);
+    if (trace.fail()) {
+        std::cerr << "Trace file does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    int num_banks = config_.channels * config_.ranks * config_.banks;
+    std::vector<uint64_t> bank_counts(num_banks, 0);
+    std::unordered_set<uint64_t> rows_touched;
+    uint64_t num_writes = 0;
+
+    auto finish_interval = [&](TraceInterval& interval) {
+        interval.signature.assign(num_banks + 3, 0.0);
+        double num_reqs = static_cast<double>(interval.num_requests);
+        if (interval.num_requests > 0) {
+            for (int b = 0; b < num_banks; b++) {
+                interval.signature[b] = bank_counts[b] / num_reqs;
+            }
+            interval.signature[num_banks] = num_writes / num_reqs;
+            interval.signature[num_banks + 1] =
+                rows_touched.size() / num_reqs;
+        }
+        // arrival rate, normalized once all intervals are known
+        interval.signature[num_banks + 2] = num_reqs;
+        std::fill(bank_counts.begin(), bank_counts.end(), 0);
+        rows_touched.clear();
+        num_writes = 0;
+    };
+
+    intervals_.clear();
+    Transaction trans;
+    std::streampos pos = trace.tellg();
+    while (trace >> trans) {
+        // the trace is assumed to be ordered by cycle, like TraceBasedCPU
+        uint64_t idx = trans.added_cycle / interval_cycles_;
+        while (intervals_.size() <= idx) {
+            if (!intervals_.empty()) {
+                finish_interval(intervals_.back());
+            }
+            TraceInterval interval;
+            interval.start_cycle = intervals_.size() * interval_cycles_;
+            interval.offset = pos;
+            interval.num_requests = 0;
+            intervals_.push_back(interval);
+        }
+        auto addr = config_.AddressMapping(trans.addr);
+        int bank = FlatBank(addr);
+        bank_counts[bank]++;
+        rows_touched.insert(static_cast<uint64_t>(bank) * config_.rows +
+                            addr.row);
+        num_writes += trans.is_write ? 1 : 0;
+        intervals_.back().num_requests++;
+        pos = trace.tellg();
+    }
+    if (!intervals_.empty()) {
+        finish_interval(intervals_.back());
+    }
+
+    uint64_t max_reqs = 0;
+    for (const auto& interval : intervals_) {
+        max_reqs = std::max(max_reqs, interval.num_requests);
+    }
+    for (auto& interval : intervals_) {
+        interval.signature.back() =
+            max_reqs == 0
+                ? 0.0
+                : static_cast<double>(interval.num_requests) / max_reqs;
+    }
+    return;
+}
+
+std::vector<Representative> TraceClusterer::Cluster(int k, int num_threads) {
+    std::vector<std::vector<double> > points;
+    points.reserve(intervals_.size());
+    for (const auto& interval : intervals_) {
+        points.push_back(interval.signature);
+    }
+    std::vector<std::vector<double> > centroids;
+    auto assignment = KMeans(points, k, num_threads, 100, centroids);
+
+    // the member closest to its centroid represents the cluster
+    std::vector<Representative> reps(centroids.size(), {-1, 0, 0.0});
+    std::vector<double> best(centroids.size(),
+                             std::numeric_limits<double>::max());
+    for (size_t i = 0; i < points.size(); i++) {
+        int c = assignment[i];
+        double d = SquaredDistance(points[i], centroids[c]);
+        if (d < best[c]) {
+            best[c] = d;
+            reps[c].interval = static_cast<int>(i);
+            reps[c].start_cycle = intervals_[i].start_cycle;
+        }
+        reps[c].weight += 1.0 / points.size();
+    }
+    reps.erase(std::remove_if(reps.begin(), reps.end(),
+                              [](const Representative& rep) {
+                                  return rep.interval < 0;
+                              }),
+               reps.end());
+    std::sort(reps.begin(), reps.end(),
+              [](const Representative& a, const Representative& b) {
+                  return a.start_cycle < b.start_cycle;
+              });
+    return reps;
+}
+
+void TraceClusterer::SimulateRepresentatives(
+    const std::string& config_file, const std::string& output_dir,
+    const std::vector<Representative>& reps, uint64_t warmup_cycles) {
+    std::ifstream trace(trace_file_);
+    std::ofstream reps_out(config_.output_prefix + "simpoints.txt");
+    reps_out << "# interval start_cycle weight" << std::endl;
+    Json weighted;
+
+    for (const auto& rep : reps) {
+        reps_out << rep.interval << " " << rep.start_cycle << " " << rep.weight
+                 << std::endl;
+        uint64_t begin = rep.start_cycle > warmup_cycles
+                             ? rep.start_cycle - warmup_cycles
+                             : 0;
+        uint64_t end = rep.start_cycle + interval_cycles_;
+        trace.clear();
+        trace.seekg(intervals_[begin / interval_cycles_].offset);
+
+        MemorySystem memory_system(config_file, output_dir,
+                                   [](uint64_t) {}, [](uint64_t) {});
+        Transaction trans;
+        bool has_trans = false;
+        for (uint64_t clk = begin; clk < end; clk++) {
+            // warm-up is over, only count the interval itself
+            if (clk == rep.start_cycle) {
+                memory_system.ResetStats();
+            }
+            while (!has_trans && trace >> trans) {
+                has_trans = trans.added_cycle >= begin;
+            }
+            // issued the same way TraceBasedCPU does
+            if (has_trans && trans.added_cycle <= clk) {
+                if (trans.bulk_op == BulkOp::COPY) {
+                    has_trans = !memory_system.AddBulkCopy(trans.src_addr,
+                                                           trans.addr);
+                } else if (trans.bulk_op == BulkOp::INIT) {
+                    has_trans = !memory_system.AddBulkInit(trans.addr);
+                } else if (memory_system.WillAcceptTransaction(
+                               trans.addr, trans.is_write)) {
+                    if (trans.is_partial) {
+                        memory_system.AddPartialWrite(trans.addr);
+                    } else {
+                        memory_system.AddTransaction(trans.addr,
+                                                     trans.is_write);
+                    }
+                    has_trans = false;
+                }
+            }
+            memory_system.ClockTick();
+        }
+        memory_system.PrintStats();
+
+        std::ifstream stats_in(config_.json_stats_name);
+        Json stats;
+        stats_in >> stats;
+        AccumulateWeighted(weighted, stats, rep.weight);
+    }
+
+    // weighted mean of each stat over all intervals, totals for the whole
+    // trace are num_intervals times the counters
+    weighted["num_intervals"] = intervals_.size();
+    weighted["interval_cycles"] = interval_cycles_;
+    std::ofstream weighted_out(config_.output_prefix + "weighted.json");
+    weighted_out << std::setw(4) << weighted << std::endl;
+    return;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,66 @@
+#ifndef __TRACE_CLUSTER_H
+#define __TRACE_CLUSTER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// A fixed length slice of a memory trace, in trace cycles
+struct TraceInterval {
+    uint64_t start_cycle;
+    // position of the first request at or after start_cycle in the trace
+    std::streampos offset;
+    uint64_t num_requests;
+    // bank footprint (fraction of requests per bank), followed by the
+    // write ratio, distinct rows per request and normalized arrival rate
+    std::vector<double> signature;
+};
+
+// An interval that stands in for a whole cluster of similar intervals
+struct Representative {
+    int interval;
+    uint64_t start_cycle;
+    double weight;  // fraction of all intervals in its cluster
+};
+
+// Plain Lloyd's k-means with k-means++ seeding, the assignment step is
+// split over num_threads threads. Returns the cluster of each point.
+std::vector<int> KMeans(const std::vector<std::vector<double> >& points,
+                        int k, int num_threads, int max_iters,
+                        std::vector<std::vector<double> >& centroids);
+
+// SimPoint-like phase analysis of an address trace: one pass computes a
+// signature per interval, the signatures are clustered and only one
+// representative interval per cluster needs to be simulated
+class TraceClusterer {
+   public:
+    TraceClusterer(const Config& config, const std::string& trace_file,
+                   uint64_t interval_cycles);
+    void BuildSignatures();
+    std::vector<Representative> Cluster(int k, int num_threads);
+    const std::vector<TraceInterval>& Intervals() const { return intervals_; }
+
+    // Simulate each representative after warmup_cycles of the preceding
+    // trace, then write the representatives to <output_prefix>simpoints.txt
+    // and the weighted per-interval stats to <output_prefix>weighted.json,
+    // next to the regular stats files
+    void SimulateRepresentatives(const std::string& config_file,
+                                 const std::string& output_dir,
+                                 const std::vector<Representative>& reps,
+                                 uint64_t warmup_cycles);
+
+   private:
+    const Config& config_;
+    std::string trace_file_;
+    uint64_t interval_cycles_;
+    std::vector<TraceInterval> intervals_;
+
+    int FlatBank(const Address& addr) const;
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,151 @@
+#include "trace_mixer.h"
+
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+namespace dramsim3 {
+
+namespace {
+// requests read ahead per trace at a time
+const size_t kPrefetchSize = 1024;
+const int kPageBits = 12;
+}  // namespace
+
+TraceMixer::TraceMixer(const std::string& mix_file) {
+    std::ifstream mix(mix_file);
+    if (mix.fail()) {
+        std::cerr << "Mix file " << mix_file << " does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    std::string line;
+    while (std::getline(mix, line)) {
+        std::istringstream fields(line);
+        std::string file_name, scale, offset;
+        if (!(fields >> file_name) || file_name[0] == '#') {
+            continue;
+        }
+        fields >> scale >> offset;
+        MixedTrace* trace = new MixedTrace();
+        trace->file_name = file_name;
+        trace->time_scale = scale.empty() ? 1.0 : std::stod(scale);
+        trace->random_pages = offset == "random";
+        trace->addr_offset = offset.empty() || trace->random_pages
+                                 ? 0
+                                 : std::stoull(offset, nullptr, 0);
+        trace->gen.seed(traces_.size());
+        trace->file.open(file_name, std::ifstream::ate);
+        if (trace->file.fail()) {
+            std::cerr << "Trace file " << file_name << " does not exist"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        trace->file_size = trace->file.tellg();
+        trace->file.seekg(0);
+        trace->bytes_read = 0;
+        if (trace->time_scale <= 0.0) {
+            std::cerr << "Time scale of " << file_name << " must be positive"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        traces_.push_back(trace);
+        PushHead(NumTraces() - 1);
+    }
+    if (traces_.empty()) {
+        std::cerr << "Mix file " << mix_file << " has no traces" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+TraceMixer::~TraceMixer() {
+    for (auto trace : traces_) {
+        delete trace;
+    }
+}
+
+double TraceMixer::Consumed() const {
+    uint64_t total_bytes = 0, total_read = 0;
+    for (auto trace : traces_) {
+        total_bytes += trace->file_size;
+        total_read += trace->bytes_read;
+    }
+    return total_bytes == 0 ? 1.0
+                            : static_cast<double>(total_read) / total_bytes;
+}
+
+bool TraceMixer::HasDue(uint64_t clk) const {
+    return !heap_.empty() && heap_.top().first <= clk;
+}
+
+uint64_t TraceMixer::NextCycle() const {
+    // held traces are back in the heap after Release()
+    return heap_.empty() ? std::numeric_limits<uint64_t>::max()
+                         : heap_.top().first;
+}
+
+void TraceMixer::Pop() {
+    int trace = Top();
+    heap_.pop();
+    traces_[trace]->buffer.pop_front();
+    PushHead(trace);
+    return;
+}
+
+void TraceMixer::Hold() {
+    held_.push_back(Top());
+    heap_.pop();
+    return;
+}
+
+void TraceMixer::Release() {
+    for (auto trace : held_) {
+        PushHead(trace);
+    }
+    held_.clear();
+    return;
+}
+
+void TraceMixer::PushHead(int trace) {
+    auto& buffer = traces_[trace]->buffer;
+    if (buffer.empty()) {
+        Refill(*traces_[trace]);
+    }
+    if (!buffer.empty()) {
+        heap_.push(std::make_pair(buffer.front().added_cycle, trace));
+    }
+    return;
+}
+
+void TraceMixer::Refill(MixedTrace& trace) {
+    Transaction trans;
+    while (trace.buffer.size() < kPrefetchSize && trace.file >> trans) {
+        trans.added_cycle =
+            static_cast<uint64_t>(trans.added_cycle / trace.time_scale);
+        trans.addr = MapAddress(trace, trans.addr);
+        if (trans.bulk_op == BulkOp::COPY) {
+            trans.src_addr = MapAddress(trace, trans.src_addr);
+        }
+        trace.buffer.push_back(trans);
+    }
+    trace.bytes_read =
+        trace.file.good() ? static_cast<uint64_t>(trace.file.tellg())
+                          : trace.file_size;
+    return;
+}
+
+uint64_t TraceMixer::MapAddress(MixedTrace& trace, uint64_t addr) {
+    if (!trace.random_pages) {
+        return addr + trace.addr_offset;
+    }
+    // first touch of a page picks its frame, like a demand paging OS would
+    uint64_t page = addr >> kPageBits;
+    auto it = trace.page_map.find(page);
+    if (it == trace.page_map.end()) {
+        it = trace.page_map.insert(std::make_pair(page, trace.gen() >> kPageBits))
+                 .first;
+    }
+    uint64_t page_mask = (1ull << kPageBits) - 1;
+    return (it->second << kPageBits) | (addr & page_mask);
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,76 @@
+#ifndef __TRACE_MIXER_H
+#define __TRACE_MIXER_H
+
+#include <deque>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+
+namespace dramsim3 {
+
+// One per-core trace of a mix. Requests are read ahead into a buffer and
+// already carry their mixed address and cycle there.
+struct MixedTrace {
+    std::string file_name;
+    double time_scale;     // > 1 replays the trace faster
+    uint64_t addr_offset;  // added to every address
+    bool random_pages;     // map 4KB pages to random frames instead
+    std::ifstream file;
+    uint64_t file_size;
+    uint64_t bytes_read;  // as of the last refill
+    std::deque<Transaction> buffer;
+    std::unordered_map<uint64_t, uint64_t> page_map;
+    std::mt19937_64 gen;
+};
+
+// Merges many traces into one stream of requests ordered by (scaled)
+// timestamp. The mix file has one trace per line:
+//     <trace file> [time scale] [address offset | random]
+// and each trace issues with its line number (from 0) as source id.
+class TraceMixer {
+   public:
+    explicit TraceMixer(const std::string& mix_file);
+    ~TraceMixer();
+    int NumTraces() const { return static_cast<int>(traces_.size()); }
+    const std::string& TraceName(int trace) const {
+        return traces_[trace]->file_name;
+    }
+
+    // whether the earliest pending request is due by clk
+    bool HasDue(uint64_t clk) const;
+    // cycle the earliest pending request is due at
+    uint64_t NextCycle() const;
+    int Top() const { return heap_.top().second; }
+    const Transaction& TopTransaction() const {
+        return traces_[Top()]->buffer.front();
+    }
+    // the top request was issued, move on to the next one of its trace
+    void Pop();
+    // the top request cannot issue this cycle, the rest of its trace waits
+    // behind it while the other traces go on
+    void Hold();
+    void Release();
+    bool Done() const { return heap_.empty() && held_.empty(); }
+    // fraction of the trace files read so far
+    double Consumed() const;
+
+   private:
+    using HeapEntry = std::pair<uint64_t, int>;  // (cycle, trace)
+    std::vector<MixedTrace*> traces_;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                        std::greater<HeapEntry> >
+        heap_;
+    std::vector<int> held_;
+
+    void Refill(MixedTrace& trace);
+    uint64_t MapAddress(MixedTrace& trace, uint64_t addr);
+    void PushHead(int trace);
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,138 @@
+#include "catch.hpp"
+#include "channel_state.h"
+#include "configuration.h"
+#include "timing.h"
+
+using dramsim3::Address;
+using dramsim3::Command;
+using dramsim3::CommandType;
+
+TEST_CASE("Subarray level parallelism", "[channel]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    // rows 0 and 1 are in the first subarray, row_b in the second
+    int row_b = config.rows_per_subarray;
+    auto cmd = [](CommandType type, int row) {
+        return Command(type, Address(0, 0, 0, 0, row, 0), 0);
+    };
+    auto required = [&](const dramsim3::ChannelState &channel_state,
+                        int row, uint64_t clk) {
+        return channel_state.GetReadyCommand(cmd(CommandType::READ, row), clk);
+    };
+
+    SECTION("Two subarrays can be open under MASA") {
+        config.salp = dramsim3::SALPMode::MASA;
+        dramsim3::Timing timing(config);
+        dramsim3::ChannelState channel_state(config, timing);
+        channel_state.UpdateTimingAndStates(cmd(CommandType::ACTIVATE, 0), 0);
+        auto ready = required(channel_state, row_b, 100);
+        REQUIRE(ready.cmd_type == CommandType::ACTIVATE);
+        channel_state.UpdateTimingAndStates(ready, 100);
+
+        // and both serve reads
+        REQUIRE(required(channel_state, 0, 200).cmd_type ==
+                CommandType::READ);
+        REQUIRE(required(channel_state, row_b, 200).cmd_type ==
+                CommandType::READ);
+        // another row of an open subarray is still a conflict
+        REQUIRE(required(channel_state, 1, 200).cmd_type ==
+                CommandType::PRECHARGE);
+    }
+
+    SECTION("Only the newest subarray is served under SALP2") {
+        config.salp = dramsim3::SALPMode::SALP2;
+        dramsim3::Timing timing(config);
+        dramsim3::ChannelState channel_state(config, timing);
+        channel_state.UpdateTimingAndStates(cmd(CommandType::ACTIVATE, 0), 0);
+        // the open subarray has to be accessed before the next one opens
+        REQUIRE(required(channel_state, row_b, 100).cmd_type ==
+                CommandType::PRECHARGE);
+        channel_state.UpdateTimingAndStates(cmd(CommandType::READ, 0), 100);
+        auto ready = required(channel_state, row_b, 200);
+        REQUIRE(ready.cmd_type == CommandType::ACTIVATE);
+        channel_state.UpdateTimingAndStates(ready, 200);
+
+        REQUIRE(required(channel_state, row_b, 300).cmd_type ==
+                CommandType::READ);
+        // the older row is still open, but has to be precharged to be read
+        REQUIRE(channel_state.OpenRow(0, 0, 0) == row_b);
+        auto pre = required(channel_state, 0, 300);
+        REQUIRE(pre.cmd_type == CommandType::PRECHARGE);
+        REQUIRE(pre.Row() == 0);
+    }
+
+    SECTION("SALP1 skips tRP across subarrays") {
+        uint64_t pre_clk = 100;
+        auto act_after_pre = [&](dramsim3::SALPMode salp, int row,
+                                 uint64_t clk) {
+            config.salp = salp;
+            dramsim3::Timing timing(config);
+            dramsim3::ChannelState channel_state(config, timing);
+            channel_state.UpdateTimingAndStates(
+                cmd(CommandType::ACTIVATE, 0), 0);
+            channel_state.UpdateTimingAndStates(
+                cmd(CommandType::PRECHARGE, 0), pre_clk);
+            return required(channel_state, row, clk).IsValid();
+        };
+
+        // another subarray can be activated right after the precharge
+        REQUIRE(act_after_pre(dramsim3::SALPMode::SALP1, row_b, pre_clk + 1));
+        REQUIRE_FALSE(
+            act_after_pre(dramsim3::SALPMode::NONE, row_b, pre_clk + 1));
+        // the same one waits for tRP either way
+        REQUIRE_FALSE(act_after_pre(dramsim3::SALPMode::SALP1, 1,
+                                    pre_clk + config.tRP - 1));
+        REQUIRE(act_after_pre(dramsim3::SALPMode::SALP1, 1,
+                              pre_clk + config.tRP));
+        REQUIRE(act_after_pre(dramsim3::SALPMode::NONE, row_b,
+                              pre_clk + config.tRP));
+    }
+}
+
+TEST_CASE("Command bus occupancy", "[channel]") {
+    auto cmd = [](CommandType type, int bank, int row) {
+        return Command(type, Address(0, 0, 0, bank, row, 0), 0);
+    };
+
+    SECTION("An LPDDR4 ACT takes 4 slots of the CA bus") {
+        dramsim3::Config config("configs/LPDDR4_8Gb_x16_2400.ini", ".");
+        config.ca_bus_model = true;
+        dramsim3::Timing timing(config);
+        dramsim3::ChannelState channel_state(config, timing);
+        channel_state.UpdateTimingAndStates(
+            cmd(CommandType::ACTIVATE, 1, 0), 0);
+        channel_state.UpdateTimingAndStates(
+            cmd(CommandType::ACTIVATE, 0, 0), 100);
+
+        // bank 1 could be read all along, but has to wait for the bus
+        auto read = cmd(CommandType::READ, 1, 0);
+        for (uint64_t clk = 100; clk < 104; clk++) {
+            REQUIRE(channel_state.IsCABusBusy(clk));
+            REQUIRE_FALSE(channel_state.GetReadyCommand(read, clk).IsValid());
+        }
+        REQUIRE_FALSE(channel_state.IsCABusBusy(104));
+        REQUIRE(channel_state.GetReadyCommand(read, 104).cmd_type ==
+                CommandType::READ);
+    }
+
+    SECTION("HBM row and column commands use separate buses") {
+        dramsim3::Config config("configs/HBM2_8Gb_x128.ini", ".");
+        config.ca_bus_model = true;
+        dramsim3::Timing timing(config);
+        dramsim3::ChannelState channel_state(config, timing);
+        channel_state.UpdateTimingAndStates(
+            cmd(CommandType::ACTIVATE, 1, 0), 0);
+        channel_state.UpdateTimingAndStates(
+            cmd(CommandType::ACTIVATE, 0, 0), 100);
+
+        // the ACT holds the row bus for 2 cycles, column commands go ahead
+        REQUIRE_FALSE(channel_state.IsCABusBusy(101));
+        auto hit = cmd(CommandType::READ, 1, 0);
+        REQUIRE(channel_state.GetReadyCommand(hit, 101).cmd_type ==
+                CommandType::READ);
+        // while a miss has to wait for the row bus to precharge
+        auto miss = cmd(CommandType::READ, 1, 1);
+        REQUIRE_FALSE(channel_state.GetReadyCommand(miss, 101).IsValid());
+        REQUIRE(channel_state.GetReadyCommand(miss, 102).cmd_type ==
+                CommandType::PRECHARGE);
+    }
+}
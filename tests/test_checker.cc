@@ -0,0 +1,128 @@
+#include <vector>
+
+#include "catch.hpp"
+#include "channel_state.h"
+#include "configuration.h"
+#include "timing.h"
+#include "timing_checker.h"
+
+using dramsim3::Address;
+using dramsim3::Command;
+using dramsim3::CommandType;
+
+static Command MakeCmd(CommandType type, int rank, int bg, int bank, int row) {
+    return Command(type, Address(0, rank, bg, bank, row, 0), 0);
+}
+
+TEST_CASE("Timing checker", "[checker]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+
+    SECTION("Legal sequence has no violations") {
+        dramsim3::TimingChecker checker(config, 10);
+        uint64_t clk = 100;
+        checker.Check(clk, MakeCmd(CommandType::ACTIVATE, 0, 0, 0, 5));
+        clk += config.tRCD;
+        checker.Check(clk, MakeCmd(CommandType::READ, 0, 0, 0, 5));
+        clk += config.tRAS;
+        checker.Check(clk, MakeCmd(CommandType::PRECHARGE, 0, 0, 0, 5));
+        clk += config.tRP;
+        checker.Check(clk, MakeCmd(CommandType::ACTIVATE, 0, 0, 0, 6));
+        REQUIRE(checker.NumCommands() == 4);
+        REQUIRE(checker.NumViolations() == 0);
+    }
+
+    SECTION("Same bank violations") {
+        dramsim3::TimingChecker checker(config, 10);
+        checker.Check(100, MakeCmd(CommandType::ACTIVATE, 0, 0, 0, 5));
+        checker.Check(101, MakeCmd(CommandType::READ, 0, 0, 0, 5));
+        REQUIRE(checker.NumViolations() == 1);
+        REQUIRE(checker.Violations()[0].rule == "tRCD (read)");
+        REQUIRE(checker.Violations()[0].earliest == 100 + config.tRCD);
+
+        checker.Check(102, MakeCmd(CommandType::READ, 0, 0, 0, 7));
+        REQUIRE(checker.Violations()[1].rule == "CAS to wrong row");
+    }
+
+    SECTION("Four activation window") {
+        dramsim3::TimingChecker checker(config, 10);
+        uint64_t clk = 100;
+        int step = std::max(config.tRRD_L, config.tRRD_S);
+        for (int i = 0; i < 4; i++) {
+            checker.Check(clk, MakeCmd(CommandType::ACTIVATE, 0, i, 0, 1));
+            clk += step;
+        }
+        REQUIRE(checker.NumViolations() == 0);
+        checker.Check(clk, MakeCmd(CommandType::ACTIVATE, 0, 0, 1, 1));
+        REQUIRE(checker.NumViolations() == 1);
+        REQUIRE(checker.Violations()[0].rule == "tFAW");
+    }
+
+    SECTION("Refresh needs closed banks and tRFC") {
+        dramsim3::TimingChecker checker(config, 10);
+        checker.Check(100, MakeCmd(CommandType::ACTIVATE, 0, 0, 0, 1));
+        checker.Check(200, MakeCmd(CommandType::REFRESH, 0, -1, -1, -1));
+        REQUIRE(checker.Violations()[0].rule == "rank command with open bank");
+
+        dramsim3::TimingChecker checker2(config, 10);
+        checker2.Check(100, MakeCmd(CommandType::REFRESH, 0, -1, -1, -1));
+        checker2.Check(101, MakeCmd(CommandType::ACTIVATE, 0, 0, 0, 1));
+        REQUIRE(checker2.Violations()[0].rule == "tRFC");
+        checker2.Finish(100 + 10 * config.tREFI);
+        REQUIRE(checker2.Violations().back().rule ==
+                "refresh postponed beyond 8 tREFI");
+    }
+}
+
+TEST_CASE("Timing checker same-bank refresh", "[checker]") {
+    dramsim3::Config config("configs/DDR5_16Gb_x8_4800.ini", ".");
+    dramsim3::TimingChecker checker(config, 10);
+    checker.Check(100, MakeCmd(CommandType::REFRESH_SAME_BANK, 0, -1, 1, -1));
+    // other banks only wait for tREFSBRD
+    checker.Check(100 + config.tREFSBRD,
+                  MakeCmd(CommandType::ACTIVATE, 0, 3, 0, 1));
+    REQUIRE(checker.NumViolations() == 0);
+    // the refreshed bank index is busy for tRFCsb in every bankgroup
+    checker.Check(200 + config.tREFSBRD,
+                  MakeCmd(CommandType::ACTIVATE, 0, 5, 1, 1));
+    REQUIRE(checker.NumViolations() == 1);
+    REQUIRE(checker.Violations()[0].rule == "tRFCsb");
+}
+
+TEST_CASE("Timing checker on row clones", "[checker]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    config.row_clone = true;
+    dramsim3::Timing timing(config);
+    dramsim3::ChannelState channel_state(config, timing);
+    dramsim3::TimingChecker checker(config, 10);
+
+    // half the banks of rank 0 clone rows back to back, the other half
+    // read a new row every time, one command as soon as one is ready
+    int banks = config.bankgroups * config.banks_per_group;
+    std::vector<int> rows(banks, 0);
+    int num_clones = 0;
+    for (uint64_t clk = 0; clk < 20000; clk++) {
+        for (int i = 0; i < banks; i++) {
+            int b = (clk + i) % banks;
+            int bg = b / config.banks_per_group;
+            int bank = b % config.banks_per_group;
+            bool clone = bg % 2 == 0;
+            Command cmd(clone ? CommandType::ROW_CLONE : CommandType::READ,
+                        Address(0, 0, bg, bank, rows[b], 0), 0);
+            Command ready = channel_state.GetReadyCommand(cmd, clk);
+            if (!ready.IsValid()) {
+                continue;
+            }
+            checker.Check(clk, ready);
+            channel_state.UpdateTimingAndStates(ready, clk);
+            if (ready.cmd_type == CommandType::ROW_CLONE) {
+                num_clones++;
+            }
+            if (ready.cmd_type == cmd.cmd_type) {
+                rows[b]++;
+            }
+            break;
+        }
+    }
+    REQUIRE(num_clones > 100);
+    REQUIRE(checker.NumViolations() == 0);
+}
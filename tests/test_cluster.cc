@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <fstream>
+#include "catch.hpp"
+#include "json.hpp"
+#include "trace_cluster.h"
+
+TEST_CASE("K-means clustering of interval signatures", "[cluster]") {
+    // two well separated groups of points
+    std::vector<std::vector<double> > points = {
+        {0.0, 0.1}, {0.1, 0.0}, {0.05, 0.05}, {1.0, 0.9}, {0.9, 1.0}};
+    std::vector<std::vector<double> > centroids;
+    auto assignment = dramsim3::KMeans(points, 2, 3, 100, centroids);
+    REQUIRE(centroids.size() == 2);
+    REQUIRE(assignment[0] == assignment[1]);
+    REQUIRE(assignment[0] == assignment[2]);
+    REQUIRE(assignment[3] == assignment[4]);
+    REQUIRE(assignment[0] != assignment[3]);
+
+    // more clusters than distinct points
+    std::vector<std::vector<double> > same = {{0.5}, {0.5}, {0.5}};
+    assignment = dramsim3::KMeans(same, 3, 2, 100, centroids);
+    REQUIRE(centroids.size() == 1);
+    REQUIRE(assignment[2] == 0);
+}
+
+TEST_CASE("Simulating representatives of a two-phase trace", "[cluster]") {
+    std::string config_file = "configs/DDR4_8Gb_x8_2400.ini";
+    dramsim3::Config config(config_file, ".");
+    // 4 intervals of reads to one bank, then 4 of writes to another
+    {
+        std::ofstream trace("cluster.trace");
+        for (int i = 0; i < 8; i++) {
+            bool write_phase = i >= 4;
+            for (int j = 0; j < 20; j++) {
+                dramsim3::Address addr(0, 0, write_phase ? 1 : 0,
+                                       write_phase ? 2 : 0, i, j);
+                trace << std::hex << "0x"
+                      << config.ReverseAddressMapping(addr) << std::dec
+                      << (write_phase ? " WRITE " : " READ ")
+                      << i * 1000 + j * 10 << "\n";
+            }
+        }
+    }
+    dramsim3::TraceClusterer clusterer(config, "cluster.trace", 1000);
+    clusterer.BuildSignatures();
+    const auto& intervals = clusterer.Intervals();
+    REQUIRE(intervals.size() == 8);
+    int num_banks = config.channels * config.ranks * config.banks;
+    const auto& read_sig = intervals[0].signature;
+    const auto& write_sig = intervals[7].signature;
+    REQUIRE(read_sig.size() == static_cast<size_t>(num_banks + 3));
+    REQUIRE(intervals[0].num_requests == 20);
+    REQUIRE(read_sig[0] == 1.0);
+    REQUIRE(read_sig[num_banks] == 0.0);
+    REQUIRE(write_sig[config.banks_per_group + 2] == 1.0);
+    REQUIRE(write_sig[num_banks] == 1.0);
+    REQUIRE(read_sig[num_banks + 2] == 1.0);
+
+    auto reps = clusterer.Cluster(2, 2);
+    REQUIRE(reps.size() == 2);
+    REQUIRE(reps[0].start_cycle < 4000);
+    REQUIRE(reps[1].start_cycle >= 4000);
+    REQUIRE(reps[0].weight == Approx(0.5));
+    REQUIRE(reps[1].weight == Approx(0.5));
+
+    clusterer.SimulateRepresentatives(config_file, ".", reps, 500);
+    std::ifstream weighted_in(config.output_prefix + "weighted.json");
+    nlohmann::json weighted;
+    weighted_in >> weighted;
+    REQUIRE(weighted["num_intervals"] == 8);
+    REQUIRE(weighted["interval_cycles"] == 1000);
+    // each phase stands for half of the trace
+    REQUIRE(weighted["0"]["num_reads_done"].get<double>() == Approx(10.0));
+    REQUIRE(weighted["0"]["num_writes_done"].get<double>() == Approx(10.0));
+
+    std::remove("cluster.trace");
+    for (auto name : {config.output_prefix + "simpoints.txt",
+                      config.output_prefix + "weighted.json",
+                      config.json_stats_name, config.txt_stats_name,
+                      config.json_epoch_name, config.json_system_name,
+                      config.json_system_epoch_name}) {
+        std::remove(name.c_str());
+    }
+}
+
+TEST_CASE("Simulating representatives with bulk requests", "[cluster]") {
+    std::string config_file = "configs/DDR4_8Gb_x8_2400.ini";
+    dramsim3::Config config(config_file, ".");
+    // one row init per interval, written line by line without RowClone
+    {
+        std::ofstream trace("cluster_bulk.trace");
+        for (int i = 0; i < 4; i++) {
+            dramsim3::Address addr(0, 0, 0, 0, i, 0);
+            trace << std::hex << "0x" << config.ReverseAddressMapping(addr)
+                  << std::dec << " ROW_INIT " << i * 1000 << "\n";
+        }
+    }
+    dramsim3::TraceClusterer clusterer(config, "cluster_bulk.trace", 1000);
+    clusterer.BuildSignatures();
+    auto reps = clusterer.Cluster(1, 1);
+    REQUIRE(reps.size() == 1);
+
+    clusterer.SimulateRepresentatives(config_file, ".", reps, 0);
+    std::ifstream weighted_in(config.output_prefix + "weighted.json");
+    nlohmann::json weighted;
+    weighted_in >> weighted;
+    REQUIRE(weighted["0"]["num_reads_done"].get<double>() == 0.0);
+    REQUIRE(weighted["0"]["num_writes_done"].get<double>() > 0.0);
+
+    std::remove("cluster_bulk.trace");
+    for (auto name : {config.output_prefix + "simpoints.txt",
+                      config.output_prefix + "weighted.json",
+                      config.json_stats_name, config.txt_stats_name,
+                      config.json_epoch_name, config.json_system_name,
+                      config.json_system_epoch_name}) {
+        std::remove(name.c_str());
+    }
+}
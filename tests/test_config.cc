@@ -1,4 +1,6 @@
 #define CATCH_CONFIG_MAIN
+#include <set>
+#include <tuple>
 #include "catch.hpp"
 #include "configuration.h"
 
@@ -91,5 +93,60 @@ TEST_CASE("Address Mapping", "[config]") {
         addr = config.AddressMapping(hex_addr);
         REQUIRE(addr.row == 0b10000000000000);
     }
+
+    SECTION("Test reverse address mapping") {
+        uint64_t hex_addr = 0x1234540;
+        auto addr = config.AddressMapping(hex_addr);
+        REQUIRE(config.ReverseAddressMapping(addr) == hex_addr);
+    }
+}
+
+
+TEST_CASE("DDR5 subchannels", "[config]") {
+    dramsim3::Config config("configs/DDR5_16Gb_x8_4800.ini", ".");
+
+    SECTION("Each subchannel is modeled as a 32-bit channel") {
+        REQUIRE(config.IsDDR5());
+        REQUIRE(config.subchannels == 2);
+        REQUIRE(config.channels == 2);
+        REQUIRE(config.bus_width == 32);
+        REQUIRE(config.channel_size == 8192);
+        REQUIRE(config.ranks == 1);
+        REQUIRE(config.bankgroups == 8);
+        REQUIRE(config.burst_cycle == 8);
+        REQUIRE(config.request_size_bytes == 64);
+        REQUIRE(config.refresh_policy ==
+                dramsim3::RefreshPolicy::SAME_BANK_STAGGERED);
+    }
 }
 
+TEST_CASE("Bank partitioning", "[config]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    REQUIRE(config.num_sources == 1);
+    config.partition_banks.resize(2);
+    config.partition_banks[1] = {4, 5, 6, 7};
+
+    SECTION("Unpartitioned source keeps the plain mapping") {
+        uint64_t hex_addr = 0x12345640;
+        auto addr = config.AddressMapping(hex_addr);
+        auto part_addr = config.AddressMapping(hex_addr, 0);
+        REQUIRE(part_addr.bankgroup == addr.bankgroup);
+        REQUIRE(part_addr.bank == addr.bank);
+        REQUIRE(part_addr.row == addr.row);
+    }
+
+    SECTION("Partitioned source stays in its banks without aliasing") {
+        std::set<std::tuple<int, int, int>> seen;
+        for (int i = 0; i < config.banks; i++) {
+            uint64_t hex_addr = config.ReverseAddressMapping(
+                dramsim3::Address(0, 0, i / config.banks_per_group,
+                                  i % config.banks_per_group, 3, 0));
+            auto addr = config.AddressMapping(hex_addr, 1);
+            int flat_bank = addr.bankgroup * config.banks_per_group + addr.bank;
+            REQUIRE(flat_bank >= 4);
+            REQUIRE(flat_bank <= 7);
+            seen.insert(std::make_tuple(addr.bankgroup, addr.bank, addr.row));
+        }
+        REQUIRE(seen.size() == static_cast<size_t>(config.banks));
+    }
+}
@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <fstream>
+#include "catch.hpp"
+#include "configuration.h"
+#include "cpu.h"
+
+namespace {
+// exposes the cycle the CPU got to
+class TestTraceCPU : public dramsim3::TraceBasedCPU {
+   public:
+    using dramsim3::TraceBasedCPU::TraceBasedCPU;
+    uint64_t Clk() const { return clk_; }
+};
+}  // namespace
+
+TEST_CASE("Running a trace to completion", "[cpu]") {
+    std::string config_file = "configs/DDR4_8Gb_x8_2400.ini";
+    dramsim3::Config config(config_file, ".");
+    // a row init among regular requests, written line by line without
+    // RowClone, and done well after the requests issued last
+    {
+        std::ofstream trace("cpu_run.trace");
+        auto line = [&](int row) {
+            return config.ReverseAddressMapping(
+                dramsim3::Address(0, 0, 0, 0, row, 0));
+        };
+        trace << std::hex << "0x" << line(1) << " READ " << std::dec << 10
+              << "\n"
+              << std::hex << "0x" << line(2) << " ROW_INIT " << std::dec
+              << 20 << "\n"
+              << std::hex << "0x" << line(3) << " WRITE " << std::dec << 30
+              << "\n";
+    }
+
+    // the same stop with -r as when ticking until the last callback
+    TestTraceCPU run_cpu(config_file, ".", "cpu_run.trace");
+    run_cpu.Run(1000000, true, 0);
+    REQUIRE(run_cpu.Drained());
+    TestTraceCPU tick_cpu(config_file, ".", "cpu_run.trace");
+    while (!tick_cpu.Drained()) {
+        tick_cpu.ClockTick();
+    }
+    REQUIRE(run_cpu.Clk() == tick_cpu.Clk());
+    int row_lines = config.columns / config.BL;
+    REQUIRE(run_cpu.Clk() > static_cast<uint64_t>(row_lines *
+                                                    config.burst_cycle));
+    REQUIRE(run_cpu.Clk() < 1000000);
+
+    std::remove("cpu_run.trace");
+}
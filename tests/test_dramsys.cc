@@ -1,6 +1,20 @@
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+
 #include "catch.hpp"
+#include "channel_state.h"
 #include "configuration.h"
+#include "controller.h"
+#include "cxl.h"
 #include "dram_system.h"
+#include "json.hpp"
+#include "memory_system.h"
+#include "nvm.h"
+#include "power_governor.h"
+#include "request_log.h"
+#include "simple_stats.h"
 
 bool call_back_called = false;
 void dummy_call_back(uint64_t addr) {
@@ -30,3 +44,554 @@ TEST_CASE("Jedec DRAMSystem Testing", "[dramsim3]") {
         REQUIRE(clk == tRC);
     }
 }
+
+TEST_CASE("Bulk row init without RowClone", "[dramsim3]") {
+    dramsim3::Config config("configs/HBM1_4Gb_x128.ini", ".");
+    dramsim3::JedecDRAMSystem dramsys(config, ".", dummy_call_back,
+                                      dummy_call_back);
+
+    SECTION("Falls back to writing every line of the row") {
+        call_back_called = false;
+        REQUIRE(dramsys.AddBulkInit(0));
+        int clk = 0;
+        while (!call_back_called && clk < 100000) {
+            dramsys.ClockTick();
+            clk++;
+        }
+        call_back_called = false;
+        // one write issued per cycle at most
+        REQUIRE(clk > static_cast<int>(config.co_mask));
+        REQUIRE(clk < 100000);
+    }
+}
+
+TEST_CASE("Bulk row init with RowClone", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    config.row_clone = true;
+    uint64_t done_addr = 0;
+    int clk = 0, done_clk = -1;
+    auto callback = [&](uint64_t addr) {
+        done_addr = addr;
+        done_clk = clk;
+    };
+    dramsim3::JedecDRAMSystem dramsys(config, ".", callback, callback);
+
+    // a lone init does not wait for the write buffer to fill up
+    REQUIRE(dramsys.AddBulkInit(0x10000));
+    for (; clk < 1000 && done_clk < 0; clk++) {
+        dramsys.ClockTick();
+    }
+    REQUIRE(done_addr == 0x10000);
+    REQUIRE(done_clk >= config.tCLONE);
+    REQUIRE(done_clk < config.tCLONE + 100);
+    REQUIRE(dramsys.NextEventCycle() > static_cast<uint64_t>(clk));
+}
+
+TEST_CASE("Sampled read latency breakdown", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    config.latency_sample_interval = 1;
+    config.output_level = -1;
+    dramsim3::Timing timing(config);
+    dramsim3::Controller ctrl(0, config, timing);
+    auto line = [&](int row, int column) {
+        return config.ReverseAddressMapping(
+            dramsim3::Address(0, 0, 0, 0, row, column));
+    };
+
+    // a miss on the closed bank, a hit queued along with it (so its row
+    // gets opened while it waits) and then a conflict with another row
+    ctrl.AddTransaction(dramsim3::Transaction(line(1, 0), false));
+    ctrl.AddTransaction(dramsim3::Transaction(line(1, 1), false));
+    for (int i = 0; i < 200; i++) {
+        ctrl.ClockTick();
+    }
+    ctrl.AddTransaction(dramsim3::Transaction(line(2, 0), false));
+    for (int i = 0; i < 200; i++) {
+        ctrl.ClockTick();
+    }
+    ctrl.PrintFinalStats();
+
+    const auto &stats = ctrl.GetStats();
+    REQUIRE(stats.PrintedCounter("num_sampled_reads", false) == 3);
+    REQUIRE(stats.PrintedCounter("sampled_bank_conflicts", false) == 1);
+    const auto &act_to_cas = stats.PrintedHisto("lat_act_to_cas", false);
+    REQUIRE(act_to_cas.size() == 1);
+    REQUIRE(act_to_cas.at(config.tRCD) == 2);
+    const auto &pre_to_act = stats.PrintedHisto("lat_pre_to_act", false);
+    REQUIRE(pre_to_act.size() == 1);
+    REQUIRE(pre_to_act.at(config.tRP) == 1);
+}
+
+TEST_CASE("Self-refresh after an idle threshold", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    config.enable_self_refresh = true;
+    config.row_buf_policy = "CLOSE_PAGE";
+    config.output_level = -1;
+    dramsim3::Timing timing(config);
+
+    SECTION("Ranks go back to sleep after every wake up") {
+        dramsim3::Controller ctrl(0, config, timing);
+        uint64_t clk = 0;
+        auto run = [&](int cycles) {
+            for (int i = 0; i < cycles; i++) {
+                ctrl.ClockTick();
+                clk++;
+                while (ctrl.ReturnDoneTrans(clk).second >= 0) {
+                }
+            }
+        };
+        ctrl.AddTransaction(dramsim3::Transaction(0, false));
+        run(3000);
+        ctrl.AddTransaction(dramsim3::Transaction(0, false));
+        run(3000);
+        ctrl.PrintFinalStats();
+
+        // both ranks fall asleep, rank 0 wakes up for the second read and
+        // falls asleep again
+        const auto &stats = ctrl.GetStats();
+        REQUIRE(stats.PrintedCounter("num_reads_done", false) == 2);
+        REQUIRE(stats.PrintedCounter("num_srefe_cmds", false) == 3);
+        REQUIRE(stats.PrintedCounter("num_srefx_cmds", false) == 1);
+        const auto &latency = stats.PrintedHisto("read_latency", false);
+        int slowest = 0;
+        for (const auto &it : latency) {
+            slowest = std::max(slowest, it.first);
+        }
+        REQUIRE(slowest > config.tXS);
+    }
+
+    SECTION("No self-refresh entry with a refresh pending") {
+        dramsim3::ChannelState channel_state(config, timing);
+        dramsim3::SimpleStats stats(config, 0);
+        dramsim3::PowerGovernor governor(config, channel_state, stats);
+        std::vector<bool> rank_busy(config.ranks, false);
+        channel_state.rank_idle_cycles[0] = config.sref_threshold;
+        channel_state.RankNeedRefresh(0, true);
+        governor.Update(rank_busy);
+        REQUIRE_FALSE(governor.GetCommandToIssue(rank_busy).IsValid());
+        channel_state.RankNeedRefresh(0, false);
+        auto cmd = governor.GetCommandToIssue(rank_busy);
+        REQUIRE(cmd.cmd_type == dramsim3::CommandType::SREF_ENTER);
+        REQUIRE(cmd.Rank() == 0);
+    }
+}
+
+TEST_CASE("Power governor decisions", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    config.enable_self_refresh = true;
+    config.power_governor = true;
+    dramsim3::Timing timing(config);
+    dramsim3::ChannelState channel_state(config, timing);
+    dramsim3::SimpleStats stats(config, 0);
+    dramsim3::PowerGovernor governor(config, channel_state, stats);
+
+    // rank 0 alternates between busy and idle periods, the other ranks
+    // stay busy so that they never get a command
+    using dramsim3::CommandType;
+    std::vector<bool> rank_busy(config.ranks, true);
+    std::vector<std::pair<uint64_t, CommandType>> issued;
+    uint64_t clk = 0;
+    auto run = [&](bool busy, int cycles) {
+        rank_busy[0] = busy;
+        for (int i = 0; i < cycles; i++) {
+            governor.Update(rank_busy);
+            auto cmd = governor.GetCommandToIssue(rank_busy);
+            if (cmd.IsValid()) {
+                REQUIRE(cmd.Rank() == 0);
+                channel_state.UpdateTimingAndStates(cmd, clk);
+                issued.push_back(std::make_pair(clk, cmd.cmd_type));
+            }
+            governor.ClockTick();
+            clk++;
+        }
+    };
+
+    SECTION("Long idle periods go into self-refresh right away") {
+        int idle = 20000;
+        for (int i = 0; i < 4; i++) {
+            run(true, 100);
+            run(false, idle);
+        }
+        run(true, 100);
+        issued.clear();
+        uint64_t start = clk;
+        run(false, idle);
+        run(true, 100);
+
+        // and wake up early for the next request, instead of making it
+        // wait for tXS, then power down for what is left of the period
+        REQUIRE(issued.size() == 4);
+        REQUIRE(issued[0].first == start);
+        REQUIRE(issued[0].second == CommandType::SREF_ENTER);
+        REQUIRE(issued[1].second == CommandType::SREF_EXIT);
+        REQUIRE(issued[1].first + config.tXS <= start + idle);
+        REQUIRE(issued[2].second == CommandType::PD_ENTER);
+        REQUIRE(issued[3].first == start + idle);
+        REQUIRE(issued[3].second == CommandType::PD_EXIT);
+    }
+
+    SECTION("Short idle periods only power down") {
+        int idle = 300;
+        for (int i = 0; i < 8; i++) {
+            run(true, 100);
+            run(false, idle);
+        }
+        for (const auto &it : issued) {
+            REQUIRE(it.second != CommandType::SREF_ENTER);
+        }
+        run(true, 100);
+        issued.clear();
+        uint64_t start = clk;
+        run(false, idle);
+        run(true, 100);
+
+        REQUIRE(issued.size() == 2);
+        REQUIRE(issued[0].first == start);
+        REQUIRE(issued[0].second == CommandType::PD_ENTER);
+        REQUIRE(issued[1].first == start + idle);
+        REQUIRE(issued[1].second == CommandType::PD_EXIT);
+    }
+}
+
+TEST_CASE("Patrol scrub and ECC read-modify-write", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    config.output_level = -1;
+    auto line = [&](int row, int column) {
+        return config.ReverseAddressMapping(
+            dramsim3::Address(0, 0, 0, 0, row, column));
+    };
+
+    SECTION("Scrub reads take idle slots, or wait for the backlog") {
+        config.scrub_interval = 1000;
+        config.scrub_backlog = 4;
+        dramsim3::Timing timing(config);
+        // with loaded set, 16 host reads to other rows of the bank are
+        // kept outstanding so that the read queue never runs empty
+        auto scrub_reads = [&](int cycles, bool loaded) {
+            dramsim3::Controller ctrl(0, config, timing);
+            int outstanding = 0;
+            int row = 1;
+            for (int i = 0; i < cycles; i++) {
+                while (loaded && outstanding < 16) {
+                    ctrl.AddTransaction(
+                        dramsim3::Transaction(line(row++, 0), false));
+                    outstanding++;
+                }
+                ctrl.ClockTick();
+                while (ctrl.ReturnDoneTrans(i + 1).second == 0) {
+                    outstanding--;
+                }
+            }
+            ctrl.PrintFinalStats();
+            return ctrl.GetStats().PrintedCounter("num_scrub_reads", false);
+        };
+
+        REQUIRE(scrub_reads(990, false) == 0);
+        REQUIRE(scrub_reads(1100, false) == 1);
+        REQUIRE(scrub_reads(3900, false) == 3);
+        REQUIRE(scrub_reads(9000, false) == 8);
+
+        // nothing until 4 are owed, then only enough to stay at 3 owed
+        REQUIRE(scrub_reads(3900, true) == 0);
+        REQUIRE(scrub_reads(9000, true) == 5);
+    }
+
+    SECTION("Partial writes wait for their RMW read") {
+        config.ecc_rmw = true;
+        dramsim3::Timing timing(config);
+        dramsim3::Controller ctrl(0, config, timing);
+        // enough of them for the write buffer to be drained
+        for (int column = 0; column < 9; column++) {
+            dramsim3::Transaction write(line(1, column), true);
+            write.is_partial = true;
+            ctrl.AddTransaction(write);
+        }
+        for (int i = 0; i < 1000; i++) {
+            ctrl.ClockTick();
+            while (ctrl.ReturnDoneTrans(i + 1).second >= 0) {
+            }
+        }
+        ctrl.PrintFinalStats();
+
+        const auto &stats = ctrl.GetStats();
+        REQUIRE(stats.PrintedCounter("num_partial_writes", false) == 9);
+        REQUIRE(stats.PrintedCounter("num_rmw_reads", false) == 9);
+        REQUIRE(stats.PrintedCounter("num_read_cmds", false) == 9);
+        REQUIRE(stats.PrintedCounter("num_write_cmds", false) == 9);
+        // released once the read data is back, and only written after
+        int last_release = 0;
+        for (const auto &it : stats.PrintedHisto("rmw_latency", false)) {
+            REQUIRE(it.first >= config.tRCD + config.read_delay);
+            last_release = std::max(last_release, it.first);
+        }
+        REQUIRE(last_release > 0);
+        for (const auto &it : stats.PrintedHisto("write_latency", false)) {
+            REQUIRE(it.first >= last_release + config.write_delay);
+        }
+    }
+}
+
+TEST_CASE("Data bus reservation", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    dramsim3::DataBus data_bus(config);
+    int burst = config.burst_cycle;
+
+    SECTION("Back to back reads to one rank") {
+        data_bus.Reserve(0, false, 100);
+        REQUIRE(data_bus.EarliestCAS(0, false) == 100 + burst);
+    }
+
+    SECTION("Rank switch gaps") {
+        data_bus.Reserve(0, false, 100);
+        REQUIRE(data_bus.EarliestCAS(1, false) ==
+                100 + burst + config.tRTRS);
+        REQUIRE(data_bus.EarliestCAS(1, true) ==
+                100 + config.read_delay + config.tRTRS - config.WL);
+        data_bus.Reserve(0, true, 200);
+        REQUIRE(data_bus.EarliestCAS(1, true) ==
+                200 + burst + config.tODTSW);
+    }
+}
+
+TEST_CASE("Skipping idle cycles", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    std::vector<uint64_t> ticked, advanced;
+    uint64_t clk = 0;
+    auto tick_done = [&](uint64_t addr) { ticked.push_back(clk); };
+    auto advance_done = [&](uint64_t addr) { advanced.push_back(clk); };
+    dramsim3::JedecDRAMSystem tick_sys(config, ".", tick_done, tick_done);
+    dramsim3::JedecDRAMSystem advance_sys(config, ".", advance_done,
+                                          advance_done);
+
+    // a few requests far apart, with refreshes in between
+    uint64_t skipped = 0;
+    for (int i = 0; i < 8; i++) {
+        uint64_t addr = static_cast<uint64_t>(i) * 0x1234540;
+        tick_sys.AddTransaction(addr, i % 3 == 0);
+        advance_sys.AddTransaction(addr, i % 3 == 0);
+        uint64_t until = (i + 1) * 5000;
+        uint64_t start = clk;
+        for (; clk < until; clk++) {
+            tick_sys.ClockTick();
+        }
+        for (clk = start; clk < until;) {
+            uint64_t next = std::min(advance_sys.NextEventCycle(), until);
+            if (next > clk) {
+                skipped += next - clk;
+                advance_sys.AdvanceTo(next);
+                clk = next;
+            } else {
+                advance_sys.ClockTick();
+                clk++;
+            }
+        }
+    }
+    REQUIRE(ticked.size() == 8);
+    REQUIRE(ticked == advanced);
+    REQUIRE(skipped > 30000);
+}
+
+TEST_CASE("NVM write pending queue", "[dramsim3][nvm]") {
+    dramsim3::Config config("configs/NVM_32Gb_x8_2400.ini", ".");
+    std::vector<std::pair<uint64_t, uint64_t> > done;  // (addr, cycle)
+    uint64_t clk = 0;
+    auto callback = [&](uint64_t addr) { done.push_back({addr, clk}); };
+    dramsim3::NVMMemorySystem nvm(config, ".", callback, callback);
+
+    // the write is done once it is in the WPQ, a read of it is served
+    // from there and a read of another line goes to the media
+    nvm.AddTransaction(0x1000, true);
+    nvm.AddTransaction(0x1000, false);
+    nvm.AddTransaction(0x80000, false);
+    for (; clk < 1000; clk++) {
+        nvm.ClockTick();
+    }
+    REQUIRE(done.size() == 3);
+    REQUIRE(done[0].second < 10);
+    REQUIRE(done[1].second < 10);
+    REQUIRE(done[2].first == 0x80000);
+    REQUIRE(done[2].second >= static_cast<uint64_t>(config.nvm_read_latency));
+}
+
+TEST_CASE("Replaying an NVM request log", "[dramsim3][nvm]") {
+    // the shipped NVM config with recording turned on
+    {
+        std::ifstream in("configs/NVM_32Gb_x8_2400.ini");
+        std::ofstream out("test_nvm_record.ini");
+        std::string line;
+        while (std::getline(in, line)) {
+            out << line << "\n";
+            if (line == "[other]") {
+                out << "record_requests = true\n";
+            }
+        }
+    }
+    uint64_t done = 0;
+    {
+        auto callback = [&](uint64_t addr) { done++; };
+        dramsim3::MemorySystem memory_system("test_nvm_record.ini", ".",
+                                             callback, callback);
+        uint64_t addr = 0x12340;
+        for (int clk = 0; clk < 5000; clk++) {
+            if (clk % 7 == 0) {
+                addr = (addr * 6364136223846793005ull + 1) & 0xfffffffc0ull;
+                bool is_write = clk % 3 == 0;
+                if (memory_system.WillAcceptTransaction(addr, is_write)) {
+                    memory_system.AddTransaction(addr, is_write);
+                }
+            }
+            memory_system.ClockTick();
+        }
+    }
+    REQUIRE(done > 100);
+
+    dramsim3::Config config("test_nvm_record.ini", ".");
+    config.record_requests = false;
+    auto result = dramsim3::ReplayRequestLog(
+        config, config.output_prefix + "requests.bin");
+    REQUIRE(result.num_cycles == 5000);
+    REQUIRE(result.num_records > 2 * done);
+    REQUIRE(result.mismatches == 0);
+    std::remove((config.output_prefix + "requests.bin").c_str());
+    std::remove("test_nvm_record.ini");
+}
+
+TEST_CASE("System stats of skewed channel traffic", "[dramsim3]") {
+    dramsim3::Config config("configs/HBM1_4Gb_x128.ini", ".");
+    config.system_stats = true;
+    uint64_t done = 0;
+    auto callback = [&](uint64_t addr) { done++; };
+    dramsim3::JedecDRAMSystem dramsys(config, ".", callback, callback);
+
+    // three quarters of the reads go to channel 0, the rest to channel 1
+    int added = 0;
+    for (int clk = 0; clk < 5200; clk++) {
+        if (clk < 5000 && clk % 4 == 0) {
+            int channel = clk % 16 == 0 ? 1 : 0;
+            uint64_t addr = config.ReverseAddressMapping(dramsim3::Address(
+                channel, 0, 0, (clk / 16) % config.banks_per_group, 0,
+                (clk / 4) % 8));
+            if (dramsys.WillAcceptTransaction(addr, false)) {
+                dramsys.AddTransaction(addr, false);
+                added++;
+            }
+        }
+        dramsys.ClockTick();
+    }
+    REQUIRE(done == static_cast<uint64_t>(added));
+    dramsys.PrintStats();
+
+    std::ifstream in(config.json_system_name);
+    nlohmann::json system;
+    in >> system;
+    int channels = config.channels;
+    REQUIRE(system["num_reads_done"] == added);
+    const auto& util = system["channel_utilization"];
+    REQUIRE(util["0"].get<double>() > 0.0);
+    REQUIRE(util["1"].get<double>() ==
+            Approx(util["0"].get<double>() / 3).epsilon(0.05));
+    REQUIRE(util["2"].get<double>() == 0.0);
+    // channel 0 carries three quarters of the traffic of 8 channels
+    REQUIRE(system["channel_imbalance"].get<double>() ==
+            Approx(0.75 * channels).epsilon(0.05));
+    REQUIRE(system["channel_utilization_cv"].get<double>() > 1.0);
+    // the run is shorter than an epoch
+    REQUIRE(system.count("peak_epoch_bandwidth") == 0);
+    // each percentile is the smallest latency with enough reads at or
+    // below it
+    std::map<int, uint64_t> latency;
+    for (const auto& it : system["read_latency"].items()) {
+        latency[std::stoi(it.key())] = it.value();
+    }
+    REQUIRE(latency.size() > 1);
+    for (auto p : {std::make_pair("read_latency_p50", 0.5),
+                   std::make_pair("read_latency_p90", 0.9),
+                   std::make_pair("read_latency_p99", 0.99)}) {
+        int value = system[p.first];
+        uint64_t below = 0, at_or_below = 0;
+        for (const auto& it : latency) {
+            if (it.first < value) {
+                below += it.second;
+            }
+            if (it.first <= value) {
+                at_or_below += it.second;
+            }
+        }
+        REQUIRE(latency.count(value) == 1);
+        REQUIRE(below < p.second * added);
+        REQUIRE(at_or_below >= p.second * added);
+    }
+    for (auto name : {config.json_stats_name, config.txt_stats_name,
+                      config.json_epoch_name, config.json_system_name,
+                      config.json_system_epoch_name}) {
+        std::remove(name.c_str());
+    }
+}
+
+TEST_CASE("CXL read followed by a write of the same line", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    auto run = [&](bool with_write) {
+        std::vector<std::pair<bool, int> > done;  // (is write, cycle)
+        int clk = 0;
+        auto read_cb = [&](uint64_t addr) { done.push_back({false, clk}); };
+        auto write_cb = [&](uint64_t addr) { done.push_back({true, clk}); };
+        dramsim3::CXLMemorySystem cxl(config, ".", read_cb, write_cb);
+        cxl.AddTransaction(0x1000, false);
+        if (with_write) {
+            cxl.AddTransaction(0x1000, true);
+        }
+        for (; clk < 1000; clk++) {
+            cxl.ClockTick();
+        }
+        return done;
+    };
+
+    auto solo = run(false);
+    REQUIRE(solo.size() == 1);
+    // the write completes in the device right away, but the read still
+    // takes as long as on its own
+    auto both = run(true);
+    REQUIRE(both.size() == 2);
+    REQUIRE(both[0].first);
+    REQUIRE(both[0].second < solo[0].second);
+    REQUIRE_FALSE(both[1].first);
+    REQUIRE(both[1].second == solo[0].second);
+}
+
+TEST_CASE("Epoch stats deltas", "[dramsim3]") {
+    dramsim3::Config config("configs/DDR4_8Gb_x8_2400.ini", ".");
+    config.json_epoch_name = "test_epoch_delta.json";
+    config.epoch_delta = true;
+    dramsim3::SimpleStats stats(config, 0);
+    auto epoch = [&](int reads) {
+        std::ofstream(config.json_epoch_name, std::ofstream::out);
+        stats.IncrementBy("num_cycles", 1000);
+        stats.IncrementBy("num_reads_done", reads);
+        stats.Increment("epoch_num");
+        stats.PrintEpochStats();
+        std::ifstream in(config.json_epoch_name);
+        std::stringstream record;
+        record << in.rdbuf();
+        return nlohmann::json::parse(record.str());
+    };
+
+    // the first record is complete, later ones only hold what changed
+    auto first = epoch(3);
+    REQUIRE(first["num_reads_done"] == 3);
+    REQUIRE(first["num_writes_done"] == 0);
+    REQUIRE(first.count("average_power") == 1);
+    auto second = epoch(3);
+    REQUIRE(second["channel"] == 0);
+    REQUIRE(second["epoch_num"] == 2);
+    REQUIRE(second.count("num_reads_done") == 0);
+    REQUIRE(second.count("num_writes_done") == 0);
+    REQUIRE(second.count("num_cycles") == 0);
+    auto third = epoch(5);
+    REQUIRE(third["num_reads_done"] == 5);
+    REQUIRE(third.count("average_bandwidth") == 1);
+    stats.Reset();
+    auto fourth = epoch(5);
+    REQUIRE(fourth["num_cycles"] == 1000);
+    REQUIRE(fourth["num_reads_done"] == 5);
+    std::remove(config.json_epoch_name.c_str());
+}
@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <vector>
+
 #include "catch.hpp"
 #include "configuration.h"
+#include "hmc.h"
 #include "memory_system.h"
 
 bool hmc_called = false;
@@ -39,3 +43,74 @@ TEST_CASE("HMC System Testing", "[dramsim3][hmc]") {
         REQUIRE(clk == idle_lat);
     }
 }
+
+TEST_CASE("HMC host link retries", "[dramsim3][hmc]") {
+    SECTION("error free link serializes and acknowledges") {
+        dramsim3::HMCHostLink link(0.0, 20, 10, 0);
+        REQUIRE(link.Send(0, 5) == 5);
+        // queued behind the first packet
+        REQUIRE(link.Send(0, 5) == 10);
+        REQUIRE(link.CanSend(0, 10));
+        REQUIRE_FALSE(link.CanSend(0, 11));
+        // the first packet is acknowledged a round trip after it arrived
+        REQUIRE(link.CanSend(15, 15));
+        REQUIRE(link.NumRetries() == 0);
+    }
+
+    SECTION("corrupted packets are replayed after the round trip") {
+        // the highest BER a config takes, 1 in 9 1-flit packets fails
+        dramsim3::HMCHostLink link(1e-3, 20, 10, 0);
+        uint64_t arrive = 0;
+        for (int i = 0; i < 200; i++) {
+            arrive = link.Send(arrive, 1);
+        }
+        REQUIRE(link.NumRetries() > 5);
+        REQUIRE(arrive == 200 + link.RetryCycles());
+        REQUIRE(link.RetryCycles() == link.NumRetries() * 11);
+    }
+}
+
+TEST_CASE("HMC cube network", "[dramsim3][hmc]") {
+    dramsim3::Config config("configs/HMC_2GB_4Lx16.ini", ".");
+    config.num_cubes = 2;
+    std::vector<std::pair<uint64_t, bool> > done;  // (addr, is write)
+    std::vector<int> done_clk;
+    int clk = 0;
+    auto read_cb = [&](uint64_t addr) {
+        done.push_back({addr, false});
+        done_clk.push_back(clk);
+    };
+    auto write_cb = [&](uint64_t addr) {
+        done.push_back({addr, true});
+        done_clk.push_back(clk);
+    };
+    dramsim3::HMCNetwork network(config, ".", read_cb, write_cb);
+    uint64_t remote = static_cast<uint64_t>(config.channel_size) *
+                      config.channels << 20;
+    REQUIRE(network.GetCube(remote) == 1);
+
+    // a read and a write of the same line on each cube, all out at once
+    REQUIRE(network.AddTransaction(0x40, false));
+    REQUIRE(network.AddTransaction(0x40, true));
+    REQUIRE(network.AddTransaction(remote, false));
+    REQUIRE(network.AddTransaction(remote, true));
+    for (; clk < 2000; clk++) {
+        network.ClockTick();
+    }
+    REQUIRE(done.size() == 4);
+    for (uint64_t addr : {static_cast<uint64_t>(0x40), remote}) {
+        REQUIRE(std::count(done.begin(), done.end(),
+                           std::make_pair(addr, false)) == 1);
+        REQUIRE(std::count(done.begin(), done.end(),
+                           std::make_pair(addr, true)) == 1);
+    }
+    // the remote cube is a hop and a logic layer further, both ways
+    int local_read = 0, remote_read = 0;
+    for (size_t i = 0; i < done.size(); i++) {
+        if (!done[i].second) {
+            (done[i].first == remote ? remote_read : local_read) = done_clk[i];
+        }
+    }
+    REQUIRE(remote_read >=
+            local_read + 2 * (config.hop_latency + config.logic_latency));
+}
@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <fstream>
+#include "catch.hpp"
+#include "trace_mixer.h"
+
+TEST_CASE("Merging per-core traces", "[mixer]") {
+    std::ofstream("mixer_a.trace") << "0x1000 READ 0\n0x2000 WRITE 10\n";
+    std::ofstream("mixer_b.trace") << "0x1040 READ 4\n0x3040 READ 8\n";
+    std::ofstream("mixer_c.trace") << "0x12345 READ 3\n";
+    std::ofstream("mixer.txt") << "# core traces\n"
+                               << "mixer_a.trace\n"
+                               << "mixer_b.trace 2.0 0x100000\n"
+                               << "mixer_c.trace 1 random\n";
+    dramsim3::TraceMixer mixer("mixer.txt");
+    REQUIRE(mixer.NumTraces() == 3);
+
+    // b runs twice as fast and is shifted by its offset
+    REQUIRE(mixer.HasDue(0));
+    REQUIRE(mixer.Top() == 0);
+    mixer.Pop();
+    REQUIRE_FALSE(mixer.HasDue(1));
+    REQUIRE(mixer.HasDue(2));
+    REQUIRE(mixer.Top() == 1);
+    REQUIRE(mixer.TopTransaction().addr == 0x101040);
+    mixer.Pop();
+
+    // random pages keep the offset into the page
+    REQUIRE(mixer.HasDue(3));
+    REQUIRE(mixer.Top() == 2);
+    REQUIRE((mixer.TopTransaction().addr & 0xfff) == 0x345);
+    mixer.Pop();
+
+    // a held trace lets the others go ahead until released
+    REQUIRE(mixer.Top() == 1);
+    mixer.Hold();
+    REQUIRE(mixer.Top() == 0);
+    REQUIRE(mixer.TopTransaction().is_write);
+    REQUIRE_FALSE(mixer.HasDue(9));
+    mixer.Release();
+    REQUIRE(mixer.HasDue(4));
+    REQUIRE(mixer.Top() == 1);
+    mixer.Pop();
+    mixer.Pop();
+    REQUIRE(mixer.Done());
+
+    std::remove("mixer_a.trace");
+    std::remove("mixer_b.trace");
+    std::remove("mixer_c.trace");
+    std::remove("mixer.txt");
+}